@@ -0,0 +1,85 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+// FreeRTOS configuration for running the firmware's tasks on the POSIX port
+// (see README.md). It follows ../FreeRTOSConfig.h where that makes sense,
+// except that the POSIX port is single core and the tick is much faster so
+// that the simulated alarm pool can fire at INA219 conversion rates.
+
+#include <limits.h>
+#include <pthread.h>
+#include "bench.h"
+
+#define configUSE_PREEMPTION                       1
+#define configUSE_TIME_SLICING                     0
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION    0
+#define configUSE_TICKLESS_IDLE                    0
+#define configTICK_RATE_HZ                         10000
+#define configMAX_PRIORITIES                       5
+#define configMINIMAL_STACK_SIZE                   ( ( unsigned short ) PTHREAD_STACK_MIN )
+#define configMAX_TASK_NAME_LEN                    16
+#define configTICK_TYPE_WIDTH_IN_BITS              TICK_TYPE_WIDTH_32_BITS
+#define configIDLE_SHOULD_YIELD                    1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES      1
+#define configQUEUE_REGISTRY_SIZE                  0
+#define configENABLE_BACKWARD_COMPATIBILITY        0
+#define configNUM_THREAD_LOCAL_STORAGE_POINTERS    0
+#define configUSE_MINI_LIST_ITEM                   1
+#define configSTACK_DEPTH_TYPE                     size_t
+#define configMESSAGE_BUFFER_LENGTH_TYPE           size_t
+
+#define configUSE_TIMERS                           1
+#define configTIMER_TASK_PRIORITY                  ( configMAX_PRIORITIES - 1 )
+#define configTIMER_TASK_STACK_DEPTH               configMINIMAL_STACK_SIZE
+#define configTIMER_QUEUE_LENGTH                   10
+
+#define configUSE_EVENT_GROUPS                     1
+#define configUSE_STREAM_BUFFERS                   0
+#define configSUPPORT_STATIC_ALLOCATION            0
+#define configSUPPORT_DYNAMIC_ALLOCATION           1
+#define configTOTAL_HEAP_SIZE                      ( 1024 * 1024 )
+
+#define configUSE_IDLE_HOOK                        0
+#define configUSE_TICK_HOOK                        0
+#define configUSE_MALLOC_FAILED_HOOK               0
+#define configUSE_DAEMON_TASK_STARTUP_HOOK         0
+#define configCHECK_FOR_STACK_OVERFLOW             0
+#define configGENERATE_RUN_TIME_STATS              0
+#define configUSE_TRACE_FACILITY                   0
+#define configUSE_STATS_FORMATTING_FUNCTIONS       0
+#define configUSE_CO_ROUTINES                      0
+
+#include <assert.h>
+#define configASSERT( x )                          assert( x )
+
+#define configUSE_TASK_NOTIFICATIONS               1
+#define configUSE_MUTEXES                          1
+#define configUSE_RECURSIVE_MUTEXES                1
+#define configUSE_COUNTING_SEMAPHORES              1
+
+#define INCLUDE_vTaskPrioritySet                   1
+#define INCLUDE_uxTaskPriorityGet                  1
+#define INCLUDE_vTaskDelete                        1
+#define INCLUDE_vTaskSuspend                       1
+#define INCLUDE_vTaskDelayUntil                    1
+#define INCLUDE_vTaskDelay                         1
+#define INCLUDE_xTaskGetSchedulerState             1
+#define INCLUDE_xTaskGetCurrentTaskHandle          1
+#define INCLUDE_xTaskGetIdleTaskHandle             1
+#define INCLUDE_xTimerPendFunctionCall             1
+
+// Queue occupancy and drops, collected by bench.c. These expand inside
+// queue.c where the queue's fields are visible.
+#define traceQUEUE_SEND( pxQueue ) \
+    bench_trace_queue_send( pxQueue, ( pxQueue )->uxItemSize, ( pxQueue )->uxLength, ( pxQueue )->uxMessagesWaiting )
+#define traceQUEUE_SEND_FAILED( pxQueue ) \
+    bench_trace_queue_send_failed( pxQueue, ( pxQueue )->uxItemSize, ( pxQueue )->uxLength )
+#define traceBLOCKING_ON_QUEUE_SEND( pxQueue ) \
+    bench_trace_queue_blocked( pxQueue, ( pxQueue )->uxItemSize, ( pxQueue )->uxLength )
+
+// The POSIX port is single core, so pinning is dropped. Its tasks are
+// pthreads, which need far more stack than the same code on the RP2040.
+#define xTaskCreateAffinitySet( pxTaskCode, pcName, uxStackDepth, pvParameters, uxPriority, uxCoreAffinityMask, pxCreatedTask ) \
+    xTaskCreate( pxTaskCode, pcName, ( uxStackDepth ) * 16, pvParameters, uxPriority, pxCreatedTask )
+
+#endif // FREERTOS_CONFIG_H
@@ -0,0 +1,510 @@
+// picova-bench: run the firmware's read/write/display tasks on the FreeRTOS
+// POSIX port against a simulated sensor and report end-to-end throughput for
+// every ADC setting.
+//
+// Each setting runs in a forked child, since the FreeRTOS scheduler can only
+// be started once per process. The child's stdout (the firmware's USB stdio)
+// is a pipe which the parent decodes with libpicova, so only samples that
+// made it all the way out of write_task are counted. The child sends its
+// queue and sensor counters back over a second pipe when its time is up.
+
+#include <errno.h>
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include "bench.h"
+#include "ina219.h"
+#include "ina219_calc.h"
+#include "picova.h"
+#include "picova_csv.h"
+#include "pico/time.h"
+#include "sensor.h"
+#include "sim_sensor.h"
+
+// Skip the burst of samples queued during the splash screen.
+static const double WARMUP_S = 0.5;
+
+extern sensor_cfg_t sensor_initial_cfg[SENSOR_TYPES];
+extern sensor_schedule_t sensor_read_schedule;
+int picova_main(void);
+
+struct bench_stats bench_stats;
+
+static uint64_t deadline_us;
+static int stats_fd = -1;
+
+static const char* const ina219_adc_names[] = {
+    "9-bit", "10-bit", "11-bit", "12-bit",
+    "2x", "4x", "8x", "16x", "32x", "64x", "128x",
+};
+
+static const char* const ina226_adc_names[] = {
+    "140us", "204us", "332us", "588us", "1100us", "2116us", "4156us", "8244us",
+};
+
+static const char* const ina228_adc_names[] = {
+    "50us", "84us", "150us", "280us", "540us", "1052us", "2074us", "4120us",
+};
+
+// A sensor the benchmark can run against: its model and its driver.
+struct bench_sensor
+{
+    const struct sim_sensor* sim;
+    const struct sensor_ops* ops;
+    const char* const* adc_names;
+    int adcs;
+};
+
+#define BENCH_SENSOR(name) { \
+    &sim_##name, &name##_sensor_ops, name##_adc_names, \
+    sizeof(name##_adc_names) / sizeof(name##_adc_names[0]) }
+
+static const struct bench_sensor sensors[] = {
+    BENCH_SENSOR(ina219),
+    BENCH_SENSOR(ina226),
+    BENCH_SENSOR(ina228),
+};
+
+static struct bench_queue_stats* find_queue(const void* queue, size_t item_size, size_t length)
+{
+    if (!item_size)
+        return NULL;
+
+    for (int i = 0; i < BENCH_MAX_QUEUES; i++) {
+        struct bench_queue_stats* q = &bench_stats.queues[i];
+        if (q->queue == queue)
+            return q;
+        if (!q->queue) {
+            q->queue = queue;
+            q->length = length;
+            return q;
+        }
+    }
+
+    return NULL;
+}
+
+void bench_trace_queue_send(const void* queue, size_t item_size, size_t length, size_t waiting)
+{
+    struct bench_queue_stats* q = find_queue(queue, item_size, length);
+    if (!q)
+        return;
+
+    // Called just before the item is copied in.
+    const uint32_t occupancy = waiting + 1;
+    if (occupancy > q->max)
+        q->max = occupancy;
+    q->sum += occupancy;
+    q->sends++;
+}
+
+void bench_trace_queue_send_failed(const void* queue, size_t item_size, size_t length)
+{
+    struct bench_queue_stats* q = find_queue(queue, item_size, length);
+    if (q)
+        q->failed++;
+}
+
+void bench_trace_queue_blocked(const void* queue, size_t item_size, size_t length)
+{
+    struct bench_queue_stats* q = find_queue(queue, item_size, length);
+    if (q)
+        q->blocked++;
+}
+
+void bench_poll(void)
+{
+    if (time_us_64() < deadline_us)
+        return;
+
+    fflush(stdout);
+    write(stats_fd, &bench_stats, sizeof(bench_stats));
+    _exit(0);
+}
+
+// Run the firmware against `sensor` with both ADCs set to `adc` for
+// `seconds`, plus the splash screen delay.
+static pid_t spawn(const struct bench_sensor* sensor, int adc, double seconds, int* out_fd, int* stats_out_fd)
+{
+    int out[2], stats[2];
+    if (pipe(out) < 0 || pipe(stats) < 0) {
+        perror("pipe");
+        return -1;
+    }
+
+    fflush(stdout);
+    const pid_t pid = fork();
+    if (pid < 0) {
+        perror("fork");
+        return -1;
+    }
+
+    if (pid == 0) {
+        close(out[0]);
+        close(stats[0]);
+        dup2(out[1], STDOUT_FILENO);
+        close(out[1]);
+        setvbuf(stdout, NULL, _IOFBF, 1 << 16);
+
+        stats_fd = stats[1];
+        sim_sensor = sensor->sim;
+        sensor_initial_cfg[sensor->ops->type].bus_adc = adc;
+        sensor_initial_cfg[sensor->ops->type].shunt_adc = adc;
+        deadline_us = time_us_64() + (uint64_t)((seconds + 1.5) * 1e6);
+
+        picova_main();
+        _exit(1);
+    }
+
+    close(out[1]);
+    close(stats[1]);
+    *out_fd = out[0];
+    *stats_out_fd = stats[0];
+    return pid;
+}
+
+struct result
+{
+    uint64_t samples;
+    double rate;
+    uint64_t bad;
+    uint64_t max_gap_us;
+    uint64_t marker_edges;
+    uint64_t marker_errors; // Samples or edges not matching the inputs
+    struct bench_stats stats;
+};
+
+static bool run(const struct bench_sensor* sensor, int adc, double seconds, struct result* result)
+{
+    int out_fd, stats_fd;
+    const pid_t pid = spawn(sensor, adc, seconds, &out_fd, &stats_fd);
+    if (pid < 0)
+        return false;
+
+    picova_decoder_t* dec = picova_decoder_new();
+    static uint8_t buf[1 << 16];
+    static uint64_t ts[1 << 14];
+    static float V[1 << 14], mA[1 << 14], mW[1 << 14];
+    static uint8_t markers[1 << 14];
+    const size_t capacity = sizeof(ts) / sizeof(ts[0]);
+
+    uint64_t first = 0, last = 0, counted = 0, max_gap = 0;
+    uint64_t marker_edges = 0, marker_errors = 0;
+    bool have_first = false;
+    ssize_t len;
+
+    while ((len = read(out_fd, buf, sizeof(buf))) != 0) {
+        if (len < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("read");
+            break;
+        }
+
+        size_t offset = 0;
+        while (offset < (size_t)len) {
+            size_t consumed;
+            const size_t n = picova_decode(dec, buf + offset, len - offset, &consumed,
+                                           ts, V, mA, mW, markers, capacity);
+            offset += consumed;
+
+            for (size_t i = 0; i < n; i++) {
+                if (markers[i] != sim_markers(ts[i]))
+                    marker_errors++;
+            }
+
+            for (size_t i = 0; i < n; i++) {
+                if (!have_first) {
+                    first = ts[i];
+                    have_first = true;
+                }
+                if (ts[i] >= first + WARMUP_S * 1e6) {
+                    if (counted && ts[i] - last > max_gap)
+                        max_gap = ts[i] - last;
+                    counted++;
+                    last = ts[i];
+                }
+            }
+
+            // The decoder has room for PICOVA_MARKER_QUEUE records, far
+            // more than one read of the pipe holds.
+            const size_t edges = picova_read_markers(dec, ts, markers, capacity);
+            for (size_t i = 0; i < edges; i++) {
+                if (markers[i] != sim_markers(ts[i]))
+                    marker_errors++;
+            }
+            marker_edges += edges;
+        }
+    }
+
+    struct picova_counters counters;
+    picova_get_counters(dec, &counters);
+    picova_decoder_free(dec);
+    close(out_fd);
+
+    memset(&result->stats, 0, sizeof(result->stats));
+    const bool got_stats = read(stats_fd, &result->stats, sizeof(result->stats)) == sizeof(result->stats);
+    close(stats_fd);
+
+    int status;
+    waitpid(pid, &status, 0);
+    if (!got_stats || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "%s: firmware did not finish cleanly\n", sensor->adc_names[adc]);
+        return false;
+    }
+
+    const double span = (last - first) * 1e-6 - WARMUP_S;
+    result->samples = counters.samples;
+    result->rate = counted > 1 && span > 0 ? (counted - 1) / span : 0;
+    result->bad = counters.bad_lines + counters.bad_frames + counters.no_cal;
+    result->max_gap_us = max_gap;
+    result->marker_edges = marker_edges;
+    result->marker_errors = marker_errors;
+    return true;
+}
+
+// The measurement queue is the deepest data queue the firmware sent to.
+static const struct bench_queue_stats* meas_queue(const struct bench_stats* stats)
+{
+    const struct bench_queue_stats* best = NULL;
+    for (int i = 0; i < BENCH_MAX_QUEUES && stats->queues[i].queue; i++) {
+        if (!best || stats->queues[i].length > best->length)
+            best = &stats->queues[i];
+    }
+    return best;
+}
+
+// Time picova_csv_format() against the printf it replaced, on INA219
+// readings across every bus code, and check that they write the same bytes.
+// The markers column is included, as in the default firmware.
+static int bench_format(double seconds)
+{
+    enum { LINES = 1 << 16 };
+    static char buf[PICOVA_CSV_MAX_LINE];
+    static char ref[PICOVA_CSV_MAX_LINE];
+    const float current_lsb = 0.04f / SIM_SHUNT_OHMS / 32768;
+    const float power_lsb = 20 * current_lsb;
+    uint64_t mismatches = 0;
+
+    for (uint32_t i = 0; i < LINES; i++) {
+        const uint16_t reg = i;
+        const float V = ina219_calc_bus_V(reg | INA219_BUS_CNVR);
+        const float mA = ina219_calc_current_mA(reg * 7919, current_lsb);
+        const float mW = ina219_calc_power_mW(reg * 104729, power_lsb);
+
+        const size_t len = picova_csv_format(buf, i * 360, V, mA, mW, i & 0x0F);
+        const int ref_len = snprintf(ref, sizeof(ref), "%" PRIu32 ",%f,%f,%f,%u\n", i * 360, V, mA, mW, i & 0x0F);
+        if (len != (size_t)ref_len || memcmp(buf, ref, len))
+            mismatches++;
+    }
+
+    double ns[2];
+    for (int method = 0; method < 2; method++) {
+        uint64_t lines = 0;
+        const uint64_t start = time_us_64();
+        uint64_t elapsed;
+
+        do {
+            for (uint32_t i = 0; i < LINES; i++) {
+                const float V = ina219_calc_bus_V((uint16_t)i | INA219_BUS_CNVR);
+                const float mA = ina219_calc_current_mA(i * 7919, current_lsb);
+                const float mW = ina219_calc_power_mW(i * 104729, power_lsb);
+
+                if (method)
+                    picova_csv_format(buf, i * 360, V, mA, mW, i & 0x0F);
+                else
+                    snprintf(buf, sizeof(buf), "%" PRIu32 ",%f,%f,%f,%u\n", i * 360, V, mA, mW, i & 0x0F);
+            }
+            lines += LINES;
+            elapsed = time_us_64() - start;
+        } while (elapsed < seconds * 1e6 / 2);
+
+        ns[method] = elapsed * 1e3 / lines;
+    }
+
+    printf("printf             %8.1f ns/line\n", ns[0]);
+    printf("picova_csv_format  %8.1f ns/line (%.1fx)\n", ns[1], ns[0] / ns[1]);
+    printf("mismatches         %8llu of %d lines\n", (unsigned long long)mismatches, LINES);
+    return mismatches ? 1 : 0;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [-t SECONDS] [-s SENSOR] [-m MODE] [-c CHANNELS] [-b N] [ADC...]\n"
+        "       %s --format [-t SECONDS]\n"
+        "  -t, --seconds S   time to measure each setting for (default 3)\n"
+        "  -s, --sensor S    simulated sensor: ina219 (default), ina226 or ina228\n"
+        "  -m, --mode M      ADCs converting: shunt-bus (default), shunt or bus\n"
+        "                    (INA219 only)\n"
+        "  -c, --channels L  registers to read, comma-separated current,bus,power\n"
+        "                    (default all; INA219 only)\n"
+        "  -b, --bus-every N read the bus voltage every Nth sample (default 1)\n"
+        "  -e, --fault F     inject stuck-bus or brownout faults on the sensor bus\n"
+        "  -E, --fault-every S\n"
+        "                    seconds between faults (default 1)\n"
+        "  -M, --markers HZ  count up on the marker inputs HZ times a second\n"
+        "  -f, --format      time the CSV formatter against printf instead\n"
+        "  ADC               conversion time settings to run (default all; 0-10\n"
+        "                    for the INA219, 0-7 for the others)\n",
+        argv0, argv0);
+}
+
+int main(int argc, char** argv)
+{
+    static const struct option longopts[] = {
+        { "seconds",   required_argument, NULL, 't' },
+        { "sensor",    required_argument, NULL, 's' },
+        { "mode",      required_argument, NULL, 'm' },
+        { "channels",  required_argument, NULL, 'c' },
+        { "bus-every", required_argument, NULL, 'b' },
+        { "fault",     required_argument, NULL, 'e' },
+        { "fault-every", required_argument, NULL, 'E' },
+        { "markers",   required_argument, NULL, 'M' },
+        { "format",    no_argument,       NULL, 'f' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    double seconds = 3;
+    const struct bench_sensor* sensor = &sensors[0];
+    enum sensor_mode mode = SENSOR_MODE_SHUNT_BUS;
+    bool format = false;
+    int c;
+    while ((c = getopt_long(argc, argv, "t:s:m:c:b:e:E:M:f", longopts, NULL)) != -1) {
+        switch (c) {
+        case 't':
+            seconds = atof(optarg);
+            break;
+        case 's':
+            sensor = NULL;
+            for (size_t i = 0; i < sizeof(sensors) / sizeof(sensors[0]); i++) {
+                if (!strcmp(optarg, sensors[i].sim->name))
+                    sensor = &sensors[i];
+            }
+            if (!sensor) {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'm':
+            if (!strcmp(optarg, "shunt-bus"))
+                mode = SENSOR_MODE_SHUNT_BUS;
+            else if (!strcmp(optarg, "shunt"))
+                mode = SENSOR_MODE_SHUNT;
+            else if (!strcmp(optarg, "bus"))
+                mode = SENSOR_MODE_BUS;
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'c':
+            sensor_read_schedule.channels = 0;
+            for (char* tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+                if (!strcmp(tok, "current"))
+                    sensor_read_schedule.channels |= SENSOR_CHANNEL_CURRENT;
+                else if (!strcmp(tok, "bus"))
+                    sensor_read_schedule.channels |= SENSOR_CHANNEL_BUS;
+                else if (!strcmp(tok, "power"))
+                    sensor_read_schedule.channels |= SENSOR_CHANNEL_POWER;
+                else {
+                    usage(argv[0]);
+                    return 2;
+                }
+            }
+            break;
+        case 'b':
+            sensor_read_schedule.bus_every = atoi(optarg);
+            break;
+        case 'e':
+            if (!strcmp(optarg, "stuck-bus"))
+                sim_fault = SIM_FAULT_STUCK_BUS;
+            else if (!strcmp(optarg, "brownout"))
+                sim_fault = SIM_FAULT_BROWNOUT;
+            else {
+                usage(argv[0]);
+                return 2;
+            }
+            break;
+        case 'E':
+            sim_fault_every_us = atof(optarg) * 1e6;
+            break;
+        case 'M':
+            sim_marker_hz = atof(optarg);
+            break;
+        case 'f':
+            format = true;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+
+    if (format)
+        return bench_format(seconds);
+
+    sensor_initial_cfg[sensor->ops->type].mode = mode;
+
+    bool selected[INA219_ADC_SAMPLES_128 + 1] = {0};
+    bool any = false;
+    for (int i = optind; i < argc; i++) {
+        const int adc = atoi(argv[i]);
+        if (adc < 0 || adc >= sensor->adcs) {
+            usage(argv[0]);
+            return 2;
+        }
+        selected[adc] = any = true;
+    }
+
+    if (seconds <= WARMUP_S) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    printf("%-7s %10s %10s %6s %8s %8s %8s %8s %8s %8s %6s %8s %6s %8s %6s %6s\n",
+        "adc", "expect/s", "samples/s", "%", "q max", "q mean", "blocked", "dropped",
+        "missed", "notready", "B/smp", "bad", "faults", "gap ms", "edges", "mk err");
+
+    bool ok = true;
+    for (int adc = 0; adc < sensor->adcs; adc++) {
+        if (any && !selected[adc])
+            continue;
+
+        struct result r;
+        if (!run(sensor, adc, seconds, &r)) {
+            ok = false;
+            continue;
+        }
+
+        sensor_cfg_t cfg = sensor_initial_cfg[sensor->ops->type];
+        cfg.bus_adc = adc;
+        cfg.shunt_adc = adc;
+        const double expected = 1e6 / sensor->ops->conversion_us(&cfg);
+        const struct bench_queue_stats* q = meas_queue(&r.stats);
+        uint64_t dropped = 0;
+        for (int i = 0; i < BENCH_MAX_QUEUES; i++)
+            dropped += r.stats.queues[i].failed;
+
+        printf("%-7s %10.1f %10.1f %6.1f %8u %8.1f %8llu %8llu %8llu %8llu %6.1f %8llu %6llu %8.1f %6llu %6llu\n",
+            sensor->adc_names[adc], expected, r.rate, 100 * r.rate / expected,
+            q ? q->max : 0, q && q->sends ? (double)q->sum / q->sends : 0.0,
+            (unsigned long long)(q ? q->blocked : 0),
+            (unsigned long long)dropped,
+            (unsigned long long)r.stats.missed,
+            (unsigned long long)r.stats.not_ready,
+            r.samples ? (double)r.stats.i2c_bytes / r.samples : 0.0,
+            (unsigned long long)r.bad,
+            (unsigned long long)r.stats.faults,
+            r.max_gap_us * 1e-3,
+            (unsigned long long)r.marker_edges,
+            (unsigned long long)r.marker_errors);
+        fflush(stdout);
+    }
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,50 @@
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define BENCH_MAX_QUEUES 8
+
+// Per-queue counters. Semaphores and mutexes (zero item size) are ignored.
+struct bench_queue_stats
+{
+    const void* queue;
+    uint32_t length;
+    uint32_t max;           // Highest occupancy after a send
+    uint64_t sum;           // Sum of occupancy after each send
+    uint64_t sends;
+    uint64_t blocked;       // Sends that had to wait for space
+    uint64_t failed;        // Sends that timed out, i.e. dropped items
+};
+
+// Everything the benchmark child reports back to the parent.
+struct bench_stats
+{
+    struct bench_queue_stats queues[BENCH_MAX_QUEUES];
+    uint64_t conversions;   // Conversions completed by the simulated sensor
+    uint64_t missed;        // Conversions overwritten before they were read
+    uint64_t not_ready;     // Reads of the ready flag while it was clear
+    uint64_t i2c_bytes;     // Bytes on the sensor bus, including addresses
+    uint64_t display_frames;
+    uint64_t faults;        // Faults injected on the sensor bus
+};
+
+extern struct bench_stats bench_stats;
+
+void bench_trace_queue_send(const void* queue, size_t item_size, size_t length, size_t waiting);
+void bench_trace_queue_send_failed(const void* queue, size_t item_size, size_t length);
+void bench_trace_queue_blocked(const void* queue, size_t item_size, size_t length);
+
+// Called periodically from a task; ends the run once its time is up.
+void bench_poll(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _BENCH_H
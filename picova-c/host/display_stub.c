@@ -0,0 +1,37 @@
+#include "FreeRTOS.h"
+#include "task.h"
+#include "bench.h"
+#include "display.h"
+
+u8g2_t u8g2;
+const uint8_t u8g2_font_profont22_tr[1];
+
+int display_init_i2c(i2c_inst_t *i2c, uint baudrate, uint sda_gpio, uint scl_gpio)
+{
+    i2c_init(i2c, baudrate);
+    return PICO_OK;
+}
+
+int display_init_ssd1306(void)
+{
+    return PICO_OK;
+}
+
+void u8g2_InitDisplay(u8g2_t* u8g2) {}
+void u8g2_SetPowerSave(u8g2_t* u8g2, uint8_t is_enable) {}
+void u8g2_SetFont(u8g2_t* u8g2, const uint8_t* font) {}
+void u8g2_ClearBuffer(u8g2_t* u8g2) {}
+
+uint16_t u8g2_DrawStr(u8g2_t* u8g2, uint16_t x, uint16_t y, const char* str)
+{
+    return 0;
+}
+
+// 1 kB of frame buffer plus commands at 1 MHz, sent by DMA while the task
+// waits.
+void u8g2_SendBuffer(u8g2_t* u8g2)
+{
+    u8g2->frames++;
+    bench_stats.display_frames++;
+    vTaskDelay(pdMS_TO_TICKS(10));
+}
@@ -0,0 +1,62 @@
+#ifndef _HARDWARE_GPIO_H
+#define _HARDWARE_GPIO_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum gpio_dir
+{
+    GPIO_IN = 0,
+    GPIO_OUT = 1,
+};
+
+enum gpio_function
+{
+    GPIO_FUNC_I2C = 3,
+    GPIO_FUNC_SIO = 5,
+};
+
+enum gpio_drive_strength
+{
+    GPIO_DRIVE_STRENGTH_2MA,
+    GPIO_DRIVE_STRENGTH_4MA,
+    GPIO_DRIVE_STRENGTH_8MA,
+    GPIO_DRIVE_STRENGTH_12MA,
+};
+
+enum gpio_irq_level
+{
+    GPIO_IRQ_LEVEL_LOW = 0x1,
+    GPIO_IRQ_LEVEL_HIGH = 0x2,
+    GPIO_IRQ_EDGE_FALL = 0x4,
+    GPIO_IRQ_EDGE_RISE = 0x8,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+// Only the sensor's bus and power pins are modelled, so that the firmware
+// can recover from injected faults, and the marker inputs (see
+// ../sim_sensor.h). Other pins have no effect on the host.
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+uint32_t gpio_get_all(void);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+
+static inline void gpio_init(uint gpio) {}
+static inline void gpio_set_drive_strength(uint gpio, enum gpio_drive_strength drive) {}
+static inline void gpio_pull_up(uint gpio) {}
+static inline void gpio_pull_down(uint gpio) {}
+
+// Falling edges come from the simulated sensor's ALERT pin, and both edges
+// from the marker inputs. See ../sdk_stubs.c.
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _HARDWARE_GPIO_H
@@ -0,0 +1,22 @@
+#ifndef _PICO_H
+#define _PICO_H
+
+// Just enough of the Pico SDK for the firmware to build on the host. See
+// ../sdk_stubs.c.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+enum pico_error_codes
+{
+    PICO_OK = 0,
+    PICO_ERROR_GENERIC = -1,
+    PICO_ERROR_TIMEOUT = -2,
+};
+
+#define PICO_DEFAULT_LED_PIN 25
+
+#endif // _PICO_H
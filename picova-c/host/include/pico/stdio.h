@@ -0,0 +1,17 @@
+#ifndef _PICO_STDIO_H
+#define _PICO_STDIO_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The benchmark sends the firmware nothing, so this always times out.
+int getchar_timeout_us(uint32_t timeout_us);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICO_STDIO_H
@@ -0,0 +1,23 @@
+#ifndef _PICO_STDIO_USB_H
+#define _PICO_STDIO_USB_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// stdio goes to the process's stdout, which the benchmark reads from a pipe.
+// USB CDC throughput is not modelled.
+typedef struct stdio_driver stdio_driver_t;
+
+extern stdio_driver_t stdio_usb;
+
+bool stdio_usb_init(void);
+void stdio_set_translate_crlf(stdio_driver_t* driver, bool translate);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICO_STDIO_USB_H
@@ -0,0 +1,39 @@
+#ifndef _PICO_TIME_H
+#define _PICO_TIME_H
+
+#include "pico.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct alarm_pool alarm_pool_t;
+typedef int32_t alarm_id_t;
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t* rt);
+
+struct repeating_timer
+{
+    int64_t delay_us;
+    alarm_pool_t* pool;
+    alarm_id_t alarm_id;
+    repeating_timer_callback_t callback;
+    void* user_data;
+};
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+void busy_wait_us(uint64_t delay_us);
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+
+alarm_pool_t* alarm_pool_create_with_unused_hardware_alarm(uint max_timers);
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t* pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void* user_data, repeating_timer_t* out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICO_TIME_H
@@ -0,0 +1,33 @@
+#ifndef _U8G2_H
+#define _U8G2_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The subset of u8g2 used by main.c. Drawing is a no-op; sending the buffer
+// blocks for as long as the DMA transfer to the SSD1306 would. See
+// ../display_stub.c.
+typedef struct u8g2 u8g2_t;
+
+struct u8g2
+{
+    uint32_t frames;
+};
+
+extern const uint8_t u8g2_font_profont22_tr[];
+
+void u8g2_InitDisplay(u8g2_t* u8g2);
+void u8g2_SetPowerSave(u8g2_t* u8g2, uint8_t is_enable);
+void u8g2_SetFont(u8g2_t* u8g2, const uint8_t* font);
+void u8g2_ClearBuffer(u8g2_t* u8g2);
+uint16_t u8g2_DrawStr(u8g2_t* u8g2, uint16_t x, uint16_t y, const char* str);
+void u8g2_SendBuffer(u8g2_t* u8g2);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _U8G2_H
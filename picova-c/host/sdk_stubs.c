@@ -0,0 +1,346 @@
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "bench.h"
+#include "hardware/flash.h"
+#include "hardware/gpio.h"
+#include "hardware/i2c.h"
+#include "pico/flash.h"
+#include "pico/stdio.h"
+#include "pico/stdio_usb.h"
+#include "pico/time.h"
+#include "sim_sensor.h"
+
+struct i2c_inst
+{
+    uint baudrate;
+};
+
+struct stdio_driver
+{
+    bool translate_crlf;
+};
+
+struct alarm_pool
+{
+    uint max_timers;
+};
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+__attribute__((constructor)) static void host_flash_init(void)
+{
+    memset(host_flash, 0xFF, sizeof(host_flash));
+}
+
+i2c_inst_t i2c0_inst;
+i2c_inst_t i2c1_inst;
+stdio_driver_t stdio_usb;
+
+uint64_t time_us_64(void)
+{
+    static uint64_t epoch_ns = 0;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    const uint64_t ns = ts.tv_sec * 1000000000ull + ts.tv_nsec;
+    if (!epoch_ns)
+        epoch_ns = ns;
+
+    // Like the RP2040 timer, start near zero at boot.
+    return (ns - epoch_ns) / 1000;
+}
+
+uint32_t time_us_32(void)
+{
+    return (uint32_t)time_us_64();
+}
+
+void busy_wait_us(uint64_t delay_us)
+{
+    const uint64_t end = time_us_64() + delay_us;
+    while (time_us_64() < end)
+        ;
+}
+
+void sleep_us(uint64_t us)
+{
+    struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+    nanosleep(&ts, NULL);
+}
+
+void sleep_ms(uint32_t ms)
+{
+    sleep_us(ms * 1000ull);
+}
+
+bool stdio_usb_init(void)
+{
+    return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+    return PICO_ERROR_TIMEOUT;
+}
+
+void stdio_set_translate_crlf(stdio_driver_t* driver, bool translate)
+{
+    driver->translate_crlf = translate;
+}
+
+enum sim_fault sim_fault = SIM_FAULT_NONE;
+uint64_t sim_fault_every_us = 1000000;
+
+// The sensor's pins and the fault currently on its bus. SCL and SDA are
+// driven open drain, by switching between output low and input.
+static struct
+{
+    bool vcc;
+    bool scl_sio;
+    bool scl_low;
+    enum sim_fault fault;
+    uint64_t next_fault_us;
+} pins;
+
+// SDA is released on the third SCL clock.
+static const int STUCK_CLOCKS = 3;
+static int stuck_clocks;
+
+void gpio_put(uint gpio, bool value)
+{
+    if (gpio != SIM_PIN_VCC || value == pins.vcc)
+        return;
+
+    // Power-on reset. A brown-out ends and the bus is released.
+    pins.vcc = value;
+    if (value) {
+        sim_sensor->reset();
+        pins.fault = SIM_FAULT_NONE;
+    }
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+    if (gpio != SIM_PIN_SCL || !pins.scl_sio)
+        return;
+
+    const bool was_low = pins.scl_low;
+    pins.scl_low = out;
+    if (was_low && !out && pins.fault == SIM_FAULT_STUCK_BUS && ++stuck_clocks >= STUCK_CLOCKS)
+        pins.fault = SIM_FAULT_NONE;
+}
+
+bool gpio_get(uint gpio)
+{
+    if (gpio == SIM_PIN_SDA)
+        return pins.fault != SIM_FAULT_STUCK_BUS;
+    return false;
+}
+
+uint32_t gpio_get_all(void)
+{
+    return (uint32_t)sim_markers(time_us_64()) << SIM_PIN_MARKERS
+        | (uint32_t)gpio_get(SIM_PIN_SDA) << SIM_PIN_SDA;
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn)
+{
+    if (gpio == SIM_PIN_SCL) {
+        pins.scl_sio = fn == GPIO_FUNC_SIO;
+        pins.scl_low = false;
+    }
+}
+
+uint i2c_init(i2c_inst_t* i2c, uint baudrate)
+{
+    i2c->baudrate = baudrate;
+    return baudrate;
+}
+
+// Start the next fault when it is due, and fail the transfer while one is
+// on the bus: after the timeout for a stuck bus, or on the address byte for
+// a sensor without power.
+static int i2c_fault(i2c_inst_t* i2c, uint timeout_us)
+{
+    const uint64_t now = time_us_64();
+
+    if (sim_fault != SIM_FAULT_NONE && pins.fault == SIM_FAULT_NONE) {
+        if (!pins.next_fault_us)
+            pins.next_fault_us = now + sim_fault_every_us;
+        if (now >= pins.next_fault_us) {
+            pins.fault = sim_fault;
+            pins.next_fault_us = now + sim_fault_every_us;
+            stuck_clocks = 0;
+            bench_stats.faults++;
+        }
+    }
+
+    if (pins.fault == SIM_FAULT_STUCK_BUS) {
+        busy_wait_us(timeout_us);
+        return PICO_ERROR_TIMEOUT;
+    }
+
+    if (pins.fault == SIM_FAULT_BROWNOUT || !pins.vcc) {
+        busy_wait_us((20 * 1000000ull + i2c->baudrate - 1) / i2c->baudrate);
+        return PICO_ERROR_GENERIC;
+    }
+
+    return PICO_OK;
+}
+
+// Spin for the time the transfer would take on the wire: a start condition,
+// nine clocks for the address and each byte, and a stop condition.
+static void i2c_transfer(i2c_inst_t* i2c, size_t len)
+{
+    const uint bits = (len + 1) * 9 + 2;
+    bench_stats.i2c_bytes += len + 1;
+    busy_wait_us((bits * 1000000ull + i2c->baudrate - 1) / i2c->baudrate);
+}
+
+int i2c_write_timeout_us(i2c_inst_t* i2c, uint8_t addr, const uint8_t* src, size_t len, bool nostop, uint timeout_us)
+{
+    if (i2c != i2c0 || addr != SIM_SENSOR_ADDR || !i2c->baudrate)
+        return PICO_ERROR_GENERIC;
+
+    const int err = i2c_fault(i2c, timeout_us);
+    if (err < 0)
+        return err;
+
+    i2c_transfer(i2c, len);
+    return sim_sensor->write(src, len);
+}
+
+int i2c_read_timeout_us(i2c_inst_t* i2c, uint8_t addr, uint8_t* dst, size_t len, bool nostop, uint timeout_us)
+{
+    if (i2c != i2c0 || addr != SIM_SENSOR_ADDR || !i2c->baudrate)
+        return PICO_ERROR_GENERIC;
+
+    const int err = i2c_fault(i2c, timeout_us);
+    if (err < 0)
+        return err;
+
+    i2c_transfer(i2c, len);
+    return sim_sensor->read(dst, len);
+}
+
+// The hardware alarm becomes a top priority task that polls its deadline
+// every tick. Callbacks therefore run in task context, and a timer due more
+// than once per tick fires at most once per tick, which is harmless here
+// because the firmware's callback only gives a notification.
+static void alarm_task(void* arg)
+{
+    repeating_timer_t* timer = arg;
+    const uint64_t period = timer->delay_us < 0 ? -timer->delay_us : timer->delay_us;
+    uint64_t next = time_us_64() + period;
+
+    while (true) {
+        const uint64_t now = time_us_64();
+        if (now >= next) {
+            if (!timer->callback(timer))
+                break;
+            next = timer->delay_us < 0 ? now + period : next + period;
+            if (next < now)
+                next = now + period;
+        }
+
+        bench_poll();
+        vTaskDelay(1);
+    }
+
+    vTaskDelete(NULL);
+}
+
+alarm_pool_t* alarm_pool_create_with_unused_hardware_alarm(uint max_timers)
+{
+    alarm_pool_t* pool = malloc(sizeof(*pool));
+    if (pool)
+        pool->max_timers = max_timers;
+    return pool;
+}
+
+bool alarm_pool_add_repeating_timer_us(alarm_pool_t* pool, int64_t delay_us,
+                                       repeating_timer_callback_t callback,
+                                       void* user_data, repeating_timer_t* out)
+{
+    out->delay_us = delay_us;
+    out->pool = pool;
+    out->alarm_id = 1;
+    out->callback = callback;
+    out->user_data = user_data;
+
+    return xTaskCreate(alarm_task, "alarm", configMINIMAL_STACK_SIZE, out,
+                       configMAX_PRIORITIES - 1, NULL) == pdPASS;
+}
+
+// Pins with edge interrupts enabled, and the one callback they share, as on
+// the RP2040.
+static struct
+{
+    gpio_irq_callback_t callback;
+    uint32_t enabled;
+    TaskHandle_t task;
+} gpio_irq;
+
+// Like the hardware alarm, the GPIO interrupt becomes a top priority task
+// that polls every tick, here for the simulated sensor's ALERT pin falling
+// and for edges on the marker inputs.
+static void gpio_irq_task(void* arg)
+{
+    bool low = false;
+    uint32_t inputs = gpio_get_all();
+
+    while (true) {
+        const bool was_low = low;
+        low = sim_sensor->alert && sim_sensor->alert();
+        if (low && !was_low && (gpio_irq.enabled & (1u << SIM_PIN_ALERT)))
+            gpio_irq.callback(SIM_PIN_ALERT, GPIO_IRQ_EDGE_FALL);
+
+        const uint32_t was = inputs;
+        inputs = gpio_get_all();
+        const uint32_t changed = (inputs ^ was) & gpio_irq.enabled;
+        for (uint gpio = 0; changed >> gpio; gpio++) {
+            if (changed & (1u << gpio))
+                gpio_irq.callback(gpio, inputs & (1u << gpio) ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL);
+        }
+
+        bench_poll();
+        vTaskDelay(1);
+    }
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+    gpio_irq.callback = callback;
+    if (enabled && event_mask)
+        gpio_irq.enabled |= 1u << gpio;
+    else
+        gpio_irq.enabled &= ~(1u << gpio);
+
+    if (!gpio_irq.task)
+        xTaskCreate(gpio_irq_task, "gpio", configMINIMAL_STACK_SIZE, NULL,
+                    configMAX_PRIORITIES - 1, &gpio_irq.task);
+}
+
+// Erasing sets bits and programming can only clear them, as on real flash.
+// Both take roughly as long as they would on the RP2040's W25Q16.
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    memset(host_flash + flash_offs, 0xFF, count);
+    busy_wait_us(45000 * (count / FLASH_SECTOR_SIZE));
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+        host_flash[flash_offs + i] &= data[i];
+    busy_wait_us(400 * (count / FLASH_PAGE_SIZE));
+}
+
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms)
+{
+    func(param);
+    return PICO_OK;
+}
@@ -0,0 +1,178 @@
+#include <math.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "pico/time.h"
+#include "sim_sensor.h"
+
+struct sim_ina219
+{
+    uint8_t pointer;
+    uint16_t cfg;
+    uint16_t cal;
+    uint16_t shunt;
+    uint16_t bus;
+    uint16_t power;
+    uint16_t current;
+
+    bool cnvr;
+    bool unread;            // No data register read since the last conversion
+    uint64_t start_us;      // When the current configuration was written
+    uint64_t done;          // Conversions completed since then
+};
+
+static struct sim_ina219 sim;
+
+// Conversion time in us for each 4-bit BADC/SADC setting.
+static const uint32_t adc_us[16] = {
+    84, 148, 276, 532, 84, 148, 276, 532,
+    532, 1060, 2130, 4260, 8510, 17020, 34050, 68100,
+};
+
+// Operating mode bits: shunt (bit 0), bus (bit 1), continuous (bit 2). Only
+// continuous modes are simulated.
+static const uint16_t MODE_SHUNT = 0x01;
+static const uint16_t MODE_BUS = 0x02;
+static const uint16_t MODE_CONTINUOUS = 0x04;
+
+static uint32_t period_us(void)
+{
+    return ((sim.cfg & MODE_BUS) ? adc_us[(sim.cfg >> 7) & 0x0F] : 0)
+         + ((sim.cfg & MODE_SHUNT) ? adc_us[(sim.cfg >> 3) & 0x0F] : 0);
+}
+
+static void convert(uint64_t t_us)
+{
+    const float mA = sim_load_mA(t_us);
+    const float V = sim_load_V(mA);
+
+    const long max_shunt = 4000L << ((sim.cfg >> 11) & 0x03);
+    long shunt = lroundf(mA * 1e-3f * SIM_SHUNT_OHMS / 10e-6f);
+    if (shunt > max_shunt)
+        shunt = max_shunt;
+    else if (shunt < -max_shunt)
+        shunt = -max_shunt;
+
+    const long max_bus = (sim.cfg & (1 << 13)) ? 8000 : 4000;
+    long bus = lroundf(V / 4e-3f);
+    if (bus > max_bus)
+        bus = max_bus;
+
+    // An ADC that isn't converting leaves its registers as they were, and
+    // power is computed from whatever they hold.
+    long current = (int16_t)sim.current;
+    if (sim.cfg & MODE_SHUNT) {
+        current = shunt * sim.cal / 4096;
+        sim.shunt = (uint16_t)(int16_t)shunt;
+        sim.current = (uint16_t)(int16_t)current;
+    }
+
+    if (!(sim.cfg & MODE_BUS))
+        bus = sim.bus >> 3;
+
+    const long power = labs(current) * bus / 5000;
+    const bool ovf = current > INT16_MAX || current < INT16_MIN || power > UINT16_MAX;
+
+    sim.power = (uint16_t)power;
+    sim.bus = (uint16_t)(bus << 3) | (ovf ? 0x01 : 0);
+}
+
+// Catch up with the conversions that have completed since the last access.
+static void update(void)
+{
+    if (!(sim.cfg & MODE_CONTINUOUS) || !(sim.cfg & (MODE_SHUNT | MODE_BUS)))
+        return;
+
+    const uint32_t period = period_us();
+    const uint64_t done = (time_us_64() - sim.start_us) / period;
+    if (done <= sim.done)
+        return;
+
+    bench_stats.conversions += done - sim.done;
+    bench_stats.missed += done - sim.done - 1 + (sim.unread ? 1 : 0);
+    sim.done = done;
+    sim.cnvr = true;
+    sim.unread = true;
+    convert(sim.start_us + done * period);
+}
+
+static void restart(void)
+{
+    sim.start_us = time_us_64();
+    sim.done = 0;
+    sim.cnvr = false;
+    sim.unread = false;
+}
+
+static void sim_reset(void)
+{
+    sim = (struct sim_ina219){ .cfg = 0x399F };
+    restart();
+}
+
+static void write_reg(uint8_t reg, uint16_t value)
+{
+    switch (reg) {
+    case 0:
+        if (value & 0x8000) {
+            sim_reset();
+        } else {
+            sim.cfg = value;
+            restart();
+        }
+        break;
+    case 5:
+        sim.cal = value & 0xFFFE;
+        break;
+    }
+}
+
+static int sim_write(const uint8_t* src, size_t len)
+{
+    if (len >= 1)
+        sim.pointer = src[0];
+
+    if (len >= 3)
+        write_reg(sim.pointer, (src[1] << 8) | src[2]);
+
+    return (int)len;
+}
+
+static int sim_read(uint8_t* dst, size_t len)
+{
+    uint16_t value = 0;
+
+    update();
+
+    switch (sim.pointer) {
+    case 0: value = sim.cfg; break;
+    case 1: value = sim.shunt; break;
+    case 2:
+        value = sim.bus | (sim.cnvr ? 0x02 : 0);
+        if (!sim.cnvr)
+            bench_stats.not_ready++;
+        break;
+    case 3:
+        // Reading the power register clears CNVR.
+        value = sim.power;
+        sim.cnvr = false;
+        sim.unread = false;
+        break;
+    case 4:
+        value = sim.current;
+        sim.unread = false;
+        break;
+    case 5: value = sim.cal; break;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        dst[i] = i % 2 ? value & 0xFF : value >> 8;
+
+    return (int)len;
+}
+
+const struct sim_sensor sim_ina219 = {
+    .name   = "ina219",
+    .reset  = sim_reset,
+    .write  = sim_write,
+    .read   = sim_read,
+};
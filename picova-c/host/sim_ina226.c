@@ -0,0 +1,170 @@
+#include <math.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "pico/time.h"
+#include "sim_sensor.h"
+
+struct sim_ina226
+{
+    uint8_t pointer;
+    uint16_t cfg;
+    uint16_t cal;
+    uint16_t mask;
+    uint16_t shunt;
+    uint16_t bus;
+    uint16_t power;
+    uint16_t current;
+
+    bool cvrf;
+    uint64_t start_us;      // When the current configuration was written
+    uint64_t done;          // Conversions completed since then
+};
+
+static struct sim_ina226 sim;
+
+// Conversion time in us for each VBUSCT/VSHCT setting, and the number of
+// conversions averaged for each AVG setting.
+static const uint32_t ct_us[8] = { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+static const uint32_t avg_n[8] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+static uint32_t period_us(void)
+{
+    return (ct_us[(sim.cfg >> 6) & 0x07] + ct_us[(sim.cfg >> 3) & 0x07])
+         * avg_n[(sim.cfg >> 9) & 0x07];
+}
+
+static void convert(uint64_t t_us)
+{
+    const float mA = sim_load_mA(t_us);
+    const float V = sim_load_V(mA);
+
+    // 2.5 uV shunt LSB, 81.92 mV full scale.
+    long shunt = lroundf(mA * 1e-3f * SIM_SHUNT_OHMS / 2.5e-6f);
+    if (shunt > INT16_MAX)
+        shunt = INT16_MAX;
+    else if (shunt < -INT16_MAX)
+        shunt = -INT16_MAX;
+
+    const long bus = lroundf(V / 1.25e-3f);
+    long current = shunt * sim.cal / 2048;
+    if (current > INT16_MAX)
+        current = INT16_MAX;
+    else if (current < INT16_MIN)
+        current = INT16_MIN;
+
+    long power = labs(current) * bus / 20000;
+    if (power > UINT16_MAX)
+        power = UINT16_MAX;
+
+    sim.shunt = (uint16_t)(int16_t)shunt;
+    sim.current = (uint16_t)(int16_t)current;
+    sim.power = (uint16_t)power;
+    sim.bus = (uint16_t)bus;
+}
+
+// Catch up with the conversions that have completed since the last access.
+static void update(void)
+{
+    if ((sim.cfg & 0x07) != 0x07)
+        return;
+
+    const uint32_t period = period_us();
+    const uint64_t done = (time_us_64() - sim.start_us) / period;
+    if (done <= sim.done)
+        return;
+
+    bench_stats.conversions += done - sim.done;
+    bench_stats.missed += done - sim.done - 1 + (sim.cvrf ? 1 : 0);
+    sim.done = done;
+    sim.cvrf = true;
+    convert(sim.start_us + done * period);
+}
+
+static void restart(void)
+{
+    sim.start_us = time_us_64();
+    sim.done = 0;
+    sim.cvrf = false;
+}
+
+static void sim_reset(void)
+{
+    sim = (struct sim_ina226){ .cfg = 0x4127 };
+    restart();
+}
+
+static void write_reg(uint8_t reg, uint16_t value)
+{
+    switch (reg) {
+    case 0:
+        if (value & 0x8000) {
+            sim_reset();
+        } else {
+            sim.cfg = value;
+            restart();
+        }
+        break;
+    case 5:
+        sim.cal = value & 0x7FFF;
+        break;
+    case 6:
+        sim.mask = value & 0xFC03;
+        break;
+    }
+}
+
+static int sim_write(const uint8_t* src, size_t len)
+{
+    if (len >= 1)
+        sim.pointer = src[0];
+
+    if (len >= 3)
+        write_reg(sim.pointer, (src[1] << 8) | src[2]);
+
+    return (int)len;
+}
+
+static int sim_read(uint8_t* dst, size_t len)
+{
+    uint16_t value = 0;
+
+    update();
+
+    switch (sim.pointer) {
+    case 0: value = sim.cfg; break;
+    case 1: value = sim.shunt; break;
+    case 2: value = sim.bus; break;
+    case 3: value = sim.power; break;
+    case 4: value = sim.current; break;
+    case 5: value = sim.cal; break;
+    case 6:
+        // Reading Mask/Enable clears CVRF and releases ALERT.
+        value = sim.mask | (sim.cvrf ? 0x08 : 0);
+        if (!sim.cvrf)
+            bench_stats.not_ready++;
+        sim.cvrf = false;
+        break;
+    case 0xFE: value = 0x5449; break;
+    case 0xFF: value = 0x2260; break;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        dst[i] = i % 2 ? value & 0xFF : value >> 8;
+
+    return (int)len;
+}
+
+// ALERT follows CVRF when conversion ready is enabled (CNVR).
+static bool sim_alert(void)
+{
+    update();
+    return (sim.mask & 0x0400) && sim.cvrf;
+}
+
+const struct sim_sensor sim_ina226 = {
+    .name   = "ina226",
+    .reset  = sim_reset,
+    .write  = sim_write,
+    .read   = sim_read,
+    .alert  = sim_alert,
+};
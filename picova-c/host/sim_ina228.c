@@ -0,0 +1,191 @@
+#include <math.h>
+#include <stdlib.h>
+#include "bench.h"
+#include "pico/time.h"
+#include "sim_sensor.h"
+
+struct sim_ina228
+{
+    uint8_t pointer;
+    uint16_t cfg;
+    uint16_t adc_cfg;
+    uint16_t shunt_cal;
+    uint16_t diag;
+    int32_t vshunt;
+    int32_t vbus;
+    int32_t current;
+    uint32_t power;
+
+    bool cnvrf;
+    uint64_t start_us;      // When the current configuration was written
+    uint64_t done;          // Conversions completed since then
+};
+
+static struct sim_ina228 sim;
+
+// Conversion time in us for each VBUSCT/VSHCT/VTCT setting, and the number
+// of conversions averaged for each AVG setting.
+static const uint32_t ct_us[8] = { 50, 84, 150, 280, 540, 1052, 2074, 4120 };
+static const uint32_t avg_n[8] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+static const int32_t MAX_20 = (1 << 19) - 1;
+
+static uint32_t period_us(void)
+{
+    const uint mode = sim.adc_cfg >> 12;
+    uint32_t us = 0;
+
+    if (mode & 0x01)
+        us += ct_us[(sim.adc_cfg >> 9) & 0x07];
+    if (mode & 0x02)
+        us += ct_us[(sim.adc_cfg >> 6) & 0x07];
+    if (mode & 0x04)
+        us += ct_us[(sim.adc_cfg >> 3) & 0x07];
+
+    return us * avg_n[sim.adc_cfg & 0x07];
+}
+
+static void convert(uint64_t t_us)
+{
+    const float mA = sim_load_mA(t_us);
+    const float V = sim_load_V(mA);
+
+    // ADCRANGE selects a 78.125 nV or 312.5 nV shunt LSB.
+    const float shunt_lsb = (sim.cfg & 0x10) ? 78.125e-9f : 312.5e-9f;
+    long vshunt = lroundf(mA * 1e-3f * SIM_SHUNT_OHMS / shunt_lsb);
+    if (vshunt > MAX_20)
+        vshunt = MAX_20;
+    else if (vshunt < -MAX_20)
+        vshunt = -MAX_20;
+
+    const long vbus = lroundf(V / 195.3125e-6f);
+
+    // SHUNT_CAL is 4096 at the current LSB that makes full scale 2^19.
+    long long current = sim.shunt_cal ? (long long)vshunt * 4096 / sim.shunt_cal : 0;
+    const bool mathof = current > MAX_20 || current < -MAX_20;
+    if (mathof)
+        current = current > 0 ? MAX_20 : -MAX_20;
+
+    long long power = llabs(current) * vbus * 195.3125e-6 / 3.2;
+    if (power > 0xFFFFFF)
+        power = 0xFFFFFF;
+
+    sim.vshunt = vshunt;
+    sim.vbus = vbus;
+    sim.current = current;
+    sim.power = power;
+    sim.diag = mathof ? (sim.diag | (1 << 9)) : (sim.diag & ~(1 << 9));
+}
+
+// Catch up with the conversions that have completed since the last access.
+static void update(void)
+{
+    if ((sim.adc_cfg >> 12) < 0x09)
+        return;
+
+    const uint32_t period = period_us();
+    const uint64_t done = (time_us_64() - sim.start_us) / period;
+    if (done <= sim.done)
+        return;
+
+    bench_stats.conversions += done - sim.done;
+    bench_stats.missed += done - sim.done - 1 + (sim.cnvrf ? 1 : 0);
+    sim.done = done;
+    sim.cnvrf = true;
+    convert(sim.start_us + done * period);
+}
+
+static void restart(void)
+{
+    sim.start_us = time_us_64();
+    sim.done = 0;
+    sim.cnvrf = false;
+}
+
+static void sim_reset(void)
+{
+    sim = (struct sim_ina228){ .adc_cfg = 0xFB68, .shunt_cal = 0x1000, .diag = 0x0001 };
+    restart();
+}
+
+static void write_reg(uint8_t reg, uint16_t value)
+{
+    switch (reg) {
+    case 0x00:
+        if (value & 0x8000) {
+            sim_reset();
+        } else {
+            sim.cfg = value;
+            restart();
+        }
+        break;
+    case 0x01:
+        sim.adc_cfg = value;
+        restart();
+        break;
+    case 0x02:
+        sim.shunt_cal = value & 0x7FFF;
+        break;
+    case 0x0B:
+        sim.diag = (sim.diag & 0x0FFF) | (value & 0xF000);
+        break;
+    }
+}
+
+static int sim_write(const uint8_t* src, size_t len)
+{
+    if (len >= 1)
+        sim.pointer = src[0];
+
+    if (len >= 3)
+        write_reg(sim.pointer, (src[1] << 8) | src[2]);
+
+    return (int)len;
+}
+
+static int sim_read(uint8_t* dst, size_t len)
+{
+    uint32_t value = 0;
+    size_t size = 2;
+
+    update();
+
+    switch (sim.pointer) {
+    case 0x00: value = sim.cfg; break;
+    case 0x01: value = sim.adc_cfg; break;
+    case 0x02: value = sim.shunt_cal; break;
+    case 0x04: value = (sim.vshunt & 0xFFFFF) << 4; size = 3; break;
+    case 0x05: value = (sim.vbus & 0xFFFFF) << 4; size = 3; break;
+    case 0x07: value = (sim.current & 0xFFFFF) << 4; size = 3; break;
+    case 0x08: value = sim.power; size = 3; break;
+    case 0x0B:
+        // Reading DIAG_ALRT clears CNVRF and releases ALERT.
+        value = sim.diag | (sim.cnvrf ? 0x02 : 0);
+        if (!sim.cnvrf)
+            bench_stats.not_ready++;
+        sim.cnvrf = false;
+        break;
+    case 0x3E: value = 0x5449; break;
+    case 0x3F: value = 0x2281; break;
+    }
+
+    for (size_t i = 0; i < len; i++)
+        dst[i] = i < size ? value >> (8 * (size - 1 - i)) : 0;
+
+    return (int)len;
+}
+
+// ALERT follows CNVRF when conversion ready is enabled (CNVR).
+static bool sim_alert(void)
+{
+    update();
+    return (sim.diag & (1 << 14)) && sim.cnvrf;
+}
+
+const struct sim_sensor sim_ina228 = {
+    .name   = "ina228",
+    .reset  = sim_reset,
+    .write  = sim_write,
+    .read   = sim_read,
+    .alert  = sim_alert,
+};
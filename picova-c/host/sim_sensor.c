@@ -0,0 +1,22 @@
+#include <math.h>
+#include "sim_sensor.h"
+
+const struct sim_sensor* sim_sensor = &sim_ina219;
+
+float sim_load_mA(uint64_t t_us)
+{
+    const double t = t_us * 1e-6;
+    return 10.f + (fmod(t, 1.0) < 0.5 ? 0.f : 40.f) + (fmod(t, 0.1) < 0.002 ? 150.f : 0.f);
+}
+
+float sim_load_V(float mA)
+{
+    return 5.f - mA * 1e-3f * SIM_SHUNT_OHMS * 5;
+}
+
+double sim_marker_hz = 0;
+
+uint8_t sim_markers(uint64_t t_us)
+{
+    return (uint64_t)(t_us * sim_marker_hz * 1e-6) & 0x0F;
+}
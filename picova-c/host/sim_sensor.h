@@ -0,0 +1,71 @@
+#ifndef _SIM_SENSOR_H
+#define _SIM_SENSOR_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Register-level models of the supported sensors for the host benchmark.
+// Conversions complete in real time at the rate set by the configuration
+// registers, the data registers follow a synthetic load, and the ready and
+// overflow flags behave as described in each datasheet. The I2C stub passes
+// the bytes of each transfer to whichever model `sim_sensor` points at.
+
+#define SIM_SENSOR_ADDR 0x40
+#define SIM_SHUNT_OHMS 0.1f
+
+// The sensor's pins as main.c wires them.
+#define SIM_PIN_SDA 12
+#define SIM_PIN_SCL 13
+#define SIM_PIN_VCC 14
+#define SIM_PIN_ALERT 15
+#define SIM_PIN_MARKERS 16
+
+// Faults the I2C stub can inject, one every `sim_fault_every_us`.
+enum sim_fault
+{
+    SIM_FAULT_NONE,
+    SIM_FAULT_STUCK_BUS,    // SDA held low, so transfers time out, until SCL is clocked
+    SIM_FAULT_BROWNOUT,     // Transfers NAK until VCC is cycled, then the sensor is reset
+};
+
+extern enum sim_fault sim_fault;
+extern uint64_t sim_fault_every_us;
+
+// The four marker inputs count up in binary `sim_marker_hz` times a second,
+// like a device under test stepping through states, or stay low if it is 0.
+extern double sim_marker_hz;
+uint8_t sim_markers(uint64_t t_us);
+
+struct sim_sensor
+{
+    const char* name;
+    void (*reset)(void);
+    int (*write)(const uint8_t* src, size_t len);
+    int (*read)(uint8_t* dst, size_t len);
+
+    // Whether the ALERT pin is pulled low. NULL for parts without one.
+    bool (*alert)(void);
+};
+
+extern const struct sim_sensor sim_ina219;
+extern const struct sim_sensor sim_ina226;
+extern const struct sim_sensor sim_ina228;
+
+// The model on the bus, sim_ina219 unless the benchmark chooses another.
+extern const struct sim_sensor* sim_sensor;
+
+// The same load as picova-vdev: steps of 40 mA every half second with short
+// 150 mA bursts every 100 ms.
+float sim_load_mA(uint64_t t_us);
+float sim_load_V(float mA);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SIM_SENSOR_H
@@ -1,5 +1,14 @@
 #include <math.h>
+#include <stdlib.h>
 #include "ina219.h"
+#include "ina219_calc.h"
+#include "sensor.h"
+
+// Operating mode bits of the configuration register, continuous conversions.
+static const uint16_t INA219_CFG_MODE = 0x07;
+static const uint16_t INA219_CFG_MODE_SHUNT = 0x05;
+static const uint16_t INA219_CFG_MODE_BUS = 0x06;
+static const uint16_t INA219_CFG_MODE_SHUNT_BUS = 0x07;
 
 enum ina219_reg
 {
@@ -9,24 +18,32 @@ enum ina219_reg
     INA219_REG_POWER,
     INA219_REG_CURRENT,
     INA219_REG_CALIB,
+    INA219_REG_UNKNOWN = 0xFF,
 };
 
-static const uint16_t INA219_BUS_OVF  = (1 << 0);
-static const uint16_t INA219_BUS_CNVR = (1 << 1);
 static const uint TIMEOUT_US = 1000;
 
+// The INA219 keeps its register pointer between transfers, so the pointer is
+// only written when moving to a different register. After an error its
+// position is unknown.
 static int ina219_read_reg(ina219_t* hw, uint8_t reg, uint16_t* value)
 {
     int err;
     uint8_t buff[2];
 
-    err = i2c_write_timeout_us(hw->i2c, hw->addr, &reg, sizeof(reg), true, TIMEOUT_US);
-    if (err < 0)
-        return err;
+    if (hw->pointer != reg) {
+        hw->pointer = INA219_REG_UNKNOWN;
+        err = i2c_write_timeout_us(hw->i2c, hw->addr, &reg, sizeof(reg), true, TIMEOUT_US);
+        if (err < 0)
+            return err;
+        hw->pointer = reg;
+    }
 
     err = i2c_read_timeout_us(hw->i2c, hw->addr, buff, sizeof(buff), false, TIMEOUT_US);
-    if (err < 0)
+    if (err < 0) {
+        hw->pointer = INA219_REG_UNKNOWN;
         return err;
+    }
 
     *value = (buff[0] << 8) | buff[1];
     return PICO_OK;
@@ -40,18 +57,27 @@ static int ina219_write_reg(ina219_t* hw, uint8_t reg, uint16_t value)
         value & 0xFF
     };
 
-    return i2c_write_timeout_us(hw->i2c, hw->addr, buff, sizeof(buff), false, TIMEOUT_US);
+    int err = i2c_write_timeout_us(hw->i2c, hw->addr, buff, sizeof(buff), false, TIMEOUT_US);
+    hw->pointer = err < 0 ? INA219_REG_UNKNOWN : reg;
+    return err;
 }
 
 int ina219_init(ina219_t* hw, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms)
 {
     hw->i2c = i2c;
     hw->addr = addr;
+    hw->pointer = INA219_REG_UNKNOWN;
+    hw->channels = SENSOR_CHANNEL_ALL;
+    hw->bus_every = 1;
+    hw->bus = 0;
+    hw->bus_converting = false;
+    hw->samples = 0;
     hw->cfg = 0x399F;
     hw->cal = 0;
     hw->current_lsb = 0.f;
     hw->power_lsb = 0.f;
     hw->shunt_ohms = shunt_ohms;
+    return PICO_OK;
 }
 
 int ina219_reset(ina219_t* hw)
@@ -79,18 +105,41 @@ int ina219_configure(ina219_t* hw, const ina219_cfg_t* cfg)
     reg |= (bus_adc << 7);
     reg |= (shunt_adc << 3);
 
-    reg |= 0x07; // Mode = shunt and bus, continuous
+    switch (cfg->mode) {
+    case INA219_MODE_SHUNT:     reg |= INA219_CFG_MODE_SHUNT; break;
+    case INA219_MODE_BUS:       reg |= INA219_CFG_MODE_BUS; break;
+    default:                    reg |= INA219_CFG_MODE_SHUNT_BUS; break;
+    }
 
+    // The last bus reading no longer applies, so the schedule starts over
+    // with a new one. Writing the mode abandons any interleaved conversion.
+    hw->bus = 0;
+    hw->bus_converting = false;
+    hw->samples = 0;
     hw->cfg = reg;
     return ina219_write_reg(hw, INA219_REG_CFG, reg);
 }
 
+// Inverse of the ADC setting encoding in ina219_configure().
+static enum ina219_adc ina219_calc_adc(uint8_t bits)
+{
+    if (bits & 0x08)
+        return bits == 0x08 ? INA219_ADC_BITS_12 : bits - 5;
+
+    return bits & 0x03;
+}
+
 static void ina219_calc_config(uint16_t reg, ina219_cfg_t* cfg)
 {
+    switch (reg & INA219_CFG_MODE) {
+    case INA219_CFG_MODE_SHUNT: cfg->mode = INA219_MODE_SHUNT; break;
+    case INA219_CFG_MODE_BUS:   cfg->mode = INA219_MODE_BUS; break;
+    default:                    cfg->mode = INA219_MODE_SHUNT_BUS; break;
+    }
     cfg->bus_range = (reg >> 13) & 0x01;
     cfg->shunt_range = (reg >> 11) & 0x03;
-    cfg->bus_adc = (reg >> 7) & 0x0F;
-    cfg->shunt_adc = (reg >> 3) & 0x0F;
+    cfg->bus_adc = ina219_calc_adc((reg >> 7) & 0x0F);
+    cfg->shunt_adc = ina219_calc_adc((reg >> 3) & 0x0F);
 }
 
 void ina219_get_config(ina219_t* hw, ina219_cfg_t* cfg)
@@ -125,6 +174,24 @@ int ina219_calibrate(ina219_t* hw)
     return ina219_write_reg(hw, INA219_REG_CALIB, hw->cal);
 }
 
+void ina219_get_calibration(const ina219_t* hw, uint16_t* cal, float* current_lsb, float* power_lsb)
+{
+    *cal = hw->cal;
+    *current_lsb = hw->current_lsb;
+    *power_lsb = hw->power_lsb;
+}
+
+// Restore a calibration previously taken with ina219_get_calibration(),
+// without recomputing it.
+int ina219_set_calibration(ina219_t* hw, uint16_t cal, float current_lsb, float power_lsb)
+{
+    hw->cal = cal;
+    hw->current_lsb = current_lsb;
+    hw->power_lsb = power_lsb;
+
+    return ina219_write_reg(hw, INA219_REG_CALIB, hw->cal);
+}
+
 int ina219_increase_bus_range(ina219_t* hw)
 {
     int err;
@@ -163,32 +230,6 @@ int ina219_increase_shunt_range(ina219_t* hw)
     return PICO_OK;
 }
 
-static float ina219_calc_shunt_mV(uint16_t reg)
-{
-    return ((int16_t)reg) * 10e-3f;
-}
-
-static float ina219_calc_bus_V(uint16_t reg)
-{
-    if (reg & INA219_BUS_OVF)
-        return INFINITY;
-
-    if (!(reg & INA219_BUS_CNVR))
-        return NAN;
-
-    return (reg >> 3) * 4e-3f;
-}
-
-static float ina219_calc_power_mW(uint16_t reg, float lsb)
-{
-    return reg * lsb * 1000.f;
-}
-
-static float ina219_calc_current_mA(uint16_t reg, float lsb)
-{
-    return (int16_t)reg * lsb * 1000.f;
-}
-
 float ina219_read_shunt_mV(ina219_t* hw)
 {
     uint16_t reg;
@@ -251,12 +292,112 @@ int ina219_read_data(ina219_t* hw, ina219_data_t* data)
     if (err < 0)
         return err;
 
+    data->bus_held = false;
     data->current_lsb = hw->current_lsb;
     data->power_lsb = hw->power_lsb;
 
     return PICO_OK;
 }
 
+// Choose the registers ina219_read_scheduled() fetches. `channels` is a mask
+// of enum sensor_channel; see struct sensor_schedule.
+int ina219_set_schedule(ina219_t* hw, uint8_t channels, uint8_t bus_every)
+{
+    hw->channels = channels & SENSOR_CHANNEL_ALL;
+    hw->bus_every = bus_every;
+    hw->samples = 0;
+    return PICO_OK;
+}
+
+// Read the registers chosen with ina219_set_schedule() in as few bytes as
+// possible: CURRENT is fetched first if the pointer is already on it, and
+// BUS first otherwise, so reading both costs one pointer write, not two.
+// POWER has to come last because reading it clears CNVR. When it isn't read
+// it is derived as the INA219 does, from bus × current; CNVR then stays set
+// after the first conversion, and reads are paced by the caller's timer
+// alone. A bus reading without CNVR is never reused.
+//
+// In shunt-only mode a bus voltage that is due is converted in between
+// samples instead: the mode is switched to shunt and bus for one conversion
+// (which clears CNVR), its result is read as the next sample, and the mode
+// is switched back. Every other sample carries the last bus voltage, marked
+// as held.
+int ina219_read_scheduled(ina219_t* hw, ina219_data_t* data)
+{
+    int err;
+    const bool shunt_only = (hw->cfg & INA219_CFG_MODE) == INA219_CFG_MODE_SHUNT;
+    const bool read_current = hw->channels & SENSOR_CHANNEL_CURRENT;
+    const bool read_power = hw->channels & SENSOR_CHANNEL_POWER;
+    const bool bus_due = (hw->channels & SENSOR_CHANNEL_BUS)
+        && (hw->bus_every ? hw->samples % hw->bus_every == 0 : hw->samples == 0);
+    const bool read_bus = !(hw->bus & INA219_BUS_CNVR)
+        || hw->bus_converting
+        || (bus_due && !shunt_only);
+    const bool current_first = !read_bus || hw->pointer == INA219_REG_CURRENT;
+
+    data->current = 0;
+
+    if (read_current && current_first) {
+        err = ina219_read_reg(hw, INA219_REG_CURRENT, &data->current);
+        if (err < 0)
+            return err;
+    }
+
+    if (read_bus) {
+        err = ina219_read_reg(hw, INA219_REG_BUS, &hw->bus);
+        if (err < 0)
+            return err;
+    }
+
+    const bool ready = hw->bus & INA219_BUS_CNVR;
+    const bool fresh = read_bus && (!shunt_only || hw->bus_converting);
+
+    if (read_current && !current_first) {
+        err = ina219_read_reg(hw, INA219_REG_CURRENT, &data->current);
+        if (err < 0)
+            return err;
+    }
+
+    if (read_power) {
+        err = ina219_read_reg(hw, INA219_REG_POWER, &data->power);
+        if (err < 0)
+            return err;
+    } else {
+        const int16_t current = data->current;
+        data->power = (uint32_t)abs(current) * (hw->bus >> 3) / 5000;
+    }
+
+    data->bus = hw->bus;
+    data->bus_held = !fresh;
+    data->current_lsb = hw->current_lsb;
+    data->power_lsb = hw->power_lsb;
+
+    if (!ready)
+        return PICO_OK;
+
+    if (hw->bus_converting) {
+        // Back to shunt only. Its first conversion clears CNVR again, so
+        // the next read checks it before trusting CURRENT.
+        err = ina219_write_reg(hw, INA219_REG_CFG, hw->cfg);
+        if (err < 0)
+            return err;
+
+        hw->bus &= ~INA219_BUS_CNVR;
+        hw->bus_converting = false;
+    } else if (shunt_only && bus_due) {
+        err = ina219_write_reg(hw, INA219_REG_CFG,
+            (hw->cfg & ~INA219_CFG_MODE) | INA219_CFG_MODE_SHUNT_BUS);
+        if (err < 0)
+            return err;
+
+        hw->bus_converting = true;
+    }
+
+    hw->samples++;
+
+    return PICO_OK;
+}
+
 bool ina219_data_overflowed(const ina219_data_t* data)
 {
     return data->bus & INA219_BUS_OVF;
@@ -276,6 +417,11 @@ bool ina219_data_shunt_clipped(const ina219_data_t* data)
         || (current < -nearly_full_scale);
 }
 
+bool ina219_data_bus_held(const ina219_data_t* data)
+{
+    return data->bus_held;
+}
+
 bool ina219_data_bus_clipped(const ina219_data_t* data)
 {
     const uint16_t bus = data->bus >> 3;
@@ -299,6 +445,19 @@ float ina219_data_current_mA(const ina219_data_t* data)
     return ina219_calc_current_mA(data->current, data->current_lsb);
 }
 
+void ina219_data_raw(const ina219_data_t* data, uint16_t* bus, uint16_t* current, uint16_t* power)
+{
+    *bus = data->bus;
+    *current = data->current;
+    *power = data->power;
+}
+
+void ina219_data_lsb(const ina219_data_t* data, float* current_lsb, float* power_lsb)
+{
+    *current_lsb = data->current_lsb;
+    *power_lsb = data->power_lsb;
+}
+
 uint32_t ina219_adc_conversion_us(enum ina219_adc adc)
 {
     switch (adc) {
@@ -314,12 +473,19 @@ uint32_t ina219_adc_conversion_us(enum ina219_adc adc)
     case INA219_ADC_SAMPLES_64:     return 34050;
     case INA219_ADC_SAMPLES_128:    return 68100;
     }
+
+    return 0;
 }
 
 uint32_t ina219_cfg_conversion_us(const ina219_cfg_t* cfg)
 {
-    return ina219_adc_conversion_us(cfg->bus_adc)
-         + ina219_adc_conversion_us(cfg->shunt_adc);
+    switch (cfg->mode) {
+    case INA219_MODE_SHUNT:     return ina219_adc_conversion_us(cfg->shunt_adc);
+    case INA219_MODE_BUS:       return ina219_adc_conversion_us(cfg->bus_adc);
+    default:
+        return ina219_adc_conversion_us(cfg->bus_adc)
+             + ina219_adc_conversion_us(cfg->shunt_adc);
+    }
 }
 
 uint32_t ina219_conversion_us(const ina219_t* hw)
@@ -328,3 +494,126 @@ uint32_t ina219_conversion_us(const ina219_t* hw)
     ina219_calc_config(hw->cfg, &cfg);
     return ina219_cfg_conversion_us(&cfg);
 }
+
+// The INA219 as a generic sensor (see sensor.h). It has no ALERT pin, so it
+// is read on a timer.
+
+static int ina219_sensor_reset(void* hw)
+{
+    return ina219_reset(hw);
+}
+
+static int ina219_sensor_configure(void* hw, const sensor_cfg_t* cfg)
+{
+    const ina219_cfg_t c = {
+        .mode        = cfg->mode,
+        .bus_range   = cfg->bus_range,
+        .shunt_range = cfg->shunt_range,
+        .bus_adc     = cfg->bus_adc,
+        .shunt_adc   = cfg->shunt_adc,
+    };
+
+    return ina219_configure(hw, &c);
+}
+
+static void ina219_sensor_get_config(void* hw, sensor_cfg_t* cfg)
+{
+    ina219_cfg_t c;
+    ina219_get_config(hw, &c);
+
+    *cfg = (sensor_cfg_t){
+        .mode        = c.mode,
+        .bus_range   = c.bus_range,
+        .shunt_range = c.shunt_range,
+        .bus_adc     = c.bus_adc,
+        .shunt_adc   = c.shunt_adc,
+    };
+}
+
+static int ina219_sensor_calibrate(void* hw)
+{
+    return ina219_calibrate(hw);
+}
+
+static void ina219_sensor_get_calibration(const void* hw, sensor_cal_t* cal)
+{
+    ina219_get_calibration(hw, &cal->cal, &cal->current_lsb, &cal->power_lsb);
+}
+
+static int ina219_sensor_set_calibration(void* hw, const sensor_cal_t* cal)
+{
+    return ina219_set_calibration(hw, cal->cal, cal->current_lsb, cal->power_lsb);
+}
+
+// ina219_configure() already selects continuous conversions.
+static int ina219_sensor_start(void* hw)
+{
+    return PICO_OK;
+}
+
+static int ina219_sensor_schedule(void* hw, const sensor_schedule_t* sched)
+{
+    return ina219_set_schedule(hw, sched->channels, sched->bus_every);
+}
+
+static int ina219_sensor_read(void* hw, sensor_data_t* data)
+{
+    ina219_data_t d;
+    int err = ina219_read_scheduled(hw, &d);
+    if (err < 0)
+        return err;
+
+    if (!ina219_data_ready(&d))
+        return SENSOR_NOT_READY;
+
+    if (ina219_data_overflowed(&d) || ina219_data_shunt_clipped(&d)) {
+        err = ina219_increase_shunt_range(hw);
+        return err < 0 ? err : SENSOR_RANGED;
+    }
+
+    if (!ina219_data_bus_held(&d) && ina219_data_bus_clipped(&d)) {
+        err = ina219_increase_bus_range(hw);
+        return err < 0 ? err : SENSOR_RANGED;
+    }
+
+    data->bus = d.bus;
+    data->current = d.current;
+    data->power = d.power;
+    data->flags = ina219_data_bus_held(&d) ? SENSOR_DATA_BUS_HELD : 0;
+    return SENSOR_SAMPLE;
+}
+
+static void ina219_sensor_convert(const sensor_data_t* data, const sensor_lsb_t* lsb, float* V, float* mA, float* mW)
+{
+    *V = ina219_calc_bus_V(data->bus);
+    *mA = ina219_calc_current_mA(data->current, lsb->current_lsb);
+    *mW = ina219_calc_power_mW(data->power, lsb->power_lsb);
+}
+
+static uint32_t ina219_sensor_conversion_us(const sensor_cfg_t* cfg)
+{
+    const ina219_cfg_t c = {
+        .mode       = cfg->mode,
+        .bus_adc    = cfg->bus_adc,
+        .shunt_adc  = cfg->shunt_adc,
+    };
+
+    return ina219_cfg_conversion_us(&c);
+}
+
+const struct sensor_ops ina219_sensor_ops = {
+    .type               = SENSOR_INA219,
+    .name               = "INA219",
+    .has_alert          = false,
+    .reset              = ina219_sensor_reset,
+    .configure          = ina219_sensor_configure,
+    .get_config         = ina219_sensor_get_config,
+    .calibrate          = ina219_sensor_calibrate,
+    .get_calibration    = ina219_sensor_get_calibration,
+    .set_calibration    = ina219_sensor_set_calibration,
+    .start              = ina219_sensor_start,
+    .schedule           = ina219_sensor_schedule,
+    .read               = ina219_sensor_read,
+    .convert            = ina219_sensor_convert,
+    .conversion_us      = ina219_sensor_conversion_us,
+};
@@ -16,6 +16,12 @@ struct ina219
 {
     i2c_inst_t* i2c;
     uint8_t addr;
+    uint8_t pointer;        // Register the INA219's pointer targets
+    uint8_t channels;       // See ina219_set_schedule()
+    uint8_t bus_every;
+    uint16_t bus;           // Last bus register read
+    bool bus_converting;    // A bus conversion is interleaved (shunt-only mode)
+    uint32_t samples;
     uint16_t cfg;
     uint16_t cal;
     float current_lsb;
@@ -32,6 +38,7 @@ struct ina219_data
     uint16_t bus;
     uint16_t power;
     uint16_t current;
+    bool bus_held;
     float current_lsb;
     float power_lsb;
 };
@@ -65,8 +72,17 @@ enum ina219_adc
     INA219_ADC_SAMPLES_128,
 };
 
+// Which ADCs convert continuously. The values match enum sensor_mode.
+enum ina219_mode
+{
+    INA219_MODE_SHUNT_BUS,
+    INA219_MODE_SHUNT,
+    INA219_MODE_BUS,
+};
+
 struct ina219_cfg
 {
+    enum ina219_mode mode;
     enum ina219_bus_range bus_range;
     enum ina219_shunt_range shunt_range;
     enum ina219_adc bus_adc;
@@ -82,6 +98,8 @@ int ina219_reset(ina219_t* hw);
 int ina219_configure(ina219_t* hw, const ina219_cfg_t* cfg);
 void ina219_get_config(ina219_t* hw, ina219_cfg_t* cfg);
 int ina219_calibrate(ina219_t* hw);
+void ina219_get_calibration(const ina219_t* hw, uint16_t* cal, float* current_lsb, float* power_lsb);
+int ina219_set_calibration(ina219_t* hw, uint16_t cal, float current_lsb, float power_lsb);
 int ina219_increase_bus_range(ina219_t* hw);
 int ina219_increase_shunt_range(ina219_t* hw);
 
@@ -92,13 +110,18 @@ float ina219_read_power_mW(ina219_t* hw);
 float ina219_read_current_mA(ina219_t* hw);
 
 int ina219_read_data(ina219_t* hw, ina219_data_t* data);
+int ina219_set_schedule(ina219_t* hw, uint8_t channels, uint8_t bus_every);
+int ina219_read_scheduled(ina219_t* hw, ina219_data_t* data);
 bool ina219_data_overflowed(const ina219_data_t* data);
 bool ina219_data_ready(const ina219_data_t* data);
 bool ina219_data_bus_clipped(const ina219_data_t* data);
 bool ina219_data_shunt_clipped(const ina219_data_t* data);
+bool ina219_data_bus_held(const ina219_data_t* data);
 float ina219_data_bus_V(const ina219_data_t* data);
 float ina219_data_power_mW(const ina219_data_t* data);
 float ina219_data_current_mA(const ina219_data_t* data);
+void ina219_data_raw(const ina219_data_t* data, uint16_t* bus, uint16_t* current, uint16_t* power);
+void ina219_data_lsb(const ina219_data_t* data, float* current_lsb, float* power_lsb);
 
 uint32_t ina219_adc_conversion_us(enum ina219_adc adc);
 uint32_t ina219_cfg_conversion_us(const ina219_cfg_t* cfg);
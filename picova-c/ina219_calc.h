@@ -0,0 +1,49 @@
+#ifndef _INA219_CALC_H
+#define _INA219_CALC_H
+
+#include <math.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Conversions from raw INA219 register values to physical units. These have
+// no dependency on the Pico SDK so that host tools decoding raw register
+// frames (see picova_stream.h) produce exactly the same numbers as the
+// firmware.
+
+static const uint16_t INA219_BUS_OVF  = (1 << 0);
+static const uint16_t INA219_BUS_CNVR = (1 << 1);
+
+static inline float ina219_calc_shunt_mV(uint16_t reg)
+{
+    return ((int16_t)reg) * 10e-3f;
+}
+
+static inline float ina219_calc_bus_V(uint16_t reg)
+{
+    if (reg & INA219_BUS_OVF)
+        return INFINITY;
+
+    if (!(reg & INA219_BUS_CNVR))
+        return NAN;
+
+    return (reg >> 3) * 4e-3f;
+}
+
+static inline float ina219_calc_power_mW(uint16_t reg, float lsb)
+{
+    return reg * lsb * 1000.f;
+}
+
+static inline float ina219_calc_current_mA(uint16_t reg, float lsb)
+{
+    return (int16_t)reg * lsb * 1000.f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INA219_CALC_H
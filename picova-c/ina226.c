@@ -0,0 +1,206 @@
+#include "ina226.h"
+
+enum ina226_reg
+{
+    INA226_REG_CFG,
+    INA226_REG_SHUNT,
+    INA226_REG_BUS,
+    INA226_REG_POWER,
+    INA226_REG_CURRENT,
+    INA226_REG_CALIB,
+    INA226_REG_MASK,
+    INA226_REG_ALERT_LIMIT,
+    INA226_REG_MANUFACTURER_ID = 0xFE,
+    INA226_REG_DIE_ID = 0xFF,
+};
+
+static const uint16_t INA226_MASK_CNVR = (1 << 10);
+static const uint16_t INA226_MASK_CVRF = (1 << 3);
+
+static const uint16_t INA226_MANUFACTURER_ID = 0x5449; // "TI"
+static const uint16_t INA226_DIE_ID = 0x2260;
+
+static const uint TIMEOUT_US = 1000;
+
+static const uint32_t ct_us[] = { 140, 204, 332, 588, 1100, 2116, 4156, 8244 };
+static const uint32_t avg_n[] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+static int ina226_read_reg(i2c_inst_t* i2c, uint8_t addr, uint8_t reg, uint16_t* value)
+{
+    int err;
+    uint8_t buff[2];
+
+    err = i2c_write_timeout_us(i2c, addr, &reg, sizeof(reg), true, TIMEOUT_US);
+    if (err < 0)
+        return err;
+
+    err = i2c_read_timeout_us(i2c, addr, buff, sizeof(buff), false, TIMEOUT_US);
+    if (err < 0)
+        return err;
+
+    *value = (buff[0] << 8) | buff[1];
+    return PICO_OK;
+}
+
+static int ina226_write_reg(ina226_t* hw, uint8_t reg, uint16_t value)
+{
+    const uint8_t buff[3] = {
+        reg,
+        value >> 8,
+        value & 0xFF
+    };
+
+    return i2c_write_timeout_us(hw->i2c, hw->addr, buff, sizeof(buff), false, TIMEOUT_US);
+}
+
+bool ina226_probe(i2c_inst_t* i2c, uint8_t addr)
+{
+    uint16_t manufacturer, die;
+
+    return ina226_read_reg(i2c, addr, INA226_REG_MANUFACTURER_ID, &manufacturer) == PICO_OK
+        && ina226_read_reg(i2c, addr, INA226_REG_DIE_ID, &die) == PICO_OK
+        && manufacturer == INA226_MANUFACTURER_ID
+        && die == INA226_DIE_ID;
+}
+
+int ina226_init(ina226_t* hw, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms)
+{
+    hw->i2c = i2c;
+    hw->addr = addr;
+    hw->cfg = 0x4127;
+    hw->cal = 0;
+    hw->current_lsb = 0.f;
+    hw->power_lsb = 0.f;
+    hw->shunt_ohms = shunt_ohms;
+    return PICO_OK;
+}
+
+static int ina226_reset(void* arg)
+{
+    ina226_t* hw = arg;
+    hw->cfg = 0x4127;
+    return ina226_write_reg(hw, INA226_REG_CFG, 0x8000);
+}
+
+static int ina226_configure(void* arg, const sensor_cfg_t* cfg)
+{
+    ina226_t* hw = arg;
+    uint16_t reg = 0x4000; // Reserved, reads back as 1
+
+    reg |= (cfg->averaging & 0x07) << 9;
+    reg |= (cfg->bus_adc & 0x07) << 6;
+    reg |= (cfg->shunt_adc & 0x07) << 3;
+    reg |= 0x07; // Mode = shunt and bus, continuous
+
+    hw->cfg = reg;
+    return ina226_write_reg(hw, INA226_REG_CFG, reg);
+}
+
+static void ina226_get_config(void* arg, sensor_cfg_t* cfg)
+{
+    const ina226_t* hw = arg;
+
+    *cfg = (sensor_cfg_t){
+        .averaging = (hw->cfg >> 9) & 0x07,
+        .bus_adc   = (hw->cfg >> 6) & 0x07,
+        .shunt_adc = (hw->cfg >> 3) & 0x07,
+    };
+}
+
+static int ina226_calibrate(void* arg)
+{
+    ina226_t* hw = arg;
+    const float max_current_A = 0.08192f / hw->shunt_ohms;
+
+    hw->current_lsb = max_current_A / (1 << 15);
+    hw->cal = 0.00512f / (hw->current_lsb * hw->shunt_ohms);
+    hw->power_lsb = 25 * hw->current_lsb;
+
+    return ina226_write_reg(hw, INA226_REG_CALIB, hw->cal);
+}
+
+static void ina226_get_calibration(const void* arg, sensor_cal_t* cal)
+{
+    const ina226_t* hw = arg;
+    cal->cal = hw->cal;
+    cal->current_lsb = hw->current_lsb;
+    cal->power_lsb = hw->power_lsb;
+}
+
+static int ina226_set_calibration(void* arg, const sensor_cal_t* cal)
+{
+    ina226_t* hw = arg;
+    hw->cal = cal->cal;
+    hw->current_lsb = cal->current_lsb;
+    hw->power_lsb = cal->power_lsb;
+
+    return ina226_write_reg(hw, INA226_REG_CALIB, hw->cal);
+}
+
+// Pull ALERT low at the end of each conversion. It is released, and CVRF
+// cleared, by reading the Mask/Enable register in ina226_read().
+static int ina226_start(void* arg)
+{
+    return ina226_write_reg(arg, INA226_REG_MASK, INA226_MASK_CNVR);
+}
+
+static int ina226_read(void* arg, sensor_data_t* data)
+{
+    ina226_t* hw = arg;
+    int err;
+    uint16_t mask, bus, current, power;
+
+    err = ina226_read_reg(hw->i2c, hw->addr, INA226_REG_MASK, &mask);
+    if (err < 0)
+        return err;
+
+    if (!(mask & INA226_MASK_CVRF))
+        return SENSOR_NOT_READY;
+
+    err = ina226_read_reg(hw->i2c, hw->addr, INA226_REG_BUS, &bus);
+    if (err < 0)
+        return err;
+
+    err = ina226_read_reg(hw->i2c, hw->addr, INA226_REG_CURRENT, &current);
+    if (err < 0)
+        return err;
+
+    err = ina226_read_reg(hw->i2c, hw->addr, INA226_REG_POWER, &power);
+    if (err < 0)
+        return err;
+
+    data->bus = bus;
+    data->current = current;
+    data->power = power;
+    data->flags = 0;
+    return SENSOR_SAMPLE;
+}
+
+static void ina226_convert(const sensor_data_t* data, const sensor_lsb_t* lsb, float* V, float* mA, float* mW)
+{
+    *V = data->bus * 1.25e-3f;
+    *mA = (int16_t)data->current * lsb->current_lsb * 1000.f;
+    *mW = data->power * lsb->power_lsb * 1000.f;
+}
+
+static uint32_t ina226_conversion_us(const sensor_cfg_t* cfg)
+{
+    return (ct_us[cfg->bus_adc & 0x07] + ct_us[cfg->shunt_adc & 0x07])
+         * avg_n[cfg->averaging & 0x07];
+}
+
+const struct sensor_ops ina226_sensor_ops = {
+    .type               = SENSOR_INA226,
+    .name               = "INA226",
+    .has_alert          = true,
+    .reset              = ina226_reset,
+    .configure          = ina226_configure,
+    .get_config         = ina226_get_config,
+    .calibrate          = ina226_calibrate,
+    .get_calibration    = ina226_get_calibration,
+    .set_calibration    = ina226_set_calibration,
+    .start              = ina226_start,
+    .read               = ina226_read,
+    .convert            = ina226_convert,
+    .conversion_us      = ina226_conversion_us,
+};
@@ -0,0 +1,66 @@
+#ifndef _INA226_H
+#define _INA226_H
+
+#include "hardware/i2c.h"
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INA226_ADDR_DEFAULT 0x40
+
+// An instance of an INA226 sensor. Do not access the members of this struct
+// directly. Initialise it with ina226_init() and then use it through
+// ina226_sensor_ops (see sensor.h).
+//
+// The INA226 has a single 81.92 mV shunt range and a single 36 V bus range,
+// so there is nothing to autorange, but it averages in hardware and can
+// signal each conversion on its ALERT pin.
+struct ina226
+{
+    i2c_inst_t* i2c;
+    uint8_t addr;
+    uint16_t cfg;
+    uint16_t cal;
+    float current_lsb;
+    float power_lsb;
+    float shunt_ohms;
+};
+
+// Conversion times, for the bus_adc and shunt_adc fields of sensor_cfg_t.
+enum ina226_ct
+{
+    INA226_CT_140us,
+    INA226_CT_204us,
+    INA226_CT_332us,
+    INA226_CT_588us,
+    INA226_CT_1100us,
+    INA226_CT_2116us,
+    INA226_CT_4156us,
+    INA226_CT_8244us,
+};
+
+// Conversions averaged per sample, for the averaging field of sensor_cfg_t.
+enum ina226_avg
+{
+    INA226_AVG_1,
+    INA226_AVG_4,
+    INA226_AVG_16,
+    INA226_AVG_64,
+    INA226_AVG_128,
+    INA226_AVG_256,
+    INA226_AVG_512,
+    INA226_AVG_1024,
+};
+
+typedef struct ina226 ina226_t;
+
+bool ina226_probe(i2c_inst_t* i2c, uint8_t addr);
+int ina226_init(ina226_t* hw, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INA226_H
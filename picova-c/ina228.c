@@ -0,0 +1,267 @@
+#include "ina228.h"
+
+enum ina228_reg
+{
+    INA228_REG_CFG = 0x00,
+    INA228_REG_ADC_CFG = 0x01,
+    INA228_REG_SHUNT_CAL = 0x02,
+    INA228_REG_VSHUNT = 0x04,
+    INA228_REG_VBUS = 0x05,
+    INA228_REG_CURRENT = 0x07,
+    INA228_REG_POWER = 0x08,
+    INA228_REG_DIAG_ALRT = 0x0B,
+    INA228_REG_MANUFACTURER_ID = 0x3E,
+    INA228_REG_DEVICE_ID = 0x3F,
+};
+
+static const uint16_t INA228_CFG_ADCRANGE = (1 << 4);
+static const uint16_t INA228_DIAG_CNVR = (1 << 14);
+static const uint16_t INA228_DIAG_MATHOF = (1 << 9);
+static const uint16_t INA228_DIAG_CNVRF = (1 << 1);
+
+static const uint16_t INA228_MANUFACTURER_ID = 0x5449; // "TI"
+static const uint16_t INA228_DEVICE_ID = 0x228;
+
+static const uint TIMEOUT_US = 1000;
+
+static const uint32_t ct_us[] = { 50, 84, 150, 280, 540, 1052, 2074, 4120 };
+static const uint32_t avg_n[] = { 1, 4, 16, 64, 128, 256, 512, 1024 };
+
+// Read a register of `len` bytes (2 or 3), most significant byte first.
+static int ina228_read_reg(i2c_inst_t* i2c, uint8_t addr, uint8_t reg, uint32_t* value, size_t len)
+{
+    int err;
+    uint8_t buff[3];
+
+    err = i2c_write_timeout_us(i2c, addr, &reg, sizeof(reg), true, TIMEOUT_US);
+    if (err < 0)
+        return err;
+
+    err = i2c_read_timeout_us(i2c, addr, buff, len, false, TIMEOUT_US);
+    if (err < 0)
+        return err;
+
+    *value = 0;
+    for (size_t i = 0; i < len; i++)
+        *value = (*value << 8) | buff[i];
+    return PICO_OK;
+}
+
+static int ina228_write_reg(ina228_t* hw, uint8_t reg, uint16_t value)
+{
+    const uint8_t buff[3] = {
+        reg,
+        value >> 8,
+        value & 0xFF
+    };
+
+    return i2c_write_timeout_us(hw->i2c, hw->addr, buff, sizeof(buff), false, TIMEOUT_US);
+}
+
+bool ina228_probe(i2c_inst_t* i2c, uint8_t addr)
+{
+    uint32_t manufacturer, device;
+
+    // The low four bits of DEVICE_ID are the silicon revision.
+    return ina228_read_reg(i2c, addr, INA228_REG_MANUFACTURER_ID, &manufacturer, 2) == PICO_OK
+        && ina228_read_reg(i2c, addr, INA228_REG_DEVICE_ID, &device, 2) == PICO_OK
+        && manufacturer == INA228_MANUFACTURER_ID
+        && (device >> 4) == INA228_DEVICE_ID;
+}
+
+int ina228_init(ina228_t* hw, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms)
+{
+    hw->i2c = i2c;
+    hw->addr = addr;
+    hw->cfg = 0x0000;
+    hw->adc_cfg = 0xFB68;
+    hw->cal = 0;
+    hw->current_lsb = 0.f;
+    hw->power_lsb = 0.f;
+    hw->shunt_ohms = shunt_ohms;
+    return PICO_OK;
+}
+
+static int ina228_reset(void* arg)
+{
+    ina228_t* hw = arg;
+    hw->cfg = 0x0000;
+    hw->adc_cfg = 0xFB68;
+    return ina228_write_reg(hw, INA228_REG_CFG, 0x8000);
+}
+
+static int ina228_configure(void* arg, const sensor_cfg_t* cfg)
+{
+    ina228_t* hw = arg;
+    int err;
+
+    // ADCRANGE = 1 selects the more sensitive range.
+    const uint16_t reg = cfg->shunt_range == INA228_SHUNT_RANGE_40mV ? INA228_CFG_ADCRANGE : 0;
+    err = ina228_write_reg(hw, INA228_REG_CFG, reg);
+    if (err < 0)
+        return err;
+    hw->cfg = reg;
+
+    uint16_t adc = 0xB000; // Mode = shunt and bus, continuous
+    adc |= (cfg->bus_adc & 0x07) << 9;
+    adc |= (cfg->shunt_adc & 0x07) << 6;
+    adc |= (cfg->averaging & 0x07);
+
+    hw->adc_cfg = adc;
+    return ina228_write_reg(hw, INA228_REG_ADC_CFG, adc);
+}
+
+static void ina228_get_config(void* arg, sensor_cfg_t* cfg)
+{
+    const ina228_t* hw = arg;
+
+    *cfg = (sensor_cfg_t){
+        .shunt_range = (hw->cfg & INA228_CFG_ADCRANGE) ? INA228_SHUNT_RANGE_40mV : INA228_SHUNT_RANGE_160mV,
+        .bus_adc     = (hw->adc_cfg >> 9) & 0x07,
+        .shunt_adc   = (hw->adc_cfg >> 6) & 0x07,
+        .averaging   = hw->adc_cfg & 0x07,
+    };
+}
+
+static int ina228_calibrate(void* arg)
+{
+    ina228_t* hw = arg;
+    const bool sensitive = hw->cfg & INA228_CFG_ADCRANGE;
+    const float max_current_A = (sensitive ? 0.04096f : 0.16384f) / hw->shunt_ohms;
+
+    hw->current_lsb = max_current_A / (1 << 19);
+    hw->cal = 13107.2e6f * hw->current_lsb * hw->shunt_ohms * (sensitive ? 4 : 1);
+    hw->power_lsb = 3.2f * hw->current_lsb;
+
+    return ina228_write_reg(hw, INA228_REG_SHUNT_CAL, hw->cal);
+}
+
+static void ina228_get_calibration(const void* arg, sensor_cal_t* cal)
+{
+    const ina228_t* hw = arg;
+    cal->cal = hw->cal;
+    cal->current_lsb = hw->current_lsb;
+    cal->power_lsb = hw->power_lsb;
+}
+
+static int ina228_set_calibration(void* arg, const sensor_cal_t* cal)
+{
+    ina228_t* hw = arg;
+    hw->cal = cal->cal;
+    hw->current_lsb = cal->current_lsb;
+    hw->power_lsb = cal->power_lsb;
+
+    return ina228_write_reg(hw, INA228_REG_SHUNT_CAL, hw->cal);
+}
+
+// Pull ALERT low at the end of each conversion. With ALATCH clear it is
+// released, and CNVRF cleared, by reading DIAG_ALRT in ina228_read().
+static int ina228_start(void* arg)
+{
+    return ina228_write_reg(arg, INA228_REG_DIAG_ALRT, INA228_DIAG_CNVR);
+}
+
+static int ina228_increase_shunt_range(ina228_t* hw)
+{
+    int err;
+    sensor_cfg_t cfg;
+    ina228_get_config(hw, &cfg);
+
+    if (cfg.shunt_range < INA228_SHUNT_RANGE_160mV) {
+        cfg.shunt_range++;
+
+        err = ina228_configure(hw, &cfg);
+        if (err < 0)
+            return err;
+
+        err = ina228_calibrate(hw);
+        if (err < 0)
+            return err;
+    }
+
+    return PICO_OK;
+}
+
+static int32_t ina228_sign_extend_20(uint32_t value)
+{
+    return (int32_t)(value << 12) >> 12;
+}
+
+static bool ina228_shunt_clipped(uint32_t current)
+{
+    const int32_t value = ina228_sign_extend_20(current);
+    const int32_t nearly_full_scale = 0x7FF80;
+
+    return (value > nearly_full_scale)
+        || (value < -nearly_full_scale);
+}
+
+static int ina228_read(void* arg, sensor_data_t* data)
+{
+    ina228_t* hw = arg;
+    int err;
+    uint32_t diag, bus, current, power;
+
+    err = ina228_read_reg(hw->i2c, hw->addr, INA228_REG_DIAG_ALRT, &diag, 2);
+    if (err < 0)
+        return err;
+
+    if (!(diag & INA228_DIAG_CNVRF))
+        return SENSOR_NOT_READY;
+
+    err = ina228_read_reg(hw->i2c, hw->addr, INA228_REG_VBUS, &bus, 3);
+    if (err < 0)
+        return err;
+
+    err = ina228_read_reg(hw->i2c, hw->addr, INA228_REG_CURRENT, &current, 3);
+    if (err < 0)
+        return err;
+
+    err = ina228_read_reg(hw->i2c, hw->addr, INA228_REG_POWER, &power, 3);
+    if (err < 0)
+        return err;
+
+    // VBUS and CURRENT are 20 bits, left aligned in 24.
+    bus >>= 4;
+    current >>= 4;
+
+    if ((diag & INA228_DIAG_MATHOF) || ina228_shunt_clipped(current)) {
+        err = ina228_increase_shunt_range(hw);
+        return err < 0 ? err : SENSOR_RANGED;
+    }
+
+    data->bus = bus;
+    data->current = current;
+    data->power = power;
+    data->flags = 0;
+    return SENSOR_SAMPLE;
+}
+
+static void ina228_convert(const sensor_data_t* data, const sensor_lsb_t* lsb, float* V, float* mA, float* mW)
+{
+    *V = data->bus * 195.3125e-6f;
+    *mA = ina228_sign_extend_20(data->current) * lsb->current_lsb * 1000.f;
+    *mW = data->power * lsb->power_lsb * 1000.f;
+}
+
+static uint32_t ina228_conversion_us(const sensor_cfg_t* cfg)
+{
+    return (ct_us[cfg->bus_adc & 0x07] + ct_us[cfg->shunt_adc & 0x07])
+         * avg_n[cfg->averaging & 0x07];
+}
+
+const struct sensor_ops ina228_sensor_ops = {
+    .type               = SENSOR_INA228,
+    .name               = "INA228",
+    .has_alert          = true,
+    .reset              = ina228_reset,
+    .configure          = ina228_configure,
+    .get_config         = ina228_get_config,
+    .calibrate          = ina228_calibrate,
+    .get_calibration    = ina228_get_calibration,
+    .set_calibration    = ina228_set_calibration,
+    .start              = ina228_start,
+    .read               = ina228_read,
+    .convert            = ina228_convert,
+    .conversion_us      = ina228_conversion_us,
+};
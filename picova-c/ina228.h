@@ -0,0 +1,73 @@
+#ifndef _INA228_H
+#define _INA228_H
+
+#include "hardware/i2c.h"
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INA228_ADDR_DEFAULT 0x40
+
+// An instance of an INA228 sensor. Do not access the members of this struct
+// directly. Initialise it with ina228_init() and then use it through
+// ina228_sensor_ops (see sensor.h).
+//
+// The INA228 has 20-bit ADCs, a single 85 V bus range and two shunt ranges,
+// ±40.96 mV (shunt_range 0) and ±163.84 mV (shunt_range 1). Like the INA226
+// it can signal each conversion on its ALERT pin.
+struct ina228
+{
+    i2c_inst_t* i2c;
+    uint8_t addr;
+    uint16_t cfg;
+    uint16_t adc_cfg;
+    uint16_t cal;
+    float current_lsb;
+    float power_lsb;
+    float shunt_ohms;
+};
+
+enum ina228_shunt_range
+{
+    INA228_SHUNT_RANGE_40mV,
+    INA228_SHUNT_RANGE_160mV,
+};
+
+// Conversion times, for the bus_adc and shunt_adc fields of sensor_cfg_t.
+enum ina228_ct
+{
+    INA228_CT_50us,
+    INA228_CT_84us,
+    INA228_CT_150us,
+    INA228_CT_280us,
+    INA228_CT_540us,
+    INA228_CT_1052us,
+    INA228_CT_2074us,
+    INA228_CT_4120us,
+};
+
+// Conversions averaged per sample, for the averaging field of sensor_cfg_t.
+enum ina228_avg
+{
+    INA228_AVG_1,
+    INA228_AVG_4,
+    INA228_AVG_16,
+    INA228_AVG_64,
+    INA228_AVG_128,
+    INA228_AVG_256,
+    INA228_AVG_512,
+    INA228_AVG_1024,
+};
+
+typedef struct ina228 ina228_t;
+
+bool ina228_probe(i2c_inst_t* i2c, uint8_t addr);
+int ina228_init(ina228_t* hw, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _INA228_H
@@ -1,3 +1,4 @@
+#include <inttypes.h>
 #include <stdio.h>
 #include <string.h>
 #include "FreeRTOS.h"
@@ -6,31 +7,108 @@
 #include "timers.h"
 #include "hardware/gpio.h"
 #include "hardware/i2c.h"
+#include "pico/stdio.h"
 #include "pico/stdio_usb.h"
 #include "pico/time.h"
 #include "display.h"
 #include "ina219.h"
+#include "ina226.h"
+#include "ina228.h"
+#include "picova_csv.h"
+#include "picova_stream.h"
+#include "sensor.h"
+#include "settings.h"
 
 static const uint PIN_LED = PICO_DEFAULT_LED_PIN;
-static const uint PIN_SDA_INA219 = 12;
-static const uint PIN_SCL_INA219 = 13;
-static const uint PIN_VCC_INA219 = 14;
+static const uint PIN_SDA_SENSOR = 12;
+static const uint PIN_SCL_SENSOR = 13;
+static const uint PIN_VCC_SENSOR = 14;
+static const uint PIN_ALERT_SENSOR = 15;
 static const uint PIN_SDA_SSD1306 = 2;
 static const uint PIN_SCL_SSD1306 = 3;
 static const uint PIN_VCC_SSD1306 = 4;
 static const uint PIN_GND_SSD1306 = 5;
-static i2c_inst_t* const I2C_INA219 = i2c0;
+static const uint PIN_MARKER_BASE = 16;
+static i2c_inst_t* const I2C_SENSOR = i2c0;
 static i2c_inst_t* const I2C_SSD1306 = i2c1;
 static const float SHUNT_OHMS = 0.1f;
 
-static ina219_t ina219;
+// Marker inputs, on PICOVA_MARKERS pins from PIN_MARKER_BASE up, for the
+// device under test to signal what it is doing. Their state is latched with
+// every sample and their edges are timestamped (see picova_stream.h).
+#ifndef PICOVA_MARKERS
+#define PICOVA_MARKERS 4
+#endif
+static const uint32_t MARKER_MASK = (1u << PICOVA_MARKERS) - 1;
+
+// Consecutive failed reads before the sensor is recovered, and how long it
+// is unpowered for when that takes a power cycle.
+static const uint READ_RETRIES = 3;
+static const uint SENSOR_POWER_OFF_MS = 10;
+
+// How often the timestamp jitter is reported.
+static const uint32_t JITTER_REPORT_US = 10000000;
+
+// Initial configuration for each kind of sensor, on its most sensitive
+// ranges. Not static so that the host benchmark (see host/) can sweep it.
+sensor_cfg_t sensor_initial_cfg[SENSOR_TYPES] = {
+    [SENSOR_INA219] = {
+        .bus_range   = INA219_BUS_RANGE_16V,
+        .shunt_range = INA219_SHUNT_RANGE_40mV,
+        .bus_adc     = INA219_ADC_BITS_9,
+        .shunt_adc   = INA219_ADC_BITS_11,
+    },
+    [SENSOR_INA226] = {
+        .bus_adc     = INA226_CT_140us,
+        .shunt_adc   = INA226_CT_332us,
+        .averaging   = INA226_AVG_1,
+    },
+    [SENSOR_INA228] = {
+        .shunt_range = INA228_SHUNT_RANGE_40mV,
+        .bus_adc     = INA228_CT_50us,
+        .shunt_adc   = INA228_CT_280us,
+        .averaging   = INA228_AVG_1,
+    },
+};
+
+// Registers fetched per sample, where the driver can choose (see struct
+// sensor_schedule). Reading all three lets the INA219's CNVR flag gate every
+// read; the host benchmark measures what dropping some of them gains.
+sensor_schedule_t sensor_read_schedule = {
+    .channels    = SENSOR_CHANNEL_ALL,
+    .bus_every   = 1,
+};
+
+static sensor_t sensor;
+static TaskHandle_t alert_task = NULL;
 static QueueHandle_t meas_queue = NULL;
 static QueueHandle_t display_queue = NULL;
+static QueueHandle_t settings_queue = NULL;
+static QueueHandle_t health_queue = NULL;
+static QueueHandle_t edge_queue = NULL;
+static QueueHandle_t jitter_queue = NULL;
+
+// Set by display_task when the host asks for the ranges to be reset, and
+// cleared by read_task once it has done so.
+static volatile bool ranges_reset_requested = false;
 
+// A queued sample: 16 bytes, with the marker state in data.tag and the
+// LSBs left in the sensor's epoch table.
 struct measurement
 {
     uint32_t timestamp;
-    ina219_data_t data;
+    sensor_data_t data;
+};
+
+// As many samples as the 32-byte ones with the LSBs inline fitted in the
+// same memory.
+static const UBaseType_t MEAS_QUEUE_LEN = 512;
+
+// The marker inputs' state just after an edge on any of them.
+struct marker_edge
+{
+    uint32_t timestamp;
+    uint8_t markers;
 };
 
 struct avg_measurement
@@ -38,86 +116,516 @@ struct avg_measurement
     float V, mA, mW;
 };
 
+// Sensor bus health, reported as a status line (see picova_stream.h) after
+// each recovery.
+struct sensor_health
+{
+    uint32_t errors;            // Failed reads
+    uint32_t bus_clears;
+    uint32_t power_cycles;
+    uint32_t max_gap_us;        // Longest time between two samples
+};
+
+// Distribution of the change in the interval between consecutive samples,
+// in power-of-two buckets of microseconds: bucket 0 counts no change and
+// bucket k a change of at least 2^(k-1) and less than 2^k.
+#define JITTER_BUCKETS 16
+
+struct jitter_histogram
+{
+    uint32_t counts[JITTER_BUCKETS];
+    uint32_t max_us;
+};
+
+// Sample timestamps' jitter, reported as a status line every
+// JITTER_REPORT_US. `latched` is for the timestamps as sent, taken in the
+// interrupt that starts each read, and `woken` for the time read_task woke
+// up to do it, which is what the timestamps used to be.
+struct jitter_stats
+{
+    uint32_t samples;
+    struct jitter_histogram latched;
+    struct jitter_histogram woken;
+};
+
+static void jitter_add(struct jitter_histogram* h, uint32_t interval, uint32_t last_interval)
+{
+    const uint32_t us = interval > last_interval ? interval - last_interval : last_interval - interval;
+    uint bucket = 0;
+    while (bucket < JITTER_BUCKETS - 1 && us >> bucket)
+        bucket++;
+    h->counts[bucket]++;
+    if (us > h->max_us)
+        h->max_us = us;
+}
+
+// Upper bound of the bucket holding the `permille`th value.
+static uint32_t jitter_percentile(const struct jitter_histogram* h, uint32_t samples, uint permille)
+{
+    const uint64_t rank = ((uint64_t)samples * permille + 999) / 1000;
+    uint64_t seen = 0;
+    for (uint bucket = 0; bucket < JITTER_BUCKETS; bucket++) {
+        seen += h->counts[bucket];
+        if (seen >= rank && seen)
+            return bucket ? 1u << bucket : 0;
+    }
+    return h->max_us;
+}
+
+static inline uint8_t read_markers(void)
+{
+    return (gpio_get_all() >> PIN_MARKER_BASE) & MARKER_MASK;
+}
+
+// Time and marker state at the interrupt that last started a read, for the
+// sample to carry rather than whatever they are once the task has woken.
+struct read_latch {
+    uint32_t timestamp;
+    uint8_t markers;
+};
+static volatile struct read_latch read_latch;
+
+// Latch the time and markers and wake `task` to read the sensor. Called from
+// interrupts.
+static void notify_read(TaskHandle_t task, BaseType_t* woken)
+{
+    read_latch.timestamp = time_us_32();
+    read_latch.markers = read_markers();
+    vTaskNotifyGiveFromISR(task, woken);
+}
+
 static bool on_read_timer(repeating_timer_t* timer)
 {
     TaskHandle_t read_task = timer->user_data;
-    xTaskNotifyGive(read_task);
+    BaseType_t woken = pdFALSE;
+    notify_read(read_task, &woken);
+    portYIELD_FROM_ISR(woken);
     return true;
 }
 
+// The sensor's ALERT pin falls at the end of each conversion. Every other
+// interrupt is an edge on a marker input, whose state is read again rather
+// than taken from the event so that inputs changing together make one
+// record. If the queue is full the edge is lost, but write_task sends the
+// state latched with the next sample instead.
+static void on_gpio(uint gpio, uint32_t events)
+{
+    static uint8_t last_markers = 0;
+    BaseType_t woken = pdFALSE;
+
+    if (gpio == PIN_ALERT_SENSOR) {
+        notify_read(alert_task, &woken);
+    } else {
+        const struct marker_edge e = { time_us_32(), read_markers() };
+        if (e.markers != last_markers && xQueueSendToBackFromISR(edge_queue, &e, &woken))
+            last_markers = e.markers;
+    }
+
+    portYIELD_FROM_ISR(woken);
+}
+
 static void on_disp_timer(TimerHandle_t timer)
 {
     TaskHandle_t write_task = pvTimerGetTimerID(timer);
     xTaskNotifyGive(write_task);
 }
 
-// Read measurements from the INA219 as fast as possible and push them into a
+// Configure the sensor as it was at the end of the last session, so that
+// streaming starts on the ranges autoranging settled on instead of climbing
+// to them again and discarding samples on the way. Settings saved for a
+// different sensor or shunt are ignored.
+static void restore_settings(sensor_t* hw)
+{
+    settings_t s;
+
+    if (settings_load(&s) && s.sensor == hw->ops->type && s.shunt_ohms == SHUNT_OHMS) {
+        sensor_configure(hw, &s.cfg);
+        sensor_set_calibration(hw, &s.cal);
+    } else {
+        sensor_configure(hw, &sensor_initial_cfg[hw->ops->type]);
+        sensor_calibrate(hw);
+    }
+}
+
+// Hand the current configuration to display_task to be saved. Writing flash
+// takes tens of milliseconds, which the read loop can't afford to block for.
+static void queue_settings(sensor_t* hw)
+{
+    settings_t s;
+
+    s.sensor = hw->ops->type;
+    sensor_get_config(hw, &s.cfg);
+    sensor_get_calibration(hw, &s.cal);
+    s.shunt_ohms = SHUNT_OHMS;
+    xQueueOverwrite(settings_queue, &s);
+}
+
+// Go back to the most sensitive ranges, as on a first boot, and save them
+// over the ones autoranging had climbed to. Autoranging only climbs, so after
+// a transient this is the way to get the precision back. Climbing again
+// starts new epochs, so this must only be called with the measurement queue
+// empty (see SENSOR_EPOCHS).
+static void reset_ranges(sensor_t* hw)
+{
+    sensor_configure(hw, &sensor_initial_cfg[hw->ops->type]);
+    sensor_calibrate(hw);
+    sensor_schedule(hw, &sensor_read_schedule);
+    sensor_start(hw);
+    queue_settings(hw);
+}
+
+// Read commands from the host, one per line. "reset-ranges" asks read_task
+// for reset_ranges(), which it does once the measurement queue has drained;
+// anything else is ignored.
+static void poll_commands(void)
+{
+    static char line[16];
+    static size_t len = 0;
+    static bool overflow = false;
+    int c;
+
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT) {
+        if (c == '\r' || c == '\n') {
+            line[len] = '\0';
+            if (!overflow && strcmp(line, "reset-ranges") == 0)
+                ranges_reset_requested = true;
+            len = 0;
+            overflow = false;
+        } else if (len < sizeof(line) - 1) {
+            line[len++] = (char)c;
+        } else {
+            overflow = true;
+        }
+    }
+}
+
+// Free the bus from a sensor stuck driving SDA low part way through a byte,
+// as a reset mid-transfer or a glitch on SCL can leave it: with the pins
+// taken from the I2C block and driven open drain, clock SCL until SDA is
+// released (nine clocks at most), then make a STOP.
+static void sensor_bus_clear(void)
+{
+    const uint32_t half_clock_us = 5;
+
+    gpio_put(PIN_SCL_SENSOR, 0);
+    gpio_put(PIN_SDA_SENSOR, 0);
+    gpio_set_dir(PIN_SCL_SENSOR, GPIO_IN);
+    gpio_set_dir(PIN_SDA_SENSOR, GPIO_IN);
+    gpio_set_function(PIN_SCL_SENSOR, GPIO_FUNC_SIO);
+    gpio_set_function(PIN_SDA_SENSOR, GPIO_FUNC_SIO);
+
+    for (int i = 0; i < 9 && !gpio_get(PIN_SDA_SENSOR); i++) {
+        gpio_set_dir(PIN_SCL_SENSOR, GPIO_OUT);
+        busy_wait_us(half_clock_us);
+        gpio_set_dir(PIN_SCL_SENSOR, GPIO_IN);
+        busy_wait_us(half_clock_us);
+    }
+
+    // SDA rises while SCL is high.
+    gpio_set_dir(PIN_SCL_SENSOR, GPIO_OUT);
+    gpio_set_dir(PIN_SDA_SENSOR, GPIO_OUT);
+    busy_wait_us(half_clock_us);
+    gpio_set_dir(PIN_SCL_SENSOR, GPIO_IN);
+    busy_wait_us(half_clock_us);
+    gpio_set_dir(PIN_SDA_SENSOR, GPIO_IN);
+    busy_wait_us(half_clock_us);
+
+    gpio_set_function(PIN_SCL_SENSOR, GPIO_FUNC_I2C);
+    gpio_set_function(PIN_SDA_SENSOR, GPIO_FUNC_I2C);
+}
+
+// Bring an unresponsive sensor back: clear the bus on the first attempt, and
+// cut its power from the second on, for a brown-out or a sensor wedged in a
+// way a bus clear can't reach. Either way it is then reset and given back
+// the configuration and calibration it had, so the ranges are kept.
+static void recover_sensor(sensor_t* hw, uint attempt, struct sensor_health* health)
+{
+    sensor_cfg_t cfg;
+    sensor_cal_t cal;
+    sensor_get_config(hw, &cfg);
+    sensor_get_calibration(hw, &cal);
+
+    if (attempt == 1) {
+        health->bus_clears++;
+        sensor_bus_clear();
+    } else {
+        health->power_cycles++;
+        gpio_put(PIN_VCC_SENSOR, 0);
+        vTaskDelay(pdMS_TO_TICKS(SENSOR_POWER_OFF_MS));
+        gpio_put(PIN_VCC_SENSOR, 1);
+        sleep_us(100);
+    }
+
+    sensor_reset(hw);
+    sensor_configure(hw, &cfg);
+    sensor_set_calibration(hw, &cal);
+    sensor_schedule(hw, &sensor_read_schedule);
+    sensor_start(hw);
+
+    xQueueOverwrite(health_queue, health);
+}
+
+// Read measurements from the sensor as fast as possible and push them into a
 // queue. This is the only task running on core 1.
+//
+// After READ_RETRIES failed reads in a row the sensor is recovered (see
+// recover_sensor()), and again after every READ_RETRIES more until a read
+// succeeds, so with a sensor that can be recovered the longest gap is a few
+// failed reads, a bus clear, a few more and one power cycle. The gap is
+// measured anyway and reported with the error counts.
+//
+// Each sample is stamped with the time of the interrupt that started its
+// read, ALERT at the end of the conversion or the read timer, rather than
+// when this task got to run, so that neither the other tasks nor a slow read
+// before it moves it.
 static void read_task(void* arg)
 {
-    const ina219_cfg_t cfg = {
-        .bus_range   = INA219_BUS_RANGE_16V,
-        .shunt_range = INA219_SHUNT_RANGE_40mV,
-        .bus_adc     = INA219_ADC_BITS_9,
-        .shunt_adc   = INA219_ADC_BITS_11,
-    };
+    sensor_probe(&sensor, I2C_SENSOR, INA219_ADDR_DEFAULT, SHUNT_OHMS);
+    sensor_reset(&sensor);
+    restore_settings(&sensor);
+    sensor_schedule(&sensor, &sensor_read_schedule);
+
+    struct sensor_health health = {0};
+    uint failures = 0;
+    uint attempt = 0;
+    bool have_last = false;
+    uint32_t last_timestamp = 0;
+
+    struct jitter_stats jitter = {0};
+    uint32_t jitter_start = time_us_32();
+    // Consecutive interrupt-driven samples, up to the three whose two
+    // intervals give one jitter value.
+    uint timed = 0;
+    uint32_t last_woken = 0;
+    uint32_t last_interval = 0;
+    uint32_t last_woken_interval = 0;
 
-    ina219_init(&ina219, I2C_INA219, INA219_ADDR_DEFAULT, SHUNT_OHMS);
-    ina219_reset(&ina219);
-    ina219_configure(&ina219, &cfg);
-    ina219_calibrate(&ina219);
-
-    // Use a repeating timer on this core to initiate reads at the INA219's
-    // conversion rate.
     TaskHandle_t task = xTaskGetCurrentTaskHandle();
-    alarm_pool_t* alarm_pool = alarm_pool_create_with_unused_hardware_alarm(1);
-    int64_t read_period = ina219_conversion_us(&ina219);
+    const uint32_t read_period = sensor_conversion_us(&sensor);
+    TickType_t timeout = portMAX_DELAY;
     struct repeating_timer read_timer;
-    alarm_pool_add_repeating_timer_us(alarm_pool, -read_period, on_read_timer, task, &read_timer);
+
+    if (sensor.ops->has_alert) {
+        // Read when the sensor says a conversion has finished. The interrupt
+        // is enabled here so that it is taken on this core. ALERT stays low
+        // until the sensor is read, so an edge lost while it is low would
+        // stop reads for good; poll if none comes for two conversions.
+        alert_task = task;
+        gpio_init(PIN_ALERT_SENSOR);
+        gpio_set_dir(PIN_ALERT_SENSOR, GPIO_IN);
+        gpio_pull_up(PIN_ALERT_SENSOR);
+        gpio_set_irq_enabled_with_callback(PIN_ALERT_SENSOR, GPIO_IRQ_EDGE_FALL, true, on_gpio);
+        timeout = pdMS_TO_TICKS(2 * read_period / 1000) + 1;
+    } else {
+        // Use a repeating timer on this core to initiate reads at the
+        // sensor's conversion rate.
+        alarm_pool_t* alarm_pool = alarm_pool_create_with_unused_hardware_alarm(1);
+        alarm_pool_add_repeating_timer_us(alarm_pool, -(int64_t)read_period, on_read_timer, task, &read_timer);
+    }
+
+    // Marker edges share the GPIO interrupt, and so this core, with ALERT.
+    for (uint i = 0; i < PICOVA_MARKERS; i++)
+        gpio_set_irq_enabled_with_callback(PIN_MARKER_BASE + i, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, true, on_gpio);
+
+    sensor_start(&sensor);
 
     while (true) {
-        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        // A reset waits until every sample queued under the old epochs has
+        // been sent, so that repeated resets can't wrap the epoch under them.
+        if (ranges_reset_requested && !uxQueueMessagesWaiting(meas_queue)) {
+            ranges_reset_requested = false;
+            reset_ranges(&sensor);
+            timed = 0;
+        }
 
-        struct measurement m;
-        m.timestamp = time_us_32();
+        const bool notified = ulTaskNotifyTake(pdTRUE, timeout);
+        const uint32_t woken = time_us_32();
 
-        int err = ina219_read_data(&ina219, &m.data);
-        if (err < 0)
-            continue;
+        // The interrupts share this core, so masking them keeps the copy whole.
+        taskENTER_CRITICAL();
+        const struct read_latch latched = { read_latch.timestamp, read_latch.markers };
+        taskEXIT_CRITICAL();
 
-        if (!ina219_data_ready(&m.data))
+        struct measurement m;
+        // Polling after a lost ALERT has no interrupt state to use.
+        m.timestamp = notified ? latched.timestamp : woken;
+        m.data.tag = notified ? latched.markers : read_markers();
+
+        int ret = sensor_read(&sensor, &m.data);
+        if (ret != SENSOR_SAMPLE || !notified)
+            timed = 0;
+
+        if (ret < 0) {
+            health.errors++;
+            if (++failures >= READ_RETRIES) {
+                failures = 0;
+                recover_sensor(&sensor, ++attempt, &health);
+            }
             continue;
+        }
+
+        failures = 0;
 
-        if (ina219_data_overflowed(&m.data)) {
-            ina219_increase_shunt_range(&ina219);
+        if (ret == SENSOR_RANGED)
+            queue_settings(&sensor);
+
+        if (ret != SENSOR_SAMPLE)
             continue;
+
+        const uint32_t gap = m.timestamp - last_timestamp;
+        if (have_last && gap > health.max_gap_us)
+            health.max_gap_us = gap;
+        have_last = true;
+
+        if (notified) {
+            if (timed) {
+                const uint32_t interval = m.timestamp - last_timestamp;
+                const uint32_t woken_interval = woken - last_woken;
+                if (timed > 1) {
+                    jitter.samples++;
+                    jitter_add(&jitter.latched, interval, last_interval);
+                    jitter_add(&jitter.woken, woken_interval, last_woken_interval);
+                }
+                last_interval = interval;
+                last_woken_interval = woken_interval;
+            }
+            if (timed < 2)
+                timed++;
+            last_woken = woken;
         }
 
-        if (ina219_data_shunt_clipped(&m.data)) {
-            ina219_increase_shunt_range(&ina219);
-            continue;
+        last_timestamp = m.timestamp;
+
+        if (m.timestamp - jitter_start >= JITTER_REPORT_US) {
+            xQueueOverwrite(jitter_queue, &jitter);
+            memset(&jitter, 0, sizeof(jitter));
+            jitter_start = m.timestamp;
         }
 
-        if (ina219_data_bus_clipped(&m.data)) {
-            ina219_increase_bus_range(&ina219);
-            continue;
+        // Report the outage now that its length is known.
+        if (attempt) {
+            attempt = 0;
+            xQueueOverwrite(health_queue, &health);
         }
 
         xQueueSendToBack(meas_queue, &m, portMAX_DELAY);
     }
 }
 
+#ifdef PICOVA_STREAM_BINARY
+// Write a measurement as a raw register frame (see picova_stream.h), under
+// the sensor's calibration epoch. A calibration frame is sent first whenever
+// the epoch has changed since the last sample, or when `resend_cal` is set
+// so that late joiners can decode. Only INA219 registers can be converted on
+// the host; samples from other sensors are sent already converted.
+static void write_binary(const struct measurement* m, float V, float mA, float mW, bool resend_cal)
+{
+    // Not a valid epoch, so that the first sample sends its calibration.
+    static uint8_t last_epoch = SENSOR_EPOCHS;
+
+    if (sensor.ops->type != SENSOR_INA219) {
+        struct picova_frame_values frame;
+        frame.timestamp = m->timestamp;
+        frame.V = V;
+        frame.mA = mA;
+        frame.mW = mW;
+        picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_VALUES, 0);
+        fwrite(&frame, sizeof(frame), 1, stdout);
+        return;
+    }
+
+    const uint8_t epoch = m->data.epoch;
+    if (epoch != last_epoch || resend_cal) {
+        struct picova_frame_cal cal;
+        cal.current_lsb = sensor.lsb[epoch].current_lsb;
+        cal.power_lsb = sensor.lsb[epoch].power_lsb;
+        picova_frame_seal(&cal, sizeof(cal), PICOVA_FRAME_CAL, epoch);
+        fwrite(&cal, sizeof(cal), 1, stdout);
+        last_epoch = epoch;
+    }
+
+    struct picova_frame_sample frame;
+    frame.timestamp = m->timestamp;
+    frame.bus = m->data.bus;
+    if (m->data.flags & SENSOR_DATA_BUS_HELD)
+        frame.bus |= PICOVA_BUS_HELD;
+    frame.current = m->data.current;
+    frame.power = m->data.power;
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_SAMPLE, epoch);
+    fwrite(&frame, sizeof(frame), 1, stdout);
+}
+
+// Marker state as of the last marker frame, which binary samples take.
+static uint8_t markers_sent = 0;
+
+static void write_markers(uint32_t timestamp, uint8_t markers)
+{
+    markers_sent = markers;
+
+    struct picova_frame_markers frame;
+    frame.timestamp = timestamp;
+    frame.markers = markers;
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_MARKERS, 0);
+    fwrite(&frame, sizeof(frame), 1, stdout);
+}
+#else
+// Lines are gathered while more measurements are queued and written
+// together, rather than one stdio call each.
+static char csv[512];
+static size_t csv_len = 0;
+
+// Make room for a line of up to `len` bytes at csv + csv_len.
+static void csv_reserve(size_t len)
+{
+    if (csv_len + len > sizeof(csv)) {
+        fwrite(csv, 1, csv_len, stdout);
+        csv_len = 0;
+    }
+}
+
+static void write_markers(uint32_t timestamp, uint8_t markers)
+{
+    csv_reserve(PICOVA_CSV_MAX_LINE);
+    csv_len += picova_csv_format_markers(csv + csv_len, timestamp, markers);
+}
+#endif
+
+// A status line reporting sensor bus health, in either stream format.
+static size_t format_health(char* buf, size_t size, const struct sensor_health* h)
+{
+    const int len = snprintf(buf, size,
+        "# i2c errors=%" PRIu32 " bus_clears=%" PRIu32 " power_cycles=%" PRIu32 " max_gap_us=%" PRIu32 "\n",
+        h->errors, h->bus_clears, h->power_cycles, h->max_gap_us);
+    return len < 0 ? 0 : (size_t)len < size ? (size_t)len : size - 1;
+}
+
+// A status line reporting timestamp jitter in microseconds, with the
+// percentiles rounded up to a power of two.
+static size_t format_jitter(char* buf, size_t size, const struct jitter_stats* j)
+{
+    const int len = snprintf(buf, size,
+        "# jitter_us n=%" PRIu32
+        " latched_p50=%" PRIu32 " latched_p99=%" PRIu32 " latched_max=%" PRIu32
+        " woken_p50=%" PRIu32 " woken_p99=%" PRIu32 " woken_max=%" PRIu32 "\n",
+        j->samples,
+        jitter_percentile(&j->latched, j->samples, 500), jitter_percentile(&j->latched, j->samples, 990), j->latched.max_us,
+        jitter_percentile(&j->woken, j->samples, 500), jitter_percentile(&j->woken, j->samples, 990), j->woken.max_us);
+    return len < 0 ? 0 : (size_t)len < size ? (size_t)len : size - 1;
+}
+
 // Write the measurements out over stdio (USB CDC). Also accumulate averages to
 // display periodically on the OLED.
 static void write_task(void* arg)
 {
-    // Show the splash screen for a while.
-    vTaskDelay(pdMS_TO_TICKS(1500));
+    // Stream from the start, while the splash screen is still up.
     gpio_put(PIN_LED, 1);
 
     struct measurement m;
     struct avg_measurement avg = {0};
     size_t avg_num = 0;
+#ifdef PICOVA_STREAM_BINARY
+    bool resend_cal = true;
+#endif
 
     // Periodically display the averaged measurement on the display.
     TaskHandle_t task = xTaskGetCurrentTaskHandle();
@@ -126,11 +634,55 @@ static void write_task(void* arg)
 
     while (true) {
         xQueueReceive(meas_queue, &m, portMAX_DELAY);
-        const float V = ina219_data_bus_V(&m.data);
-        const float mA = ina219_data_current_mA(&m.data);
-        const float mW = ina219_data_power_mW(&m.data);
+        float V, mA, mW;
+        sensor_convert(&sensor, &m.data, &V, &mA, &mW);
+
+        struct sensor_health health;
+        const bool report = xQueueReceive(health_queue, &health, 0);
+        struct jitter_stats jitter;
+        const bool report_jitter = xQueueReceive(jitter_queue, &jitter, 0);
+
+        // Marker edges up to this sample go out before it.
+        struct marker_edge e;
+        while (xQueuePeek(edge_queue, &e, 0) && (int32_t)(e.timestamp - m.timestamp) <= 0) {
+            xQueueReceive(edge_queue, &e, 0);
+            write_markers(e.timestamp, e.markers);
+        }
+
+#ifdef PICOVA_STREAM_BINARY
+        // Send the latched state if the edges haven't accounted for it.
+        if (m.data.tag != markers_sent)
+            write_markers(m.timestamp, m.data.tag);
+
+        write_binary(&m, V, mA, mW, resend_cal);
+        resend_cal = false;
 
-        printf("%lu,%f,%f,%f\n", m.timestamp, V, mA, mW);
+        if (report) {
+            char line[PICOVA_CSV_MAX_LINE];
+            fwrite(line, 1, format_health(line, sizeof(line), &health), stdout);
+        }
+        if (report_jitter) {
+            char line[PICOVA_CSV_MAX_LINE];
+            fwrite(line, 1, format_jitter(line, sizeof(line), &jitter), stdout);
+        }
+#else
+        csv_reserve(PICOVA_CSV_MAX_LINE);
+        csv_len += picova_csv_format(csv + csv_len, m.timestamp, V, mA, mW,
+                                     PICOVA_MARKERS ? m.data.tag : -1);
+        if (report) {
+            csv_reserve(PICOVA_CSV_MAX_LINE);
+            csv_len += format_health(csv + csv_len, PICOVA_CSV_MAX_LINE, &health);
+        }
+        if (report_jitter) {
+            csv_reserve(PICOVA_CSV_MAX_LINE);
+            csv_len += format_jitter(csv + csv_len, PICOVA_CSV_MAX_LINE, &jitter);
+        }
+
+        if (!uxQueueMessagesWaiting(meas_queue)) {
+            fwrite(csv, 1, csv_len, stdout);
+            csv_len = 0;
+        }
+#endif
 
         avg.V += V;
         avg.mA += mA;
@@ -148,14 +700,19 @@ static void write_task(void* arg)
             avg.mA = 0;
             avg.mW = 0;
             avg_num = 0;
+#ifdef PICOVA_STREAM_BINARY
+            resend_cal = true;
+#endif
         }
     }
 }
 
-// Display averaged readings on the OLED.
+// Display averaged readings on the OLED, save settings to flash when
+// read_task has changed them, and take commands from the host.
 static void display_task(void* arg)
 {
     struct avg_measurement m;
+    settings_t s;
     char str[11];
 
     display_init_ssd1306();
@@ -166,8 +723,19 @@ static void display_task(void* arg)
     u8g2_SendBuffer(&u8g2);
     u8g2_SetPowerSave(&u8g2, 0);
 
+    // Show the splash screen for a while. Readings averaged meanwhile are
+    // stale by the time it goes.
+    vTaskDelay(pdMS_TO_TICKS(1500));
+    xQueueReset(display_queue);
+
     while (true) {
-        xQueueReceive(display_queue, &m, portMAX_DELAY);
+        poll_commands();
+
+        if (xQueueReceive(settings_queue, &s, 0))
+            settings_save(&s);
+
+        if (!xQueueReceive(display_queue, &m, pdMS_TO_TICKS(1000)))
+            continue;
 
         u8g2_ClearBuffer(&u8g2);
         snprintf(str, sizeof(str), "%7.3f V", m.V);
@@ -194,19 +762,28 @@ static void __attribute__((noreturn)) die(const char* msg)
 int main()
 {
     stdio_usb_init();
+#ifdef PICOVA_STREAM_BINARY
+    stdio_set_translate_crlf(&stdio_usb, false);
+#endif
 
     gpio_init(PIN_LED);
     gpio_set_dir(PIN_LED, GPIO_OUT);
 
-    // Set up the INA219 pins
-    gpio_init(PIN_VCC_INA219);
-    gpio_set_dir(PIN_VCC_INA219, GPIO_OUT);
-    gpio_set_drive_strength(PIN_VCC_INA219, GPIO_DRIVE_STRENGTH_12MA);
-    gpio_put(PIN_VCC_INA219, 1);
+    // Set up the sensor pins. ALERT is set up by read_task.
+    gpio_init(PIN_VCC_SENSOR);
+    gpio_set_dir(PIN_VCC_SENSOR, GPIO_OUT);
+    gpio_set_drive_strength(PIN_VCC_SENSOR, GPIO_DRIVE_STRENGTH_12MA);
+    gpio_put(PIN_VCC_SENSOR, 1);
+
+    for (uint i = 0; i < PICOVA_MARKERS; i++) {
+        gpio_init(PIN_MARKER_BASE + i);
+        gpio_set_dir(PIN_MARKER_BASE + i, GPIO_IN);
+        gpio_pull_down(PIN_MARKER_BASE + i);
+    }
 
-    i2c_init(I2C_INA219, 1000000);
-    gpio_set_function(PIN_SCL_INA219, GPIO_FUNC_I2C);
-    gpio_set_function(PIN_SDA_INA219, GPIO_FUNC_I2C);
+    i2c_init(I2C_SENSOR, 1000000);
+    gpio_set_function(PIN_SCL_SENSOR, GPIO_FUNC_I2C);
+    gpio_set_function(PIN_SDA_SENSOR, GPIO_FUNC_I2C);
 
     // Set up the SSD1306 pins
     gpio_init(PIN_GND_SSD1306);
@@ -221,7 +798,7 @@ int main()
     display_init_i2c(I2C_SSD1306, 1000000, PIN_SDA_SSD1306, PIN_SCL_SSD1306);
 
     // Set up tasks and IPC
-    meas_queue = xQueueCreate(255, sizeof(struct measurement));
+    meas_queue = xQueueCreate(MEAS_QUEUE_LEN, sizeof(struct measurement));
     if (!meas_queue) {
         die("Failed to create measurement queue");
     }
@@ -231,6 +808,26 @@ int main()
         die("Failed to create display queue");
     }
 
+    settings_queue = xQueueCreate(1, sizeof(settings_t));
+    if (!settings_queue) {
+        die("Failed to create settings queue");
+    }
+
+    health_queue = xQueueCreate(1, sizeof(struct sensor_health));
+    if (!health_queue) {
+        die("Failed to create health queue");
+    }
+
+    jitter_queue = xQueueCreate(1, sizeof(struct jitter_stats));
+    if (!jitter_queue) {
+        die("Failed to create jitter queue");
+    }
+
+    edge_queue = xQueueCreate(64, sizeof(struct marker_edge));
+    if (!edge_queue) {
+        die("Failed to create marker edge queue");
+    }
+
     // TODO: run read_task on core 1. Currently the system locks up when
     // read_task is run on core 1.
     BaseType_t ret = xTaskCreateAffinitySet(read_task, "read", 1024, NULL, configMAX_PRIORITIES - 1, 1 << 0, NULL);
@@ -0,0 +1,120 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include "picova_csv.h"
+
+// Widest "%f" of a float: a sign, 39 digits, the point and six decimals.
+// Three of these, the timestamp, the markers and separators fit
+// PICOVA_CSV_MAX_LINE.
+#define FIELD_MAX 47
+
+// Largest exponent handled without printf. Pico's printf switches %f to
+// exponential notation above 1e9, so stay below 2^29.
+static const uint32_t MAX_FAST_EXP = 127 + 29;
+
+static char* format_uint(char* p, uint32_t value)
+{
+    char digits[10];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    while (n)
+        *p++ = digits[--n];
+
+    return p;
+}
+
+// Equivalent to "%f": the value is mantissa / 2^shift, so the fraction is
+// rounded to a multiple of 1e-6 with round half to even, as printf does.
+// mantissa × 1e6 needs at most 44 bits.
+static char* format_fixed6(char* p, float value)
+{
+    union { float f; uint32_t u; } bits = { .f = value };
+    const uint32_t exp = (bits.u >> 23) & 0xFF;
+
+    if (exp >= MAX_FAST_EXP) {
+        // NaN, infinity or huge: leave it to printf.
+        const int n = snprintf(p, FIELD_MAX + 1, "%f", value);
+        return p + (n < 0 ? 0 : n > FIELD_MAX ? FIELD_MAX : n);
+    }
+
+    if (bits.u >> 31)
+        *p++ = '-';
+
+    uint32_t mantissa = bits.u & 0x7FFFFF;
+    int shift = 149;
+    if (exp) {
+        mantissa |= 0x800000;
+        shift = 150 - (int)exp;
+    }
+
+    uint32_t whole = 0;
+    uint32_t frac = 0;
+
+    if (shift <= 0) {
+        whole = mantissa << -shift;
+    } else if (shift <= 45) {
+        const uint32_t frac_bits = shift < 24 ? mantissa & ((1u << shift) - 1) : mantissa;
+        const uint64_t scaled = (uint64_t)frac_bits * 1000000;
+        const uint64_t rem = scaled & ((1ull << shift) - 1);
+        const uint64_t half = 1ull << (shift - 1);
+
+        whole = shift < 24 ? mantissa >> shift : 0;
+        frac = scaled >> shift;
+
+        if (rem > half || (rem == half && (frac & 1)))
+            frac++;
+
+        if (frac == 1000000) {
+            whole++;
+            frac = 0;
+        }
+    }
+    // Otherwise the value is below 0.5e-6 and rounds to zero.
+
+    p = format_uint(p, whole);
+    *p++ = '.';
+
+    for (int i = 5; i >= 0; i--) {
+        p[i] = '0' + frac % 10;
+        frac /= 10;
+    }
+
+    return p + 6;
+}
+
+size_t picova_csv_format(char* buf, uint32_t timestamp, float V, float mA, float mW, int markers)
+{
+    char* p = buf;
+
+    p = format_uint(p, timestamp);
+    *p++ = ',';
+    p = format_fixed6(p, V);
+    *p++ = ',';
+    p = format_fixed6(p, mA);
+    *p++ = ',';
+    p = format_fixed6(p, mW);
+    if (markers >= 0) {
+        *p++ = ',';
+        p = format_uint(p, markers);
+    }
+    *p++ = '\n';
+
+    return p - buf;
+}
+
+size_t picova_csv_format_markers(char* buf, uint32_t timestamp, uint8_t markers)
+{
+    char* p = buf;
+
+    *p++ = '@';
+    p = format_uint(p, timestamp);
+    *p++ = ',';
+    p = format_uint(p, markers);
+    *p++ = '\n';
+
+    return p - buf;
+}
@@ -0,0 +1,33 @@
+#ifndef _PICOVA_CSV_H
+#define _PICOVA_CSV_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// The "us,V,mA,mW" text stream, formatted without printf. The M0+ has no
+// FPU, so printf's %f goes through soft-float doubles for every field;
+// instead each float is split into its mantissa and exponent and rounded to
+// six decimals in integer arithmetic, exactly as %f rounds it, so the output
+// is byte for byte what printf("%" PRIu32 ",%f,%f,%f\n", ...) gives. Marker
+// state (see picova_stream.h) is written as a plain integer.
+
+// Room for the longest line picova_csv_format() writes.
+#define PICOVA_CSV_MAX_LINE 160
+
+// Write one line, ending in '\n' and not NUL-terminated, to `buf`, which must
+// have PICOVA_CSV_MAX_LINE bytes free, and return its length. The markers
+// column is left out if `markers` is negative.
+size_t picova_csv_format(char* buf, uint32_t timestamp, float V, float mA, float mW, int markers);
+
+// Write an "@us,markers" marker record the same way.
+size_t picova_csv_format_markers(char* buf, uint32_t timestamp, uint8_t markers);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICOVA_CSV_H
@@ -0,0 +1,131 @@
+#ifndef _PICOVA_STREAM_H
+#define _PICOVA_STREAM_H
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Binary framing for the measurement stream, shared by the firmware and the
+// host decoder (libpicova).
+//
+// By default the firmware writes one "us,V,mA,mW" CSV line per sample. When
+// built with PICOVA_STREAM_BINARY it instead writes fixed-size frames carrying
+// the raw INA219 registers, which are converted on the host with the same
+// ina219_calc_*() functions the firmware uses. Sample frames refer to a range
+// epoch; a calibration frame maps each epoch to its current and power LSBs
+// and is re-sent whenever the calibration changes and periodically so that a
+// host can join mid-stream. Sensors other than the INA219 have registers the
+// host doesn't know how to convert, so their samples are sent as value frames
+// holding the converted floats instead, which need no calibration.
+//
+// Every frame starts with PICOVA_FRAME_SYNC, which never appears in the CSV
+// text, so a decoder can accept either format. All fields are little-endian
+// and the XOR of all bytes in a valid frame is zero.
+//
+// In either format the firmware may also write status lines starting with
+// '#', such as its I2C error and recovery counts or timestamp jitter.
+// Decoders skip them.
+//
+// Firmware built with marker inputs (PICOVA_MARKERS) adds their state, one
+// bit per input, as a fifth CSV column. Changes are also sent as marker
+// records, timestamped by the edge interrupt: "@us,markers" lines, or
+// marker frames in the binary format. Binary samples carry no marker state
+// of their own; each takes the state of the last marker frame before it,
+// and the firmware sends one with the sample's timestamp if the state it
+// latched differs from what the edges have said, e.g. after a pulse too
+// short to be seen by the interrupt.
+
+#define PICOVA_FRAME_SYNC 0xA5
+
+// Set in a sample frame's bus field (a reserved bit of the INA219's bus
+// register) when the bus voltage wasn't converted for this sample and is
+// the last known value instead.
+#define PICOVA_BUS_HELD 0x04
+
+enum picova_frame_type
+{
+    PICOVA_FRAME_SAMPLE = 1,
+    PICOVA_FRAME_CAL = 2,
+    PICOVA_FRAME_VALUES = 3,
+    PICOVA_FRAME_MARKERS = 4,
+};
+
+struct __attribute__((packed)) picova_frame_header
+{
+    uint8_t sync;
+    uint8_t type;
+    uint8_t epoch;
+    uint8_t check;
+};
+
+struct __attribute__((packed)) picova_frame_sample
+{
+    struct picova_frame_header hdr;
+    uint32_t timestamp;
+    uint16_t bus;
+    uint16_t current;
+    uint16_t power;
+};
+
+struct __attribute__((packed)) picova_frame_values
+{
+    struct picova_frame_header hdr;
+    uint32_t timestamp;
+    float V;
+    float mA;
+    float mW;
+};
+
+struct __attribute__((packed)) picova_frame_markers
+{
+    struct picova_frame_header hdr;
+    uint32_t timestamp;
+    uint8_t markers;
+};
+
+struct __attribute__((packed)) picova_frame_cal
+{
+    struct picova_frame_header hdr;
+    float current_lsb;
+    float power_lsb;
+};
+
+static inline uint8_t picova_frame_xor(const void* frame, uint32_t len)
+{
+    const uint8_t* p = (const uint8_t*)frame;
+    uint8_t x = 0;
+    while (len--)
+        x ^= *p++;
+    return x;
+}
+
+// Fill in the header of a frame whose payload has already been written.
+static inline void picova_frame_seal(void* frame, uint32_t len, enum picova_frame_type type, uint8_t epoch)
+{
+    struct picova_frame_header* hdr = (struct picova_frame_header*)frame;
+    hdr->sync = PICOVA_FRAME_SYNC;
+    hdr->type = type;
+    hdr->epoch = epoch;
+    hdr->check = 0;
+    hdr->check = picova_frame_xor(frame, len);
+}
+
+static inline uint32_t picova_frame_size(uint8_t type)
+{
+    switch (type) {
+    case PICOVA_FRAME_SAMPLE:   return sizeof(struct picova_frame_sample);
+    case PICOVA_FRAME_CAL:      return sizeof(struct picova_frame_cal);
+    case PICOVA_FRAME_VALUES:   return sizeof(struct picova_frame_values);
+    case PICOVA_FRAME_MARKERS:  return sizeof(struct picova_frame_markers);
+    }
+
+    return 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICOVA_STREAM_H
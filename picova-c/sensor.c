@@ -0,0 +1,48 @@
+#include "ina219.h"
+#include "ina226.h"
+#include "ina228.h"
+#include "sensor.h"
+
+// Only one sensor is ever fitted, so the drivers share storage.
+static union
+{
+    ina219_t ina219;
+    ina226_t ina226;
+    ina228_t ina228;
+} sensor_hw;
+
+// Identify the part at `addr` by its ID registers and initialise its driver.
+// The INA219 has no ID registers, so it is assumed when neither of the others
+// answers.
+int sensor_probe(sensor_t* s, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms)
+{
+    if (ina228_probe(i2c, addr)) {
+        s->ops = &ina228_sensor_ops;
+        s->hw = &sensor_hw.ina228;
+        return ina228_init(&sensor_hw.ina228, i2c, addr, shunt_ohms);
+    }
+
+    if (ina226_probe(i2c, addr)) {
+        s->ops = &ina226_sensor_ops;
+        s->hw = &sensor_hw.ina226;
+        return ina226_init(&sensor_hw.ina226, i2c, addr, shunt_ohms);
+    }
+
+    s->ops = &ina219_sensor_ops;
+    s->hw = &sensor_hw.ina219;
+    return ina219_init(&sensor_hw.ina219, i2c, addr, shunt_ohms);
+}
+
+void sensor_update_epoch(sensor_t* s)
+{
+    sensor_cal_t cal;
+    sensor_get_calibration(s, &cal);
+
+    const sensor_lsb_t* cur = &s->lsb[s->epoch];
+    if (cal.current_lsb == cur->current_lsb && cal.power_lsb == cur->power_lsb)
+        return;
+
+    const uint8_t next = (s->epoch + 1) % SENSOR_EPOCHS;
+    s->lsb[next] = (sensor_lsb_t){ cal.current_lsb, cal.power_lsb };
+    s->epoch = next;
+}
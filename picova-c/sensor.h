@@ -0,0 +1,242 @@
+#ifndef _SENSOR_H
+#define _SENSOR_H
+
+#include "hardware/i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// A current/voltage/power monitor on I2C, behind a small table of operations
+// so that read_task and write_task don't care which part is fitted. Each
+// driver (ina219.c, ina226.c, ina228.c) provides one table.
+
+enum sensor_type
+{
+    SENSOR_INA219,
+    SENSOR_INA226,
+    SENSOR_INA228,
+    SENSOR_TYPES,
+};
+
+// Which ADCs convert continuously. Converting only the shunt voltage nearly
+// doubles the current sample rate at a given resolution; the bus voltage is
+// then converted between samples only as often as the read schedule asks
+// for it (see struct sensor_schedule), and held in between.
+enum sensor_mode
+{
+    SENSOR_MODE_SHUNT_BUS,
+    SENSOR_MODE_SHUNT,
+    SENSOR_MODE_BUS,
+};
+
+// Ranges and ADC settings. The codes are the driver's own (e.g. enum
+// ina219_adc), except that range 0 is always the most sensitive, so
+// autoranging only ever counts up. Fields a part doesn't have are 0.
+struct sensor_cfg
+{
+    uint8_t mode;
+    uint8_t bus_range;
+    uint8_t shunt_range;
+    uint8_t bus_adc;
+    uint8_t shunt_adc;
+    uint8_t averaging;
+};
+
+// The calibration register and the LSBs that go with it.
+struct sensor_cal
+{
+    uint16_t cal;
+    float current_lsb;
+    float power_lsb;
+};
+
+// The LSBs that convert the current and power registers.
+struct sensor_lsb
+{
+    float current_lsb;
+    float power_lsb;
+};
+
+// Every change of the LSBs starts a new calibration epoch, numbered modulo
+// SENSOR_EPOCHS. Samples carry just the epoch's number and the LSBs are kept
+// once, in the sensor's table, so that a sample can still be converted after
+// the ranges have moved on. That holds as long as fewer than SENSOR_EPOCHS
+// changes happen while any sample is queued. Autoranging only counts up,
+// through fewer ranges than that, and recovering the sensor restores the LSBs
+// it had; anything that moves the ranges back down must first wait for the
+// samples already queued to be sent.
+#define SENSOR_EPOCHS 16
+
+// One sample as raw register values (at most 24 bits on any part), packed
+// into 12 bytes. Use sensor_convert() to get meaningful values from it.
+struct sensor_data
+{
+    uint32_t bus : 24;
+    uint32_t flags : 4;
+    uint32_t epoch : 4;
+    uint32_t current : 24;
+    uint32_t tag : 8;       // Not used by the sensor; free for the caller
+    uint32_t power : 24;
+};
+
+// Registers that can be fetched for a sample.
+enum sensor_channel
+{
+    SENSOR_CHANNEL_CURRENT = (1 << 0),
+    SENSOR_CHANNEL_BUS = (1 << 1),
+    SENSOR_CHANNEL_POWER = (1 << 2),
+    SENSOR_CHANNEL_ALL = 0x07,
+};
+
+// Which registers sensor_read() fetches: the `channels` mask, except that
+// a new bus voltage is only fetched for every `bus_every`th sample (and
+// never again after the first if 0). The last bus voltage is reused in
+// between and flagged SENSOR_DATA_BUS_HELD, and power is derived from
+// bus × current when it isn't fetched.
+struct sensor_schedule
+{
+    uint8_t channels;
+    uint8_t bus_every;
+};
+
+// Flags in sensor_data.
+enum sensor_data_flags
+{
+    SENSOR_DATA_BUS_HELD = (1 << 0),   // The bus voltage is the last known, not this sample's
+};
+
+typedef struct sensor_cfg sensor_cfg_t;
+typedef struct sensor_cal sensor_cal_t;
+typedef struct sensor_lsb sensor_lsb_t;
+typedef struct sensor_data sensor_data_t;
+typedef struct sensor_schedule sensor_schedule_t;
+
+// Results of sensor_read() other than errors.
+enum sensor_read_result
+{
+    SENSOR_SAMPLE,      // `data` holds a new sample
+    SENSOR_NOT_READY,   // No conversion has finished since the last read
+    SENSOR_RANGED,      // The sample clipped and a range has been increased
+};
+
+struct sensor_ops
+{
+    enum sensor_type type;
+    const char* name;
+
+    // Whether start() routes conversion ready to the ALERT pin. Parts without
+    // one are read on a timer at their conversion rate instead.
+    bool has_alert;
+
+    int (*reset)(void* hw);
+    int (*configure)(void* hw, const sensor_cfg_t* cfg);
+    void (*get_config)(void* hw, sensor_cfg_t* cfg);
+    int (*calibrate)(void* hw);
+    void (*get_calibration)(const void* hw, sensor_cal_t* cal);
+    int (*set_calibration)(void* hw, const sensor_cal_t* cal);
+    int (*start)(void* hw);
+    int (*schedule)(void* hw, const sensor_schedule_t* sched); // NULL if every read is complete
+    int (*read)(void* hw, sensor_data_t* data); // Fills in all but epoch and tag
+    void (*convert)(const sensor_data_t* data, const sensor_lsb_t* lsb, float* V, float* mA, float* mW);
+    uint32_t (*conversion_us)(const sensor_cfg_t* cfg);
+};
+
+// The sensor found by sensor_probe(). `hw` is the driver's own instance.
+// `lsb` holds the LSBs of the last SENSOR_EPOCHS calibration epochs, and
+// `epoch` is the current one; both are only changed by the task that
+// calibrates and reads the sensor.
+struct sensor
+{
+    const struct sensor_ops* ops;
+    void* hw;
+    uint8_t epoch;
+    sensor_lsb_t lsb[SENSOR_EPOCHS];
+};
+
+typedef struct sensor sensor_t;
+
+extern const struct sensor_ops ina219_sensor_ops;
+extern const struct sensor_ops ina226_sensor_ops;
+extern const struct sensor_ops ina228_sensor_ops;
+
+int sensor_probe(sensor_t* s, i2c_inst_t* i2c, uint8_t addr, float shunt_ohms);
+
+// Start a new calibration epoch if the driver's LSBs have changed. The
+// wrappers below call this wherever they can change.
+void sensor_update_epoch(sensor_t* s);
+
+static inline int sensor_reset(sensor_t* s)
+{
+    return s->ops->reset(s->hw);
+}
+
+static inline int sensor_configure(sensor_t* s, const sensor_cfg_t* cfg)
+{
+    return s->ops->configure(s->hw, cfg);
+}
+
+static inline void sensor_get_config(sensor_t* s, sensor_cfg_t* cfg)
+{
+    s->ops->get_config(s->hw, cfg);
+}
+
+static inline int sensor_calibrate(sensor_t* s)
+{
+    int err = s->ops->calibrate(s->hw);
+    sensor_update_epoch(s);
+    return err;
+}
+
+static inline void sensor_get_calibration(const sensor_t* s, sensor_cal_t* cal)
+{
+    s->ops->get_calibration(s->hw, cal);
+}
+
+static inline int sensor_set_calibration(sensor_t* s, const sensor_cal_t* cal)
+{
+    int err = s->ops->set_calibration(s->hw, cal);
+    sensor_update_epoch(s);
+    return err;
+}
+
+static inline int sensor_start(sensor_t* s)
+{
+    return s->ops->start(s->hw);
+}
+
+static inline int sensor_schedule(sensor_t* s, const sensor_schedule_t* sched)
+{
+    if (!s->ops->schedule)
+        return PICO_ERROR_GENERIC;
+
+    return s->ops->schedule(s->hw, sched);
+}
+
+static inline int sensor_read(sensor_t* s, sensor_data_t* data)
+{
+    int ret = s->ops->read(s->hw, data);
+    if (ret == SENSOR_SAMPLE)
+        data->epoch = s->epoch;
+    else if (ret == SENSOR_RANGED)
+        sensor_update_epoch(s);
+    return ret;
+}
+
+static inline void sensor_convert(const sensor_t* s, const sensor_data_t* data, float* V, float* mA, float* mW)
+{
+    s->ops->convert(data, &s->lsb[data->epoch], V, mA, mW);
+}
+
+static inline uint32_t sensor_conversion_us(sensor_t* s)
+{
+    sensor_cfg_t cfg;
+    s->ops->get_config(s->hw, &cfg);
+    return s->ops->conversion_us(&cfg);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SENSOR_H
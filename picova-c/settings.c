@@ -0,0 +1,136 @@
+#include <stddef.h>
+#include <string.h>
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "settings.h"
+
+// Records are appended a page at a time through the sector, and the sector
+// is only erased once every page has been used, so a sector lasts sixteen
+// times as many saves as rewriting a single record would. The last valid
+// record wins.
+#define SETTINGS_OFFSET (PICO_FLASH_SIZE_BYTES - FLASH_SECTOR_SIZE)
+#define SETTINGS_SLOTS (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+
+static const uint32_t SETTINGS_MAGIC = 0x53415650; // "PVAS"
+static const uint16_t SETTINGS_VERSION = 3;
+static const uint32_t FLASH_TIMEOUT_MS = 100;
+
+struct settings_record
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t size;
+    settings_t settings;
+    uint32_t crc;
+};
+
+struct settings_write
+{
+    uint32_t offset;
+    bool erase;
+    uint8_t page[FLASH_PAGE_SIZE];
+};
+
+static const struct settings_record* settings_slot(uint i)
+{
+    return (const struct settings_record*)(XIP_BASE + SETTINGS_OFFSET + i * FLASH_PAGE_SIZE);
+}
+
+static uint32_t settings_crc(const void* data, size_t len)
+{
+    const uint8_t* p = data;
+    uint32_t crc = 0xFFFFFFFF;
+
+    while (len--) {
+        crc ^= *p++;
+        for (int k = 0; k < 8; k++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+
+    return ~crc;
+}
+
+static bool settings_valid(const struct settings_record* r)
+{
+    return r->magic == SETTINGS_MAGIC
+        && r->version == SETTINGS_VERSION
+        && r->size == sizeof(r->settings)
+        && r->crc == settings_crc(r, offsetof(struct settings_record, crc));
+}
+
+// Compare field by field, since the structs may differ in their padding.
+static bool settings_equal(const settings_t* a, const settings_t* b)
+{
+    return a->sensor == b->sensor
+        && a->cfg.mode == b->cfg.mode
+        && a->cfg.bus_range == b->cfg.bus_range
+        && a->cfg.shunt_range == b->cfg.shunt_range
+        && a->cfg.bus_adc == b->cfg.bus_adc
+        && a->cfg.shunt_adc == b->cfg.shunt_adc
+        && a->cfg.averaging == b->cfg.averaging
+        && a->shunt_ohms == b->shunt_ohms
+        && a->cal.cal == b->cal.cal
+        && a->cal.current_lsb == b->cal.current_lsb
+        && a->cal.power_lsb == b->cal.power_lsb;
+}
+
+// Runs with the other core and interrupts held off by flash_safe_execute(),
+// since nothing can execute from flash while it is being written.
+static void settings_program(void* arg)
+{
+    const struct settings_write* w = arg;
+
+    if (w->erase)
+        flash_range_erase(SETTINGS_OFFSET, FLASH_SECTOR_SIZE);
+    flash_range_program(w->offset, w->page, FLASH_PAGE_SIZE);
+}
+
+bool settings_load(settings_t* s)
+{
+    const struct settings_record* latest = NULL;
+
+    for (uint i = 0; i < SETTINGS_SLOTS; i++) {
+        if (settings_valid(settings_slot(i)))
+            latest = settings_slot(i);
+    }
+
+    if (!latest)
+        return false;
+
+    *s = latest->settings;
+    return true;
+}
+
+// Write `s` to flash unless it is what is stored already. This stalls both
+// cores for a page program, or for a sector erase as well every sixteenth
+// save, so only call it when something has actually changed.
+int settings_save(const settings_t* s)
+{
+    settings_t current;
+    if (settings_load(&current) && settings_equal(&current, s))
+        return PICO_OK;
+
+    uint slot = 0;
+    while (slot < SETTINGS_SLOTS && settings_slot(slot)->magic != 0xFFFFFFFF)
+        slot++;
+
+    // Too big for a task's stack.
+    static struct settings_write w;
+    w.erase = slot == SETTINGS_SLOTS;
+    if (w.erase)
+        slot = 0;
+    w.offset = SETTINGS_OFFSET + slot * FLASH_PAGE_SIZE;
+
+    struct settings_record r;
+    memset(&r, 0, sizeof(r));
+    r.magic = SETTINGS_MAGIC;
+    r.version = SETTINGS_VERSION;
+    r.size = sizeof(r.settings);
+    r.settings = *s;
+    r.crc = settings_crc(&r, offsetof(struct settings_record, crc));
+
+    memset(w.page, 0xFF, sizeof(w.page));
+    memcpy(w.page, &r, sizeof(r));
+
+    return flash_safe_execute(settings_program, &w, FLASH_TIMEOUT_MS);
+}
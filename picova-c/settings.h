@@ -0,0 +1,30 @@
+#ifndef _SETTINGS_H
+#define _SETTINGS_H
+
+#include "sensor.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// State kept across power cycles in the last sector of flash: the sensor
+// configuration, including the ranges that autoranging settled on, and the
+// calibration that goes with it.
+struct settings
+{
+    uint8_t sensor;     // enum sensor_type
+    sensor_cfg_t cfg;
+    float shunt_ohms;
+    sensor_cal_t cal;
+};
+
+typedef struct settings settings_t;
+
+bool settings_load(settings_t* s);
+int settings_save(const settings_t* s);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _SETTINGS_H
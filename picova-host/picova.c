@@ -0,0 +1,448 @@
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ina219_calc.h"
+#include "picova.h"
+#include "picova_stream.h"
+
+#define LINE_MAX_LEN PICOVA_STATUS_MAX
+#define FRAME_MAX_LEN sizeof(struct picova_frame_values)
+
+struct picova_decoder
+{
+    struct picova_counters counters;
+
+    bool have_timestamp;
+    uint32_t last_timestamp;
+    uint64_t timestamp_high;
+
+    uint8_t frame[FRAME_MAX_LEN];
+    uint32_t frame_len;
+    uint32_t frame_size;
+
+    char line[LINE_MAX_LEN];
+    uint32_t line_len;
+    bool line_overflow;
+
+    bool keep_status;
+    char status[LINE_MAX_LEN];
+    uint32_t status_len;
+
+    uint8_t markers;
+    uint32_t marker_head;
+    uint32_t marker_count;
+    uint64_t marker_timestamp[PICOVA_MARKER_QUEUE];
+    uint8_t marker_state[PICOVA_MARKER_QUEUE];
+
+    bool cal_valid[256];
+    float current_lsb[256];
+    float power_lsb[256];
+};
+
+struct output
+{
+    uint64_t* timestamp_us;
+    float* bus_V;
+    float* current_mA;
+    float* power_mW;
+    uint8_t* markers;
+    size_t n;
+};
+
+static const double powers_of_10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+picova_decoder_t* picova_decoder_new(void)
+{
+    picova_decoder_t* dec = malloc(sizeof(*dec));
+    if (dec)
+        picova_decoder_reset(dec);
+    return dec;
+}
+
+void picova_decoder_free(picova_decoder_t* dec)
+{
+    free(dec);
+}
+
+void picova_decoder_reset(picova_decoder_t* dec)
+{
+    const bool keep_status = dec->keep_status;
+    memset(dec, 0, sizeof(*dec));
+    dec->keep_status = keep_status;
+}
+
+void picova_keep_status(picova_decoder_t* dec, int keep)
+{
+    dec->keep_status = keep != 0;
+    dec->status_len = 0;
+}
+
+size_t picova_read_status(picova_decoder_t* dec, char* buf, size_t size)
+{
+    if (!dec->status_len || !size)
+        return 0;
+
+    const size_t n = dec->status_len < size - 1 ? dec->status_len : size - 1;
+    memcpy(buf, dec->status, n);
+    buf[n] = '\0';
+    dec->status_len = 0;
+    return n;
+}
+
+void picova_get_counters(const picova_decoder_t* dec, struct picova_counters* counters)
+{
+    *counters = dec->counters;
+}
+
+// Unwrap a 32-bit device timestamp. Only a large backwards step counts as a
+// wrap so that a reset device doesn't jump ahead by 71 minutes.
+static uint64_t unwrap(picova_decoder_t* dec, uint32_t timestamp)
+{
+    if (dec->have_timestamp && timestamp < dec->last_timestamp
+            && dec->last_timestamp - timestamp > 0x80000000u) {
+        dec->timestamp_high += 1ull << 32;
+        dec->counters.wraps++;
+    }
+    dec->have_timestamp = true;
+    dec->last_timestamp = timestamp;
+
+    return dec->timestamp_high | timestamp;
+}
+
+// Append a sample with the current marker state.
+static void emit(picova_decoder_t* dec, struct output* out, uint32_t timestamp, float V, float mA, float mW)
+{
+    out->timestamp_us[out->n] = unwrap(dec, timestamp);
+    out->bus_V[out->n] = V;
+    out->current_mA[out->n] = mA;
+    out->power_mW[out->n] = mW;
+    if (out->markers)
+        out->markers[out->n] = dec->markers;
+    out->n++;
+}
+
+// Record a change of marker state for picova_read_markers(), and apply it
+// to the samples that follow.
+static void emit_markers(picova_decoder_t* dec, uint32_t timestamp, uint8_t markers)
+{
+    const uint64_t t = unwrap(dec, timestamp);
+
+    dec->markers = markers;
+    dec->counters.markers++;
+
+    if (dec->marker_count == PICOVA_MARKER_QUEUE) {
+        dec->counters.lost_markers++;
+        return;
+    }
+
+    const uint32_t i = (dec->marker_head + dec->marker_count++) % PICOVA_MARKER_QUEUE;
+    dec->marker_timestamp[i] = t;
+    dec->marker_state[i] = markers;
+}
+
+size_t picova_read_markers(picova_decoder_t* dec, uint64_t* timestamp_us,
+                           uint8_t* markers, size_t capacity)
+{
+    size_t n = 0;
+
+    for (; n < capacity && dec->marker_count > 0; n++) {
+        timestamp_us[n] = dec->marker_timestamp[dec->marker_head];
+        markers[n] = dec->marker_state[dec->marker_head];
+        dec->marker_head = (dec->marker_head + 1) % PICOVA_MARKER_QUEUE;
+        dec->marker_count--;
+    }
+
+    return n;
+}
+
+static bool parse_uint32(const char** p, const char* end, uint32_t* value)
+{
+    const char* s = *p;
+    uint64_t v = 0;
+
+    if (s == end || *s < '0' || *s > '9')
+        return false;
+
+    while (s < end && *s >= '0' && *s <= '9') {
+        v = v * 10 + (*s++ - '0');
+        if (v > UINT32_MAX)
+            return false;
+    }
+
+    *value = (uint32_t)v;
+    *p = s;
+    return true;
+}
+
+static bool match(const char** p, const char* end, const char* word)
+{
+    const size_t n = strlen(word);
+    if ((size_t)(end - *p) < n || strncmp(*p, word, n) != 0)
+        return false;
+    *p += n;
+    return true;
+}
+
+// Parse the output of printf("%f") (and the odd exponent) without going
+// through the locale-aware strtod.
+static bool parse_float(const char** p, const char* end, float* value)
+{
+    const char* s = *p;
+    bool neg = false;
+    uint64_t mant = 0;
+    int exp10 = 0;
+    int digits = 0;
+
+    if (s < end && (*s == '-' || *s == '+'))
+        neg = *s++ == '-';
+
+    if (match(&s, end, "nan")) {
+        *value = NAN;
+        *p = s;
+        return true;
+    }
+
+    if (match(&s, end, "inf")) {
+        *value = neg ? -INFINITY : INFINITY;
+        *p = s;
+        return true;
+    }
+
+    for (; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+        if (mant < 1000000000000000000ull)
+            mant = mant * 10 + (*s - '0');
+        else
+            exp10++;
+    }
+
+    if (s < end && *s == '.') {
+        for (s++; s < end && *s >= '0' && *s <= '9'; s++, digits++) {
+            if (mant < 1000000000000000000ull) {
+                mant = mant * 10 + (*s - '0');
+                exp10--;
+            }
+        }
+    }
+
+    if (!digits)
+        return false;
+
+    if (s < end && (*s == 'e' || *s == 'E')) {
+        bool exp_neg = false;
+        int e = 0;
+        s++;
+        if (s < end && (*s == '-' || *s == '+'))
+            exp_neg = *s++ == '-';
+        if (s == end || *s < '0' || *s > '9')
+            return false;
+        for (; s < end && *s >= '0' && *s <= '9'; s++)
+            e = e < 1000 ? e * 10 + (*s - '0') : e;
+        exp10 += exp_neg ? -e : e;
+    }
+
+    double v = (double)mant;
+    if (exp10 < 0)
+        v = exp10 >= -22 ? v / powers_of_10[-exp10] : v / pow(10, -exp10);
+    else if (exp10 > 0)
+        v = exp10 <= 22 ? v * powers_of_10[exp10] : v * pow(10, exp10);
+
+    *value = (float)(neg ? -v : v);
+    *p = s;
+    return true;
+}
+
+static bool at_end(const char* p, const char* end)
+{
+    while (p < end && (*p == ' ' || *p == '\t'))
+        p++;
+    return p == end;
+}
+
+// Parse a "us,V,mA,mW" line, or "us,V,mA,mW,markers".
+static bool decode_line(picova_decoder_t* dec, struct output* out)
+{
+    const char* p = dec->line;
+    const char* end = dec->line + dec->line_len;
+    uint32_t timestamp, markers = dec->markers;
+    float V, mA, mW;
+
+    if (!parse_uint32(&p, end, &timestamp) || !match(&p, end, ",")
+            || !parse_float(&p, end, &V) || !match(&p, end, ",")
+            || !parse_float(&p, end, &mA) || !match(&p, end, ",")
+            || !parse_float(&p, end, &mW))
+        return false;
+
+    if (match(&p, end, ",") && (!parse_uint32(&p, end, &markers) || markers > UINT8_MAX))
+        return false;
+
+    if (!at_end(p, end))
+        return false;
+
+    dec->markers = markers;
+    emit(dec, out, timestamp, V, mA, mW);
+    return true;
+}
+
+// Parse an "@us,markers" marker record.
+static bool decode_markers_line(picova_decoder_t* dec)
+{
+    const char* p = dec->line + 1;
+    const char* end = dec->line + dec->line_len;
+    uint32_t timestamp, markers;
+
+    if (!parse_uint32(&p, end, &timestamp) || !match(&p, end, ",")
+            || !parse_uint32(&p, end, &markers) || markers > UINT8_MAX
+            || !at_end(p, end))
+        return false;
+
+    emit_markers(dec, timestamp, markers);
+    return true;
+}
+
+static uint16_t rd16(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static uint32_t rd32(const uint8_t* p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static float rdf32(const uint8_t* p)
+{
+    const uint32_t u = rd32(p);
+    float f;
+    memcpy(&f, &u, sizeof(f));
+    return f;
+}
+
+static void decode_frame(picova_decoder_t* dec, struct output* out)
+{
+    const uint8_t* f = dec->frame;
+    const uint8_t type = f[offsetof(struct picova_frame_header, type)];
+    const uint8_t epoch = f[offsetof(struct picova_frame_header, epoch)];
+
+    if (picova_frame_xor(f, dec->frame_size) != 0) {
+        dec->counters.bad_frames++;
+        return;
+    }
+
+    dec->counters.frames++;
+
+    if (type == PICOVA_FRAME_CAL) {
+        dec->cal_valid[epoch] = true;
+        dec->current_lsb[epoch] = rdf32(f + offsetof(struct picova_frame_cal, current_lsb));
+        dec->power_lsb[epoch] = rdf32(f + offsetof(struct picova_frame_cal, power_lsb));
+        return;
+    }
+
+    if (type == PICOVA_FRAME_MARKERS) {
+        emit_markers(dec, rd32(f + offsetof(struct picova_frame_markers, timestamp)),
+                     f[offsetof(struct picova_frame_markers, markers)]);
+        return;
+    }
+
+    if (type == PICOVA_FRAME_VALUES) {
+        emit(dec, out, rd32(f + offsetof(struct picova_frame_values, timestamp)),
+             rdf32(f + offsetof(struct picova_frame_values, V)),
+             rdf32(f + offsetof(struct picova_frame_values, mA)),
+             rdf32(f + offsetof(struct picova_frame_values, mW)));
+        return;
+    }
+
+    if (!dec->cal_valid[epoch]) {
+        dec->counters.no_cal++;
+        return;
+    }
+
+    const uint16_t bus = rd16(f + offsetof(struct picova_frame_sample, bus));
+    const uint16_t current = rd16(f + offsetof(struct picova_frame_sample, current));
+    const uint16_t power = rd16(f + offsetof(struct picova_frame_sample, power));
+
+    if (bus & PICOVA_BUS_HELD)
+        dec->counters.held_bus++;
+
+    emit(dec, out, rd32(f + offsetof(struct picova_frame_sample, timestamp)),
+         ina219_calc_bus_V(bus),
+         ina219_calc_current_mA(current, dec->current_lsb[epoch]),
+         ina219_calc_power_mW(power, dec->power_lsb[epoch]));
+}
+
+size_t picova_decode(picova_decoder_t* dec,
+                     const uint8_t* data, size_t len, size_t* consumed,
+                     uint64_t* timestamp_us, float* bus_V,
+                     float* current_mA, float* power_mW,
+                     uint8_t* markers, size_t capacity)
+{
+    struct output out = { timestamp_us, bus_V, current_mA, power_mW, markers, 0 };
+    bool status = false;
+    size_t i;
+
+    for (i = 0; i < len && out.n < capacity && !status; i++) {
+        const uint8_t c = data[i];
+
+        // Inside a binary frame
+        if (dec->frame_len > 0) {
+            dec->frame[dec->frame_len++] = c;
+
+            if (dec->frame_len == 2) {
+                dec->frame_size = picova_frame_size(c);
+                if (!dec->frame_size) {
+                    dec->counters.bad_frames++;
+                    dec->frame_len = 0;
+                }
+            } else if (dec->frame_len == dec->frame_size) {
+                decode_frame(dec, &out);
+                dec->frame_len = 0;
+            }
+            continue;
+        }
+
+        if (c == PICOVA_FRAME_SYNC) {
+            if (dec->line_len > 0 || dec->line_overflow) {
+                dec->counters.bad_lines++;
+                dec->line_len = 0;
+                dec->line_overflow = false;
+            }
+            dec->frame[0] = c;
+            dec->frame_len = 1;
+            continue;
+        }
+
+        if (c == '\n') {
+            if (dec->line_len > 0 && dec->line[0] == '#') {
+                dec->counters.status_lines++;
+                if (dec->keep_status) {
+                    memcpy(dec->status, dec->line, dec->line_len);
+                    dec->status_len = dec->line_len;
+                    status = true;
+                }
+            } else if (dec->line_len > 0 || dec->line_overflow) {
+                dec->counters.lines++;
+                if (dec->line_overflow || !(dec->line[0] == '@'
+                        ? decode_markers_line(dec) : decode_line(dec, &out)))
+                    dec->counters.bad_lines++;
+            }
+            dec->line_len = 0;
+            dec->line_overflow = false;
+            continue;
+        }
+
+        if (c == '\r')
+            continue;
+
+        if (dec->line_len < LINE_MAX_LEN)
+            dec->line[dec->line_len++] = c;
+        else
+            dec->line_overflow = true;
+    }
+
+    dec->counters.bytes += i;
+    dec->counters.samples += out.n;
+    *consumed = i;
+    return out.n;
+}
@@ -0,0 +1,89 @@
+#ifndef _PICOVA_H
+#define _PICOVA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32) && defined(PICOVA_BUILD)
+#define PICOVA_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define PICOVA_API __declspec(dllimport)
+#else
+#define PICOVA_API __attribute__((visibility("default")))
+#endif
+
+// Streaming decoder for the PicoVA measurement stream. Accepts arbitrary
+// chunks of bytes as read from the serial port, in either the CSV text
+// format or the binary frame format (see picova_stream.h), and writes
+// decoded samples into caller-owned columnar arrays. Partial lines and
+// frames are buffered between calls. Device timestamps are unwrapped from
+// 32 to 64 bits. Marker records are queued inside the decoder to be
+// collected with picova_read_markers(), and '#' status lines can be kept
+// for picova_read_status().
+typedef struct picova_decoder picova_decoder_t;
+
+struct picova_counters
+{
+    uint64_t bytes;         // Bytes passed to picova_decode()
+    uint64_t samples;       // Samples written out
+    uint64_t lines;         // Complete text lines seen
+    uint64_t frames;        // Complete binary frames seen
+    uint64_t bad_lines;     // Text lines that failed to parse
+    uint64_t bad_frames;    // Binary frames with a bad type or checksum
+    uint64_t no_cal;        // Sample frames dropped for lack of a calibration frame
+    uint64_t wraps;         // Times the 32-bit device timestamp wrapped
+    uint64_t held_bus;      // Sample frames carrying a held bus voltage
+    uint64_t status_lines;  // '#' status lines seen
+    uint64_t markers;       // Marker records seen
+    uint64_t lost_markers;  // Marker records dropped because the queue was full
+};
+
+PICOVA_API picova_decoder_t* picova_decoder_new(void);
+PICOVA_API void picova_decoder_free(picova_decoder_t* dec);
+PICOVA_API void picova_decoder_reset(picova_decoder_t* dec);
+
+// Decode up to `len` bytes of `data`, writing at most `capacity` samples to
+// the output arrays. Returns the number of samples written. `*consumed` is set
+// to the number of bytes used, which is less than `len` only if the output
+// filled up or a status line is being kept (see picova_keep_status()); pass
+// the remainder in the next call. `markers` may be NULL;
+// otherwise each sample's marker state is written there, 0 from firmware
+// without marker inputs.
+PICOVA_API size_t picova_decode(picova_decoder_t* dec,
+                                const uint8_t* data, size_t len, size_t* consumed,
+                                uint64_t* timestamp_us, float* bus_V,
+                                float* current_mA, float* power_mW,
+                                uint8_t* markers, size_t capacity);
+
+// Move up to `capacity` of the marker records decoded so far, oldest first,
+// into the output arrays and return how many were written. Each is the
+// state of the marker inputs from the given time on. Up to
+// PICOVA_MARKER_QUEUE records are kept between calls.
+#define PICOVA_MARKER_QUEUE 1024
+PICOVA_API size_t picova_read_markers(picova_decoder_t* dec, uint64_t* timestamp_us,
+                                      uint8_t* markers, size_t capacity);
+
+// Have picova_decode() stop after each '#' status line, so that it can be
+// collected with picova_read_status() at its place in the stream before
+// decoding on. Off by default, when status lines are only counted. The
+// setting survives picova_decoder_reset().
+PICOVA_API void picova_keep_status(picova_decoder_t* dec, int keep);
+
+// Copy the status line picova_decode() last stopped after, without its line
+// ending, into `buf` as a NUL-terminated string cut to fit `size`, and return
+// its length. Returns 0 if there is none waiting. Lines longer than
+// PICOVA_STATUS_MAX are cut short by the decoder.
+#define PICOVA_STATUS_MAX 256
+PICOVA_API size_t picova_read_status(picova_decoder_t* dec, char* buf, size_t size);
+
+PICOVA_API void picova_get_counters(const picova_decoder_t* dec, struct picova_counters* counters);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _PICOVA_H
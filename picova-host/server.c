@@ -0,0 +1,545 @@
+// picova-server: share one PicoVA between any number of host tools.
+//
+// Only one process can have a serial port open, so this one owns it,
+// decodes the stream once with libpicova and republishes every batch to
+// each subscriber on a local TCP or Unix socket. Subscribers receive the
+// binary frame format (see picova_stream.h) whatever the device sends:
+// value frames for the samples and marker frames for the marker records,
+// starting at a frame boundary with the current marker state, and the
+// firmware's '#' status lines (bus health, jitter) where they came in the
+// stream, so the existing decoders read a socket exactly as they read the
+// port.
+//
+// The port is read as fast as the device writes and sockets are never
+// written with a blocking call. Each subscriber has its own queue; when a
+// slow one's queue is full, it either misses whole batches (--policy drop)
+// or is disconnected (--policy buffer, with a larger queue), and the others
+// carry on unaffected.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "picova.h"
+#include "picova_stream.h"
+
+#define MAX_LISTENERS 8
+#define MAX_CLIENTS 64
+#define BATCH 4096
+
+enum policy
+{
+    POLICY_DROP,
+    POLICY_BUFFER,
+};
+
+struct options
+{
+    const char* device;
+    const char* listen[MAX_LISTENERS];
+    int listeners;
+    enum policy policy;
+    size_t queue_limit;
+};
+
+struct listener
+{
+    int fd;
+    const char* unix_path;
+};
+
+struct client
+{
+    int fd;
+    unsigned id;
+    char* queue;
+    size_t head, len, cap;
+    // Set when a batch was dropped, so the next one starts by restating
+    // the marker state it may have missed.
+    bool resync;
+    uint64_t samples, dropped;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static int open_port(const char* path)
+{
+    int fd = open(path, O_RDONLY | O_NOCTTY | O_NONBLOCK);
+    if (fd < 0)
+        return -1;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0) {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+}
+
+// Listen on "tcp:[HOST:]PORT" or "unix:PATH".
+static bool open_listener(const char* addr, struct listener* l)
+{
+    *l = (struct listener){ .fd = -1 };
+
+    if (!strncmp(addr, "unix:", 5)) {
+        struct sockaddr_un sun = { .sun_family = AF_UNIX };
+        if (strlen(addr + 5) >= sizeof(sun.sun_path))
+            return false;
+        strcpy(sun.sun_path, addr + 5);
+        unlink(sun.sun_path);
+
+        l->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (l->fd < 0 || bind(l->fd, (struct sockaddr*)&sun, sizeof(sun)) < 0 || listen(l->fd, 16) < 0) {
+            perror(addr);
+            return false;
+        }
+        l->unix_path = addr + 5;
+        return true;
+    }
+
+    if (strncmp(addr, "tcp:", 4))
+        return false;
+
+    char host[256] = "127.0.0.1";
+    const char* port = strrchr(addr + 4, ':');
+    if (port) {
+        const size_t n = port - (addr + 4);
+        if (n >= sizeof(host))
+            return false;
+        memcpy(host, addr + 4, n);
+        host[n] = '\0';
+        port++;
+    } else {
+        port = addr + 4;
+    }
+
+    struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM, .ai_flags = AI_PASSIVE };
+    struct addrinfo* res;
+    int err = getaddrinfo(host, port, &hints, &res);
+    if (err) {
+        fprintf(stderr, "%s: %s\n", addr, gai_strerror(err));
+        return false;
+    }
+
+    const int on = 1;
+    l->fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (l->fd < 0
+        || setsockopt(l->fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on)) < 0
+        || bind(l->fd, res->ai_addr, res->ai_addrlen) < 0
+        || listen(l->fd, 16) < 0) {
+        perror(addr);
+        freeaddrinfo(res);
+        return false;
+    }
+
+    freeaddrinfo(res);
+    return true;
+}
+
+// Queue `len` bytes for a client if they fit within `limit`, growing its
+// queue as needed.
+static bool enqueue(struct client* c, const char* data, size_t len, size_t limit)
+{
+    if (c->len + len > limit)
+        return false;
+
+    if (c->head + c->len + len > c->cap) {
+        memmove(c->queue, c->queue + c->head, c->len);
+        c->head = 0;
+
+        if (c->len + len > c->cap) {
+            size_t cap = c->cap ? c->cap : 65536;
+            while (cap < c->len + len)
+                cap *= 2;
+            char* grown = realloc(c->queue, cap);
+            if (!grown)
+                return false;
+            c->queue = grown;
+            c->cap = cap;
+        }
+    }
+
+    memcpy(c->queue + c->head + c->len, data, len);
+    c->len += len;
+    return true;
+}
+
+// Write as much of a client's queue as the socket takes without blocking.
+// Returns false if the client has gone.
+static bool flush_client(struct client* c)
+{
+    while (c->len > 0) {
+        ssize_t n = send(c->fd, c->queue + c->head, c->len, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        c->head += n;
+        c->len -= n;
+    }
+
+    c->head = 0;
+    return true;
+}
+
+static void close_client(struct client* c, const char* why)
+{
+    fprintf(stderr, "client %u %s: %llu samples sent, %llu dropped\n", c->id, why,
+        (unsigned long long)c->samples, (unsigned long long)c->dropped);
+    close(c->fd);
+    free(c->queue);
+    *c = (struct client){ .fd = -1 };
+}
+
+static size_t format_markers(char* buf, uint64_t timestamp, uint8_t markers)
+{
+    struct picova_frame_markers frame;
+    frame.timestamp = (uint32_t)timestamp;
+    frame.markers = markers;
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_MARKERS, 0);
+    memcpy(buf, &frame, sizeof(frame));
+    return sizeof(frame);
+}
+
+static size_t format_values(char* buf, uint64_t timestamp, float V, float mA, float mW)
+{
+    struct picova_frame_values frame;
+    frame.timestamp = (uint32_t)timestamp;
+    frame.V = V;
+    frame.mA = mA;
+    frame.mW = mW;
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_VALUES, 0);
+    memcpy(buf, &frame, sizeof(frame));
+    return sizeof(frame);
+}
+
+// Re-encode one decoded batch as frames. The marker records go in time
+// order among the samples, and a sample whose latched state differs from
+// what they said gets a marker frame of its own, as the firmware does.
+static size_t encode(char* buf, size_t n, const uint64_t* ts, const float* V, const float* mA,
+                     const float* mW, const uint8_t* markers, size_t edges,
+                     const uint64_t* edge_ts, const uint8_t* edge_markers, uint8_t* state)
+{
+    size_t len = 0, e = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        for (; e < edges && edge_ts[e] <= ts[i]; e++) {
+            *state = edge_markers[e];
+            len += format_markers(buf + len, edge_ts[e], *state);
+        }
+        if (markers[i] != *state) {
+            *state = markers[i];
+            len += format_markers(buf + len, ts[i], *state);
+        }
+        len += format_values(buf + len, ts[i], V[i], mA[i], mW[i]);
+    }
+
+    for (; e < edges; e++) {
+        *state = edge_markers[e];
+        len += format_markers(buf + len, edge_ts[e], *state);
+    }
+
+    return len;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [options] DEVICE\n"
+        "  -l, --listen ADDR    tcp:[HOST:]PORT or unix:PATH to accept subscribers on;\n"
+        "                       may be repeated (default tcp:127.0.0.1:4219)\n"
+        "  -p, --policy P       for a subscriber that falls behind: drop (default)\n"
+        "                       skips whole batches, buffer disconnects it once its\n"
+        "                       queue is full\n"
+        "  -q, --queue KB       per-subscriber queue limit (default 1024 for drop,\n"
+        "                       65536 for buffer)\n",
+        argv0);
+}
+
+static bool parse_options(int argc, char** argv, struct options* opt)
+{
+    static const struct option longopts[] = {
+        { "listen", required_argument, NULL, 'l' },
+        { "policy", required_argument, NULL, 'p' },
+        { "queue",  required_argument, NULL, 'q' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    *opt = (struct options){ 0 };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "l:p:q:", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'l':
+            if (opt->listeners == MAX_LISTENERS)
+                return false;
+            opt->listen[opt->listeners++] = optarg;
+            break;
+        case 'p':
+            if (!strcmp(optarg, "drop"))
+                opt->policy = POLICY_DROP;
+            else if (!strcmp(optarg, "buffer"))
+                opt->policy = POLICY_BUFFER;
+            else
+                return false;
+            break;
+        case 'q':
+            opt->queue_limit = strtoul(optarg, NULL, 0) * 1024;
+            if (!opt->queue_limit)
+                return false;
+            break;
+        default:
+            return false;
+        }
+    }
+
+    if (optind + 1 != argc)
+        return false;
+    opt->device = argv[optind];
+
+    if (!opt->listeners)
+        opt->listen[opt->listeners++] = "tcp:127.0.0.1:4219";
+    if (!opt->queue_limit)
+        opt->queue_limit = (opt->policy == POLICY_DROP ? 1024 : 65536) * 1024;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    struct options opt;
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct listener listeners[MAX_LISTENERS];
+    for (int i = 0; i < opt.listeners; i++) {
+        if (!open_listener(opt.listen[i], &listeners[i])) {
+            fprintf(stderr, "can't listen on %s\n", opt.listen[i]);
+            return 1;
+        }
+    }
+
+    picova_decoder_t* dec = picova_decoder_new();
+    if (!dec)
+        return 1;
+    // The firmware's status lines are passed on where they came.
+    picova_keep_status(dec, 1);
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    static struct client clients[MAX_CLIENTS];
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        clients[i].fd = -1;
+    unsigned next_id = 1;
+
+    static uint8_t rx[16384];
+    static uint64_t ts[BATCH], edge_ts[BATCH];
+    static float V[BATCH], mA[BATCH], mW[BATCH];
+    static uint8_t markers[BATCH], edge_markers[BATCH];
+    // Worst case, every sample with a marker frame of its own on top of
+    // every marker record, then a status line.
+    static char out[BATCH * (sizeof(struct picova_frame_values) + 2 * sizeof(struct picova_frame_markers))
+        + PICOVA_STATUS_MAX + 1];
+    uint8_t state = 0;
+    uint64_t last_ts = 0;
+
+    int port = -1;
+    uint64_t retry_at = 0;
+    uint64_t next_report = now_ns() + 10000000000ull;
+    uint64_t samples = 0, samples_last = 0;
+
+    while (running) {
+        const uint64_t now = now_ns();
+        if (port < 0 && now >= retry_at) {
+            port = open_port(opt.device);
+            if (port < 0) {
+                if (!retry_at)
+                    perror(opt.device);
+                retry_at = now + 1000000000ull;
+            } else {
+                fprintf(stderr, "reading %s\n", opt.device);
+                picova_decoder_reset(dec);
+            }
+        }
+
+        struct pollfd fds[1 + MAX_LISTENERS + MAX_CLIENTS];
+        struct client* polled[MAX_CLIENTS];
+        int nfds = 0;
+
+        fds[nfds++] = (struct pollfd){ .fd = port, .events = POLLIN };
+        for (int i = 0; i < opt.listeners; i++)
+            fds[nfds++] = (struct pollfd){ .fd = listeners[i].fd, .events = POLLIN };
+        const int first_client = nfds;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (clients[i].fd < 0)
+                continue;
+            polled[nfds - first_client] = &clients[i];
+            fds[nfds++] = (struct pollfd){
+                .fd = clients[i].fd,
+                .events = POLLIN | (clients[i].len ? POLLOUT : 0),
+            };
+        }
+
+        if (poll(fds, nfds, port < 0 ? 200 : 1000) < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("poll");
+            break;
+        }
+
+        for (int i = 0; i < opt.listeners; i++) {
+            if (!(fds[1 + i].revents & POLLIN))
+                continue;
+
+            int fd = accept4(listeners[i].fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+                continue;
+
+            struct client* c = NULL;
+            for (int k = 0; k < MAX_CLIENTS && !c; k++) {
+                if (clients[k].fd < 0)
+                    c = &clients[k];
+            }
+            if (!c) {
+                close(fd);
+                continue;
+            }
+
+            // Start the subscriber off with the marker state.
+            *c = (struct client){ .fd = fd, .id = next_id++ };
+            char frame[sizeof(struct picova_frame_markers)];
+            enqueue(c, frame, format_markers(frame, last_ts, state), opt.queue_limit);
+            fprintf(stderr, "client %u connected on %s\n", c->id, opt.listen[i]);
+        }
+
+        for (int i = first_client; i < nfds; i++) {
+            struct client* c = polled[i - first_client];
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                // Subscribers have nothing to say; anything they send is
+                // discarded, and end of file means they've gone.
+                char discard[256];
+                ssize_t n = recv(c->fd, discard, sizeof(discard), MSG_DONTWAIT);
+                if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+                    close_client(c, "disconnected");
+                    continue;
+                }
+            }
+            if ((fds[i].revents & POLLOUT) && !flush_client(c))
+                close_client(c, "disconnected");
+        }
+
+        if (port >= 0 && (fds[0].revents & (POLLIN | POLLHUP | POLLERR))) {
+            ssize_t len = read(port, rx, sizeof(rx));
+            if (len <= 0 && !(len < 0 && (errno == EAGAIN || errno == EINTR))) {
+                fprintf(stderr, "lost %s\n", opt.device);
+                close(port);
+                port = -1;
+                retry_at = now + 1000000000ull;
+                continue;
+            }
+
+            const uint8_t* data = rx;
+            while (len > 0) {
+                size_t consumed;
+                const size_t n = picova_decode(dec, data, len, &consumed, ts, V, mA, mW, markers, BATCH);
+                data += consumed;
+                len -= consumed;
+
+                const uint8_t before = state;
+                const size_t edges = picova_read_markers(dec, edge_ts, edge_markers, BATCH);
+                size_t out_len = encode(out, n, ts, V, mA, mW, markers, edges, edge_ts, edge_markers, &state);
+                size_t status_len = picova_read_status(dec, out + out_len, PICOVA_STATUS_MAX + 1);
+                if (status_len)
+                    out[out_len + status_len++] = '\n';
+                out_len += status_len;
+                if (!out_len)
+                    continue;
+                if (n > 0)
+                    last_ts = ts[n - 1];
+                samples += n;
+
+                for (int k = 0; k < MAX_CLIENTS; k++) {
+                    struct client* c = &clients[k];
+                    if (c->fd < 0)
+                        continue;
+
+                    char frame[sizeof(struct picova_frame_markers)];
+                    const size_t pre = c->resync ? format_markers(frame, n ? ts[0] : last_ts, before) : 0;
+                    if (c->len + pre + out_len <= opt.queue_limit) {
+                        enqueue(c, frame, pre, opt.queue_limit);
+                        enqueue(c, out, out_len, opt.queue_limit);
+                        c->resync = false;
+                        c->samples += n;
+                    } else if (opt.policy == POLICY_DROP) {
+                        c->resync = true;
+                        c->dropped += n;
+                    } else {
+                        close_client(c, "fell behind");
+                        continue;
+                    }
+
+                    if (!flush_client(c))
+                        close_client(c, "disconnected");
+                }
+            }
+        }
+
+        if (now >= next_report) {
+            int n = 0;
+            uint64_t dropped = 0;
+            for (int k = 0; k < MAX_CLIENTS; k++) {
+                if (clients[k].fd >= 0) {
+                    n++;
+                    dropped += clients[k].dropped;
+                }
+            }
+            fprintf(stderr, "%.0f samples/s, %d subscribers, %llu dropped\n",
+                (samples - samples_last) / 10.0, n, (unsigned long long)dropped);
+            samples_last = samples;
+            next_report += 10000000000ull;
+        }
+    }
+
+    for (int k = 0; k < MAX_CLIENTS; k++) {
+        if (clients[k].fd >= 0)
+            close_client(&clients[k], "closed");
+    }
+    for (int i = 0; i < opt.listeners; i++) {
+        close(listeners[i].fd);
+        if (listeners[i].unix_path)
+            unlink(listeners[i].unix_path);
+    }
+    if (port >= 0)
+        close(port);
+    picova_decoder_free(dec);
+    return 0;
+}
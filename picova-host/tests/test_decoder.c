@@ -0,0 +1,335 @@
+// Tests for the libpicova stream decoder, run by ctest. Each test feeds a
+// hand-built stream through picova_decode() and checks the samples and
+// counters that come out.
+
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "ina219_calc.h"
+#include "picova.h"
+#include "picova_stream.h"
+
+#define CAPACITY 64
+
+static int failures = 0;
+
+#define CHECK(cond) do { \
+        if (!(cond)) { \
+            fprintf(stderr, "%s:%d: %s: check failed: %s\n", __FILE__, __LINE__, __func__, #cond); \
+            failures++; \
+        } \
+    } while (0)
+
+struct result
+{
+    size_t n;
+    uint64_t ts[CAPACITY];
+    float V[CAPACITY], mA[CAPACITY], mW[CAPACITY];
+    uint8_t markers[CAPACITY];
+    struct picova_counters counters;
+};
+
+// Decode `len` bytes in chunks of `chunk` bytes (all at once if 0),
+// collecting every sample.
+static void decode(picova_decoder_t* dec, const void* data, size_t len, size_t chunk, struct result* r)
+{
+    const uint8_t* p = data;
+    if (!chunk)
+        chunk = len;
+
+    while (len > 0) {
+        const size_t n = len < chunk ? len : chunk;
+        size_t consumed;
+        r->n += picova_decode(dec, p, n, &consumed, r->ts + r->n, r->V + r->n, r->mA + r->n,
+                              r->mW + r->n, r->markers + r->n, CAPACITY - r->n);
+        CHECK(consumed == n);
+        p += n;
+        len -= n;
+    }
+
+    picova_get_counters(dec, &r->counters);
+}
+
+static size_t put_sample(uint8_t* buf, uint32_t timestamp, uint16_t bus, uint16_t current, uint16_t power, uint8_t epoch)
+{
+    struct picova_frame_sample f;
+    f.timestamp = timestamp;
+    f.bus = bus;
+    f.current = current;
+    f.power = power;
+    picova_frame_seal(&f, sizeof(f), PICOVA_FRAME_SAMPLE, epoch);
+    memcpy(buf, &f, sizeof(f));
+    return sizeof(f);
+}
+
+static size_t put_cal(uint8_t* buf, float current_lsb, float power_lsb, uint8_t epoch)
+{
+    struct picova_frame_cal f;
+    f.current_lsb = current_lsb;
+    f.power_lsb = power_lsb;
+    picova_frame_seal(&f, sizeof(f), PICOVA_FRAME_CAL, epoch);
+    memcpy(buf, &f, sizeof(f));
+    return sizeof(f);
+}
+
+static size_t put_markers(uint8_t* buf, uint32_t timestamp, uint8_t markers)
+{
+    struct picova_frame_markers f;
+    f.timestamp = timestamp;
+    f.markers = markers;
+    picova_frame_seal(&f, sizeof(f), PICOVA_FRAME_MARKERS, 0);
+    memcpy(buf, &f, sizeof(f));
+    return sizeof(f);
+}
+
+// Bus register for `mV` with a finished conversion.
+static uint16_t bus_reg(unsigned mV)
+{
+    return (uint16_t)((mV / 4) << 3 | INA219_BUS_CNVR);
+}
+
+static void test_csv_lines(void)
+{
+    static const char text[] =
+        "1000,3.300000,12.500000,41.250000\n"
+        "# i2c errors=0 bus_clears=0 power_cycles=0 max_gap_us=0\n"
+        "2000,3.299000,-1.000000,3.299000,5\r\n"
+        "@2500,1\n"
+        "not,a,sample\n"
+        "3000,nan,inf,-inf\n";
+
+    picova_decoder_t* dec = picova_decoder_new();
+    struct result r = {0};
+    decode(dec, text, strlen(text), 0, &r);
+
+    CHECK(r.n == 3);
+    CHECK(r.ts[0] == 1000 && r.V[0] == 3.3f && r.mA[0] == 12.5f && r.mW[0] == 41.25f && r.markers[0] == 0);
+    CHECK(r.ts[1] == 2000 && r.V[1] == 3.299f && r.mA[1] == -1.f && r.markers[1] == 5);
+    CHECK(r.ts[2] == 3000 && isnan(r.V[2]) && r.mA[2] == INFINITY && r.mW[2] == -INFINITY);
+    // The marker record sets the state the next sample takes.
+    CHECK(r.markers[2] == 1);
+    CHECK(r.counters.lines == 5);
+    CHECK(r.counters.bad_lines == 1);
+    CHECK(r.counters.status_lines == 1);
+    CHECK(r.counters.markers == 1);
+
+    uint64_t ts[4];
+    uint8_t states[4];
+    CHECK(picova_read_markers(dec, ts, states, 4) == 1);
+    CHECK(ts[0] == 2500 && states[0] == 1);
+
+    picova_decoder_free(dec);
+}
+
+static void test_frames(void)
+{
+    uint8_t buf[256];
+    size_t len = 0;
+    len += put_cal(buf + len, 1e-4f, 2e-3f, 3);
+    len += put_markers(buf + len, 900, 0x2);
+    len += put_sample(buf + len, 1000, bus_reg(3300), 1234, 567, 3);
+
+    struct picova_frame_values v;
+    v.timestamp = 1100;
+    v.V = 5.f;
+    v.mA = 1.5f;
+    v.mW = 7.5f;
+    picova_frame_seal(&v, sizeof(v), PICOVA_FRAME_VALUES, 0);
+    memcpy(buf + len, &v, sizeof(v));
+    len += sizeof(v);
+
+    picova_decoder_t* dec = picova_decoder_new();
+    struct result r = {0};
+    decode(dec, buf, len, 0, &r);
+
+    CHECK(r.n == 2);
+    CHECK(r.ts[0] == 1000);
+    CHECK(r.V[0] == ina219_calc_bus_V(bus_reg(3300)));
+    CHECK(r.mA[0] == ina219_calc_current_mA(1234, 1e-4f));
+    CHECK(r.mW[0] == ina219_calc_power_mW(567, 2e-3f));
+    CHECK(r.markers[0] == 0x2);
+    CHECK(r.ts[1] == 1100 && r.V[1] == 5.f && r.mA[1] == 1.5f && r.mW[1] == 7.5f && r.markers[1] == 0x2);
+    CHECK(r.counters.frames == 4);
+    CHECK(r.counters.bad_frames == 0);
+    CHECK(r.counters.markers == 1);
+
+    picova_decoder_free(dec);
+}
+
+// Every split point, so that chunks end mid-line and mid-frame.
+static void test_split_chunks(void)
+{
+    uint8_t buf[256];
+    size_t len = 0;
+    len += put_cal(buf + len, 1e-4f, 2e-3f, 0);
+    len += put_sample(buf + len, 10, bus_reg(1000), 100, 200, 0);
+    static const char line[] = "20,1.000000,2.000000,3.000000\n";
+    memcpy(buf + len, line, strlen(line));
+    len += strlen(line);
+    len += put_sample(buf + len, 30, bus_reg(2000), 300, 400, 0);
+
+    for (size_t chunk = 1; chunk <= len; chunk++) {
+        picova_decoder_t* dec = picova_decoder_new();
+        struct result r = {0};
+        decode(dec, buf, len, chunk, &r);
+
+        CHECK(r.n == 3);
+        CHECK(r.ts[0] == 10 && r.ts[1] == 20 && r.ts[2] == 30);
+        CHECK(r.V[1] == 1.f && r.mA[1] == 2.f && r.mW[1] == 3.f);
+        CHECK(r.mA[2] == ina219_calc_current_mA(300, 1e-4f));
+        CHECK(r.counters.bad_lines == 0 && r.counters.bad_frames == 0);
+
+        picova_decoder_free(dec);
+    }
+}
+
+static void test_timestamp_wrap(void)
+{
+    static const char text[] =
+        "4294967000,1.0,1.0,1.0\n"
+        "200,1.0,1.0,1.0\n"
+        "100,1.0,1.0,1.0\n";
+
+    picova_decoder_t* dec = picova_decoder_new();
+    struct result r = {0};
+    decode(dec, text, strlen(text), 0, &r);
+
+    CHECK(r.n == 3);
+    CHECK(r.ts[0] == 4294967000ull);
+    CHECK(r.ts[1] == (1ull << 32) + 200);
+    // A small step back, e.g. a reset device, isn't a wrap.
+    CHECK(r.ts[2] == (1ull << 32) + 100);
+    CHECK(r.counters.wraps == 1);
+
+    picova_decoder_free(dec);
+}
+
+static void test_bad_check(void)
+{
+    uint8_t buf[256];
+    size_t len = 0;
+    len += put_cal(buf + len, 1e-4f, 2e-3f, 0);
+    const size_t bad = len;
+    len += put_sample(buf + len, 10, bus_reg(1000), 100, 200, 0);
+    buf[bad + offsetof(struct picova_frame_sample, current)] ^= 0x40;
+    len += put_sample(buf + len, 20, bus_reg(1000), 100, 200, 0);
+
+    picova_decoder_t* dec = picova_decoder_new();
+    struct result r = {0};
+    decode(dec, buf, len, 0, &r);
+
+    CHECK(r.n == 1);
+    CHECK(r.ts[0] == 20);
+    CHECK(r.counters.bad_frames == 1);
+    CHECK(r.counters.frames == 2);
+
+    picova_decoder_free(dec);
+}
+
+static void test_no_cal(void)
+{
+    uint8_t buf[256];
+    size_t len = 0;
+    len += put_sample(buf + len, 10, bus_reg(1000), 100, 200, 1);
+    len += put_cal(buf + len, 1e-4f, 2e-3f, 0);
+    // Epoch 0 is calibrated now, epoch 1 still isn't.
+    len += put_sample(buf + len, 20, bus_reg(1000), 100, 200, 1);
+    len += put_sample(buf + len, 30, bus_reg(1000), 100, 200, 0);
+
+    picova_decoder_t* dec = picova_decoder_new();
+    struct result r = {0};
+    decode(dec, buf, len, 0, &r);
+
+    CHECK(r.n == 1);
+    CHECK(r.ts[0] == 30);
+    CHECK(r.counters.no_cal == 2);
+
+    picova_decoder_free(dec);
+}
+
+// A full output stops decoding right after the sample that filled it, and
+// the rest decodes from `consumed` on.
+static void test_capacity(void)
+{
+    static const char text[] =
+        "1,1.0,1.0,1.0\n"
+        "2,2.0,2.0,2.0\n"
+        "3,3.0,3.0,3.0\n";
+    const size_t len = strlen(text);
+
+    picova_decoder_t* dec = picova_decoder_new();
+    uint64_t ts[2];
+    float V[2], mA[2], mW[2];
+    size_t consumed;
+
+    size_t n = picova_decode(dec, (const uint8_t*)text, len, &consumed, ts, V, mA, mW, NULL, 2);
+    CHECK(n == 2);
+    CHECK(ts[0] == 1 && ts[1] == 2);
+    CHECK(consumed == 2 * strlen("1,1.0,1.0,1.0\n"));
+
+    const size_t rest = len - consumed;
+    n = picova_decode(dec, (const uint8_t*)text + consumed, rest, &consumed, ts, V, mA, mW, NULL, 2);
+    CHECK(n == 1);
+    CHECK(ts[0] == 3 && V[0] == 3.f);
+    CHECK(consumed == rest);
+
+    struct picova_counters counters;
+    picova_get_counters(dec, &counters);
+    CHECK(counters.samples == 3);
+    CHECK(counters.bytes == len);
+
+    picova_decoder_free(dec);
+}
+
+// Kept status lines stop the decoder after them, in their place among the
+// samples, and survive a reset.
+static void test_status(void)
+{
+    static const char text[] =
+        "1000,1.0,1.0,1.0\n"
+        "# i2c errors=1 bus_clears=0 power_cycles=0 max_gap_us=0\r\n"
+        "2000,1.0,1.0,1.0\n";
+    const size_t len = strlen(text);
+    uint64_t ts[4];
+    float V[4], mA[4], mW[4];
+    char line[PICOVA_STATUS_MAX + 1];
+    size_t consumed;
+
+    picova_decoder_t* dec = picova_decoder_new();
+    picova_keep_status(dec, 1);
+    picova_decoder_reset(dec);
+
+    size_t n = picova_decode(dec, (const uint8_t*)text, len, &consumed, ts, V, mA, mW, NULL, 4);
+    CHECK(n == 1 && ts[0] == 1000);
+    CHECK(consumed == (size_t)(strstr(text, "2000") - text));
+    CHECK(picova_read_status(dec, line, sizeof(line)) == 55);
+    CHECK(strcmp(line, "# i2c errors=1 bus_clears=0 power_cycles=0 max_gap_us=0") == 0);
+    CHECK(picova_read_status(dec, line, sizeof(line)) == 0);
+
+    n = picova_decode(dec, (const uint8_t*)text + consumed, len - consumed, &consumed, ts, V, mA, mW, NULL, 4);
+    CHECK(n == 1 && ts[0] == 2000);
+
+    // Cut to fit the caller's buffer.
+    picova_decoder_reset(dec);
+    picova_decode(dec, (const uint8_t*)text, len, &consumed, ts, V, mA, mW, NULL, 4);
+    CHECK(picova_read_status(dec, line, 6) == 5 && strcmp(line, "# i2c") == 0);
+
+    picova_decoder_free(dec);
+}
+
+int main(void)
+{
+    test_csv_lines();
+    test_frames();
+    test_split_chunks();
+    test_timestamp_wrap();
+    test_bad_check();
+    test_no_cal();
+    test_capacity();
+    test_status();
+
+    if (failures)
+        fprintf(stderr, "%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
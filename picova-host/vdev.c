@@ -0,0 +1,393 @@
+// picova-vdev: a virtual PicoVA on a pseudo-terminal.
+//
+// Emits exactly what the firmware's write_task does ("us,V,mA,mW,markers" CSV
+// lines with CRLF line endings, or binary frames, plus marker records) at a
+// configurable rate, so that the host tools can be load-tested without
+// hardware. Data is either synthesised or replayed from a CSV file saved by
+// the UI.
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <math.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include "picova_stream.h"
+
+static const float SHUNT_OHMS = 0.1f;
+static const float CURRENT_LSB = 0.04f / 0.1f / 32768;  // 40 mV range
+static const float POWER_LSB = 20 * 0.04f / 0.1f / 32768;
+
+enum wave
+{
+    WAVE_STEPS = 1 << 0,
+    WAVE_BURSTS = 1 << 1,
+    WAVE_NOISE = 1 << 2,
+};
+
+struct sample
+{
+    float V, mA, mW;
+    uint8_t markers;
+};
+
+struct options
+{
+    double rate;
+    double seconds;
+    uint32_t start_us;
+    unsigned waves;
+    const char* replay;
+    const char* link;
+    bool binary;
+};
+
+static volatile sig_atomic_t running = 1;
+
+static void on_signal(int sig)
+{
+    (void)sig;
+    running = 0;
+}
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+static float gaussian(void)
+{
+    // Box-Muller; good enough for test noise.
+    const float u = (rand() + 1.f) / (RAND_MAX + 2.f);
+    const float v = (rand() + 1.f) / (RAND_MAX + 2.f);
+    return sqrtf(-2 * logf(u)) * cosf(2 * (float)M_PI * v);
+}
+
+// The markers follow the load, as a device under test would signal it:
+// marker 0 is high during bursts and marker 1 during the upper step.
+static struct sample synthesise(unsigned waves, double t)
+{
+    float mA = 10.f;
+    uint8_t markers = 0;
+
+    if ((waves & WAVE_STEPS) && fmod(t, 1.0) >= 0.5) {
+        mA += 40.f;
+        markers |= 1 << 1;
+    }
+
+    if ((waves & WAVE_BURSTS) && fmod(t, 0.1) < 0.002) {
+        mA += 150.f;
+        markers |= 1 << 0;
+    }
+
+    if (waves & WAVE_NOISE)
+        mA += 0.2f * gaussian();
+
+    const float V = 5.f - mA * 1e-3f * SHUNT_OHMS * 5;
+    return (struct sample){ V, mA, V * mA, markers };
+}
+
+// Load the V, mA, mW and (if present) markers columns of a CSV file. Lines
+// that don't parse (such as the header) are skipped.
+static struct sample* load_replay(const char* path, size_t* count)
+{
+    FILE* f = fopen(path, "r");
+    if (!f)
+        return NULL;
+
+    size_t n = 0, cap = 4096;
+    struct sample* samples = malloc(cap * sizeof(*samples));
+    char line[256];
+
+    while (samples && fgets(line, sizeof(line), f)) {
+        unsigned long long us;
+        unsigned markers = 0;
+        struct sample s;
+        if (sscanf(line, "%llu,%f,%f,%f,%u", &us, &s.V, &s.mA, &s.mW, &markers) < 4)
+            continue;
+        s.markers = markers;
+
+        if (n == cap) {
+            cap *= 2;
+            struct sample* grown = realloc(samples, cap * sizeof(*samples));
+            if (!grown) {
+                free(samples);
+                samples = NULL;
+                break;
+            }
+            samples = grown;
+        }
+        samples[n++] = s;
+    }
+
+    fclose(f);
+    *count = n;
+    return samples;
+}
+
+static size_t format_csv(char* buf, uint32_t timestamp, const struct sample* s)
+{
+    return sprintf(buf, "%u,%f,%f,%f,%u\r\n", timestamp, s->V, s->mA, s->mW, s->markers);
+}
+
+static size_t format_csv_markers(char* buf, uint32_t timestamp, uint8_t markers)
+{
+    return sprintf(buf, "@%u,%u\r\n", timestamp, markers);
+}
+
+static size_t format_binary_markers(char* buf, uint32_t timestamp, uint8_t markers)
+{
+    struct picova_frame_markers frame;
+    frame.timestamp = timestamp;
+    frame.markers = markers;
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_MARKERS, 0);
+    memcpy(buf, &frame, sizeof(frame));
+    return sizeof(frame);
+}
+
+static size_t format_binary(char* buf, uint32_t timestamp, const struct sample* s, bool with_cal)
+{
+    size_t len = 0;
+
+    if (with_cal) {
+        struct picova_frame_cal cal;
+        cal.current_lsb = CURRENT_LSB;
+        cal.power_lsb = POWER_LSB;
+        picova_frame_seal(&cal, sizeof(cal), PICOVA_FRAME_CAL, 1);
+        memcpy(buf, &cal, sizeof(cal));
+        len += sizeof(cal);
+    }
+
+    const long bus = lroundf(s->V / 4e-3f);
+    const long current = lroundf(s->mA / 1000 / CURRENT_LSB);
+    const long power = lroundf(s->mW / 1000 / POWER_LSB);
+
+    struct picova_frame_sample frame;
+    frame.timestamp = timestamp;
+    frame.bus = (uint16_t)(bus << 3) | 0x02;
+    frame.current = (uint16_t)(int16_t)(current > INT16_MAX ? INT16_MAX : current < -INT16_MAX ? -INT16_MAX : current);
+    frame.power = (uint16_t)(power > UINT16_MAX ? UINT16_MAX : power < 0 ? 0 : power);
+    picova_frame_seal(&frame, sizeof(frame), PICOVA_FRAME_SAMPLE, 1);
+    memcpy(buf + len, &frame, sizeof(frame));
+    return len + sizeof(frame);
+}
+
+static int open_pty(const char* link)
+{
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if (master < 0 || grantpt(master) < 0 || unlockpt(master) < 0) {
+        perror("posix_openpt");
+        return -1;
+    }
+
+    const char* name = ptsname(master);
+
+    // Keep our own handle on the slave side so that writes don't fail
+    // between clients, and make it raw so the bytes arrive untouched.
+    int slave = open(name, O_RDWR | O_NOCTTY);
+    if (slave < 0) {
+        perror(name);
+        return -1;
+    }
+
+    struct termios tio;
+    tcgetattr(slave, &tio);
+    cfmakeraw(&tio);
+    tcsetattr(slave, TCSANOW, &tio);
+
+    if (link) {
+        unlink(link);
+        if (symlink(name, link) < 0) {
+            perror(link);
+            return -1;
+        }
+        name = link;
+    }
+
+    printf("%s\n", name);
+    fflush(stdout);
+    return master;
+}
+
+static bool write_all(int fd, const char* buf, size_t len, uint64_t* blocked_ns)
+{
+    while (len > 0 && running) {
+        const uint64_t t0 = now_ns();
+        ssize_t n = write(fd, buf, len);
+        *blocked_ns += now_ns() - t0;
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            perror("write");
+            return false;
+        }
+
+        buf += n;
+        len -= n;
+    }
+
+    return true;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr,
+        "Usage: %s [options]\n"
+        "  -r, --rate HZ        samples per second (default 2778, 0 = unpaced)\n"
+        "  -w, --wave LIST      comma-separated steps,bursts,noise (default all)\n"
+        "  -f, --replay FILE    replay V,mA,mW from a CSV file instead, looping\n"
+        "  -b, --binary         emit binary frames instead of CSV text\n"
+        "  -t, --seconds S      stop after S seconds\n"
+        "  -s, --start-us US    initial device timestamp (to exercise wrapping)\n"
+        "  -l, --link PATH      symlink PATH to the pty\n",
+        argv0);
+}
+
+static bool parse_options(int argc, char** argv, struct options* opt)
+{
+    static const struct option longopts[] = {
+        { "rate",     required_argument, NULL, 'r' },
+        { "wave",     required_argument, NULL, 'w' },
+        { "replay",   required_argument, NULL, 'f' },
+        { "binary",   no_argument,       NULL, 'b' },
+        { "seconds",  required_argument, NULL, 't' },
+        { "start-us", required_argument, NULL, 's' },
+        { "link",     required_argument, NULL, 'l' },
+        { NULL, 0, NULL, 0 },
+    };
+
+    *opt = (struct options){
+        .rate = 1e6 / 360,
+        .waves = WAVE_STEPS | WAVE_BURSTS | WAVE_NOISE,
+    };
+
+    int c;
+    while ((c = getopt_long(argc, argv, "r:w:f:bt:s:l:", longopts, NULL)) != -1) {
+        switch (c) {
+        case 'r':   opt->rate = atof(optarg); break;
+        case 'f':   opt->replay = optarg; break;
+        case 'b':   opt->binary = true; break;
+        case 't':   opt->seconds = atof(optarg); break;
+        case 's':   opt->start_us = strtoul(optarg, NULL, 0); break;
+        case 'l':   opt->link = optarg; break;
+        case 'w':
+            opt->waves = 0;
+            for (char* tok = strtok(optarg, ","); tok; tok = strtok(NULL, ",")) {
+                if (!strcmp(tok, "steps"))
+                    opt->waves |= WAVE_STEPS;
+                else if (!strcmp(tok, "bursts"))
+                    opt->waves |= WAVE_BURSTS;
+                else if (!strcmp(tok, "noise"))
+                    opt->waves |= WAVE_NOISE;
+                else
+                    return false;
+            }
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return opt->rate >= 0;
+}
+
+int main(int argc, char** argv)
+{
+    struct options opt;
+    if (!parse_options(argc, argv, &opt)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    struct sample* replay = NULL;
+    size_t replay_len = 0;
+    if (opt.replay) {
+        replay = load_replay(opt.replay, &replay_len);
+        if (!replay || !replay_len) {
+            fprintf(stderr, "%s: no samples\n", opt.replay);
+            return 1;
+        }
+    }
+
+    int fd = open_pty(opt.link);
+    if (fd < 0)
+        return 1;
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    // Device timestamps advance at the nominal sample period regardless of
+    // how fast we actually manage to write, as they would on the device.
+    const double period_us = opt.rate > 0 ? 1e6 / opt.rate : 360;
+    static char buf[1 << 16];
+    const uint64_t start = now_ns();
+    uint64_t next_report = start + 1000000000ull;
+    uint64_t sent = 0, sent_last = 0, bytes = 0, blocked_ns = 0;
+    uint8_t markers = 0;
+
+    while (running) {
+        const uint64_t now = now_ns();
+        const double elapsed = (now - start) * 1e-9;
+        if (opt.seconds > 0 && elapsed >= opt.seconds)
+            break;
+
+        // Everything due by now, in one write.
+        uint64_t due = opt.rate > 0 ? (uint64_t)(elapsed * opt.rate) : sent + 1000;
+        size_t len = 0;
+        while (sent < due && len < sizeof(buf) - 128) {
+            const double t = sent * period_us * 1e-6;
+            const uint32_t timestamp = opt.start_us + (uint32_t)(uint64_t)(sent * period_us);
+            const struct sample s = replay ? replay[sent % replay_len] : synthesise(opt.waves, t);
+
+            // A marker record ahead of the first sample in each new state.
+            if (s.markers != markers) {
+                markers = s.markers;
+                if (opt.binary)
+                    len += format_binary_markers(buf + len, timestamp, markers);
+                else
+                    len += format_csv_markers(buf + len, timestamp, markers);
+            }
+
+            if (opt.binary)
+                len += format_binary(buf + len, timestamp, &s, sent % 1000 == 0);
+            else
+                len += format_csv(buf + len, timestamp, &s);
+            sent++;
+        }
+
+        if (len > 0 && !write_all(fd, buf, len, &blocked_ns))
+            break;
+        bytes += len;
+
+        if (now >= next_report) {
+            fprintf(stderr, "%llu samples/s, %.0f kB/s, blocked %.0f%%\n",
+                (unsigned long long)(sent - sent_last), bytes / 1e3,
+                blocked_ns / 1e7);
+            sent_last = sent;
+            bytes = 0;
+            blocked_ns = 0;
+            next_report += 1000000000ull;
+        }
+
+        if (opt.rate > 0 && sent >= due) {
+            struct timespec ts = { 0, 1000000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+
+    if (opt.link)
+        unlink(opt.link);
+    free(replay);
+    return 0;
+}
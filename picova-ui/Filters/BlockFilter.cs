@@ -0,0 +1,53 @@
+using System;
+using PicovaUI.Models;
+
+namespace PicovaUI.Filters
+{
+    // A causal filter over a stream that is fed in blocks, such as the
+    // batches coming out of the Rx pipeline. State carries over between
+    // calls, so feeding a stream in any block sizes gives the same output.
+    public abstract class BlockFilter
+    {
+        // Input samples per output sample.
+        public virtual int Decimation => 1;
+
+        // Filter `input` into `output`, which must be at least as long as
+        // `input`. Output sample k corresponds to input sample
+        // first + k * Decimation. Returns the number of samples written.
+        public abstract int Process(ReadOnlySpan<float> input, Span<float> output, out int first);
+
+        public abstract void Reset();
+
+        // `width` is the filter's length in samples: the window for the
+        // boxcar and median, the time constant of the low-pass and the
+        // decimation factor of the FIR.
+        public static BlockFilter Create(Filter type, int width) => type switch
+        {
+            Filter.Median => new MedianFilter(width),
+            Filter.Boxcar => new BoxcarFilter(width),
+            Filter.LowPass => new LowPassFilter(width),
+            Filter.Decimate => new DecimatingFirFilter(width),
+            _ => new IdentityFilter(),
+        };
+
+        protected static void EnsureCapacity<T>(ref T[] buffer, int length)
+        {
+            if (buffer.Length < length)
+                Array.Resize(ref buffer, Math.Max(length, buffer.Length * 2));
+        }
+
+        private class IdentityFilter : BlockFilter
+        {
+            public override int Process(ReadOnlySpan<float> input, Span<float> output, out int first)
+            {
+                first = 0;
+                input.CopyTo(output);
+                return input.Length;
+            }
+
+            public override void Reset()
+            {
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+using System;
+using System.Numerics;
+
+namespace PicovaUI.Filters
+{
+    // Moving average over the last `width` samples. Each block is turned
+    // into running sums of the samples entering and leaving the window,
+    // which leaves a vectorised subtract and scale per sample no matter how
+    // wide the window is. Sums are kept in double and restart every block,
+    // so there is no drift.
+    public sealed class BoxcarFilter : BlockFilter
+    {
+        private readonly int width;
+        private readonly float[] history;
+        private int head;
+        private bool primed;
+        private double[] added = Array.Empty<double>();
+        private double[] removed = Array.Empty<double>();
+
+        public BoxcarFilter(int width)
+        {
+            this.width = Math.Max(width, 1);
+            history = new float[this.width];
+        }
+
+        public override int Process(ReadOnlySpan<float> input, Span<float> output, out int first)
+        {
+            first = 0;
+            var n = input.Length;
+            if (n == 0)
+                return 0;
+
+            // Start as if the first sample had been there forever rather
+            // than ramping up from zero.
+            if (!primed)
+            {
+                Array.Fill(history, input[0]);
+                primed = true;
+            }
+
+            double sum = 0;
+            foreach (var x in history)
+                sum += x;
+
+            EnsureCapacity(ref added, n);
+            EnsureCapacity(ref removed, n);
+
+            double a = 0, r = 0;
+            for (int i = 0; i < n; i++)
+            {
+                a += input[i];
+                r += i < width ? history[(head + i) % width] : input[i - width];
+                added[i] = a;
+                removed[i] = r;
+            }
+
+            var vSum = new Vector<double>(sum);
+            var vScale = new Vector<double>(1.0 / width);
+            var lanes = Vector<float>.Count;
+            var half = Vector<double>.Count;
+            int j = 0;
+
+            for (; j <= n - lanes; j += lanes)
+            {
+                var lo = (vSum + new Vector<double>(added, j) - new Vector<double>(removed, j)) * vScale;
+                var hi = (vSum + new Vector<double>(added, j + half) - new Vector<double>(removed, j + half)) * vScale;
+                Vector.Narrow(lo, hi).CopyTo(output[j..]);
+            }
+
+            for (; j < n; j++)
+                output[j] = (float)((sum + added[j] - removed[j]) / width);
+
+            // Keep the last `width` samples, oldest at head.
+            var keep = Math.Min(n, width);
+            for (int i = n - keep; i < n; i++)
+            {
+                history[head] = input[i];
+                head = (head + 1) % width;
+            }
+
+            return n;
+        }
+
+        public override void Reset()
+        {
+            head = 0;
+            primed = false;
+        }
+    }
+}
@@ -0,0 +1,99 @@
+using System;
+using System.Numerics;
+
+namespace PicovaUI.Filters
+{
+    // Windowed-sinc low-pass FIR that only computes every `factor`th output,
+    // for heavy smoothing of fast streams at a fraction of the points. The
+    // cutoff is a little under the new Nyquist frequency to keep aliasing
+    // down, and each output is a vectorised dot product over the taps.
+    public sealed class DecimatingFirFilter : BlockFilter
+    {
+        private const int tapsPerFactor = 8;
+        private const int maxTaps = 4095;
+
+        private readonly int factor;
+        private readonly float[] taps;
+        private float[] buffer = Array.Empty<float>();
+        private int skip;
+        private bool primed;
+
+        public override int Decimation => factor;
+
+        public DecimatingFirFilter(int factor)
+        {
+            this.factor = Math.Max(factor, 2);
+
+            var n = Math.Min(tapsPerFactor * this.factor + 1, maxTaps);
+            var fc = 0.4 / this.factor;
+            var mid = (n - 1) / 2.0;
+            var h = new double[n];
+            double sum = 0;
+
+            for (int m = 0; m < n; m++)
+            {
+                var t = m - mid;
+                var sinc = t == 0 ? 2 * fc : Math.Sin(2 * Math.PI * fc * t) / (Math.PI * t);
+                var window = 0.42 - 0.5 * Math.Cos(2 * Math.PI * m / (n - 1)) + 0.08 * Math.Cos(4 * Math.PI * m / (n - 1));
+                h[m] = sinc * window;
+                sum += h[m];
+            }
+
+            // Reversed, so that an output is a forward dot product over the
+            // most recent samples, and normalised for unity gain at DC.
+            taps = new float[n];
+            for (int m = 0; m < n; m++)
+                taps[n - 1 - m] = (float)(h[m] / sum);
+        }
+
+        public override int Process(ReadOnlySpan<float> input, Span<float> output, out int first)
+        {
+            first = skip;
+            var n = input.Length;
+            var history = taps.Length - 1;
+            if (n == 0)
+                return 0;
+
+            EnsureCapacity(ref buffer, history + n);
+
+            if (!primed)
+            {
+                Array.Fill(buffer, input[0], 0, history);
+                primed = true;
+            }
+
+            input.CopyTo(buffer.AsSpan(history));
+
+            int count = 0;
+            int p = skip;
+            for (; p < n; p += factor)
+                output[count++] = Dot(taps, buffer.AsSpan(p, taps.Length));
+
+            skip = p - n;
+            buffer.AsSpan(n, history).CopyTo(buffer);
+            return count;
+        }
+
+        public override void Reset()
+        {
+            skip = 0;
+            primed = false;
+        }
+
+        private static float Dot(ReadOnlySpan<float> a, ReadOnlySpan<float> b)
+        {
+            var lanes = Vector<float>.Count;
+            var acc = Vector<float>.Zero;
+            int i = 0;
+
+            for (; i <= a.Length - lanes; i += lanes)
+                acc += new Vector<float>(a[i..]) * new Vector<float>(b[i..]);
+
+            var sum = Vector.Dot(acc, Vector<float>.One);
+            for (; i < a.Length; i++)
+                sum += a[i] * b[i];
+
+            return sum;
+        }
+    }
+}
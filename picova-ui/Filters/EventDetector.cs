@@ -0,0 +1,99 @@
+using System;
+using System.Collections.Generic;
+using PicovaUI.Models;
+
+namespace PicovaUI.Filters
+{
+    // Splits a stream into events with a Schmitt trigger on the current: an
+    // event starts when the current reaches `High` and ends when it drops
+    // below `Low`. Charge and energy are integrated with the trapezoidal
+    // rule as samples arrive, so each batch is looked at once and history
+    // never has to be rescanned.
+    public sealed class EventDetector
+    {
+        // An event that spans a gap this long in the data is closed at the
+        // gap rather than integrating across it.
+        private const ulong maxGapUs = 100_000;
+
+        private bool active;
+        private bool haveLast;
+        private ulong start;
+        private ulong lastTime;
+        private float lastCurrent;
+        private float lastPower;
+        private float peak;
+        private double charge;
+        private double energy;
+        private int count;
+
+        public float High { get; set; } = 10f;
+        public float Low { get; set; } = 8f;
+
+        public void Reset()
+        {
+            active = false;
+            haveLast = false;
+            count = 0;
+        }
+
+        // Feed a batch of measurements and append any events that finished
+        // in it to `events`.
+        public void Process(MeasurementBatch batch, List<PowerEvent> events)
+        {
+            var timestamps = batch.Timestamps;
+            var currents = batch.Currents;
+            var powers = batch.Powers;
+
+            for (int i = 0; i < timestamps.Length; i++)
+            {
+                var t = timestamps[i];
+                var current = currents[i];
+                var power = powers[i];
+
+                if (haveLast && t <= lastTime)
+                    continue;
+
+                if (active && t - lastTime > maxGapUs)
+                    Close(lastTime, events);
+
+                if (active)
+                {
+                    var dt = (t - lastTime) / 1000.0;
+                    charge += (lastCurrent + current) * 0.5 * dt;
+                    energy += (lastPower + power) * 0.5 * dt;
+                    peak = Math.Max(peak, current);
+
+                    if (current < Low)
+                        Close(t, events);
+                }
+                else if (current >= High)
+                {
+                    active = true;
+                    start = t;
+                    peak = current;
+                    charge = 0;
+                    energy = 0;
+                }
+
+                haveLast = true;
+                lastTime = t;
+                lastCurrent = current;
+                lastPower = power;
+            }
+        }
+
+        private void Close(ulong end, List<PowerEvent> events)
+        {
+            active = false;
+            events.Add(new PowerEvent
+            {
+                Index = ++count,
+                Start = start,
+                End = end,
+                PeakCurrent = peak,
+                Charge = charge,
+                Energy = energy,
+            });
+        }
+    }
+}
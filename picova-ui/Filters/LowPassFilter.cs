@@ -0,0 +1,83 @@
+using System;
+using System.Numerics;
+
+namespace PicovaUI.Filters
+{
+    // Single-pole IIR low-pass, y[n] = y[n-1] + a * (x[n] - y[n-1]), with a
+    // time constant of `width` samples.
+    //
+    // The recurrence is unrolled over a vector's worth of samples: each lane
+    // k of the output is the decayed previous output plus a weighted sum of
+    // the inputs up to k, which is one multiply-add per input sample with a
+    // precomputed column of weights. Only the last lane is carried from one
+    // vector to the next.
+    public sealed class LowPassFilter : BlockFilter
+    {
+        private readonly float alpha;
+        private readonly Vector<float> decay;
+        private readonly Vector<float>[] weights;
+        private float y;
+        private bool primed;
+
+        public LowPassFilter(int width)
+        {
+            alpha = (float)(1 - Math.Exp(-1.0 / Math.Max(width, 1)));
+
+            var lanes = Vector<float>.Count;
+            var d = new float[lanes];
+            var c = new float[lanes];
+            weights = new Vector<float>[lanes];
+
+            for (int k = 0; k < lanes; k++)
+                d[k] = (float)Math.Pow(1 - alpha, k + 1);
+            decay = new Vector<float>(d);
+
+            for (int j = 0; j < lanes; j++)
+            {
+                for (int k = 0; k < lanes; k++)
+                    c[k] = k >= j ? alpha * (float)Math.Pow(1 - alpha, k - j) : 0f;
+                weights[j] = new Vector<float>(c);
+            }
+        }
+
+        public override int Process(ReadOnlySpan<float> input, Span<float> output, out int first)
+        {
+            first = 0;
+            var n = input.Length;
+            if (n == 0)
+                return 0;
+
+            if (!primed)
+            {
+                y = input[0];
+                primed = true;
+            }
+
+            var lanes = Vector<float>.Count;
+            int i = 0;
+
+            for (; i <= n - lanes; i += lanes)
+            {
+                var acc = decay * y;
+                for (int j = 0; j < lanes; j++)
+                    acc += weights[j] * input[i + j];
+
+                acc.CopyTo(output[i..]);
+                y = acc[lanes - 1];
+            }
+
+            for (; i < n; i++)
+            {
+                y += alpha * (input[i] - y);
+                output[i] = y;
+            }
+
+            return n;
+        }
+
+        public override void Reset()
+        {
+            primed = false;
+        }
+    }
+}
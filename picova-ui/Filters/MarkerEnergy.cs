@@ -0,0 +1,73 @@
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.Linq;
+using PicovaUI.Models;
+
+namespace PicovaUI.Filters
+{
+    // Splits the energy used by the state of the marker inputs, so a firmware
+    // that drives them from its state machine can be profiled per state. Each
+    // interval between two samples is integrated with the trapezoidal rule and
+    // charged to the state latched with the first of them.
+    public sealed class MarkerEnergy
+    {
+        // Intervals across a gap this long in the data are left out.
+        private const ulong maxGapUs = 100_000;
+
+        private readonly double[] energy = new double[256];
+        private readonly double[] time = new double[256];
+        private bool haveLast;
+        private ulong lastTime;
+        private float lastPower;
+        private byte lastMarkers;
+
+        // Whether any marker input has been seen high.
+        public bool Any { get; private set; }
+
+        public void Reset()
+        {
+            Array.Clear(energy);
+            Array.Clear(time);
+            haveLast = false;
+            Any = false;
+        }
+
+        public void Process(MeasurementBatch batch)
+        {
+            var timestamps = batch.Timestamps;
+            var powers = batch.Powers;
+            var markers = batch.Markers;
+
+            for (int i = 0; i < timestamps.Length; i++)
+            {
+                var t = timestamps[i];
+                if (haveLast && t <= lastTime)
+                    continue;
+
+                if (haveLast && t - lastTime <= maxGapUs)
+                {
+                    var dt = (t - lastTime) / 1000.0;
+                    energy[lastMarkers] += (lastPower + powers[i]) * 0.5 * dt;
+                    time[lastMarkers] += dt;
+                }
+
+                haveLast = true;
+                lastTime = t;
+                lastPower = powers[i];
+                lastMarkers = markers[i];
+                Any |= lastMarkers != 0;
+            }
+        }
+
+        // One "state: energy (share), time" entry per state seen, most energy
+        // first, e.g. "0x1: 12.345 mJ (80%) in 1.200 s".
+        public string Summarise()
+        {
+            var total = energy.Sum();
+            var states = Enumerable.Range(0, energy.Length).Where(s => time[s] > 0).OrderByDescending(s => energy[s]);
+            return string.Join(", ", states.Select(s => string.Create(CultureInfo.InvariantCulture,
+                $"0x{s:X}: {energy[s] / 1000:F3} mJ ({(total > 0 ? energy[s] / total : 0):P0}) in {time[s] / 1000:F3} s")));
+        }
+    }
+}
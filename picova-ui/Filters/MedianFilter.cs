@@ -0,0 +1,121 @@
+using System;
+using System.Collections.Generic;
+using System.Numerics;
+
+namespace PicovaUI.Filters
+{
+    // Running median of the last `width` samples. A vector's worth of
+    // consecutive outputs is computed at once by pushing the `width` shifted
+    // copies of the input through a Batcher sorting network with
+    // Vector.Min/Max, then taking the middle one. The network is quadratic
+    // in log(width), so the width is limited.
+    public sealed class MedianFilter : BlockFilter
+    {
+        public const int MaxWidth = 31;
+
+        private readonly int width;
+        private readonly (int, int)[] network;
+        private readonly Vector<float>[] lanes;
+        private readonly float[] scalars;
+        private float[] buffer = Array.Empty<float>();
+        private bool primed;
+
+        public MedianFilter(int width)
+        {
+            // Odd, so that the median is a sample.
+            this.width = Math.Clamp(width | 1, 3, MaxWidth);
+            network = SortingNetwork(this.width);
+            lanes = new Vector<float>[this.width];
+            scalars = new float[this.width];
+        }
+
+        public override int Process(ReadOnlySpan<float> input, Span<float> output, out int first)
+        {
+            first = 0;
+            var n = input.Length;
+            var history = width - 1;
+            if (n == 0)
+                return 0;
+
+            EnsureCapacity(ref buffer, history + n);
+
+            if (!primed)
+            {
+                Array.Fill(buffer, input[0], 0, history);
+                primed = true;
+            }
+
+            input.CopyTo(buffer.AsSpan(history));
+
+            var count = Vector<float>.Count;
+            var mid = width / 2;
+            int i = 0;
+
+            for (; i <= n - count; i += count)
+            {
+                for (int m = 0; m < width; m++)
+                    lanes[m] = new Vector<float>(buffer, i + m);
+
+                foreach (var (a, b) in network)
+                {
+                    var lo = Vector.Min(lanes[a], lanes[b]);
+                    lanes[b] = Vector.Max(lanes[a], lanes[b]);
+                    lanes[a] = lo;
+                }
+
+                lanes[mid].CopyTo(output[i..]);
+            }
+
+            for (; i < n; i++)
+            {
+                Array.Copy(buffer, i, scalars, 0, width);
+
+                foreach (var (a, b) in network)
+                {
+                    var lo = Math.Min(scalars[a], scalars[b]);
+                    scalars[b] = Math.Max(scalars[a], scalars[b]);
+                    scalars[a] = lo;
+                }
+
+                output[i] = scalars[mid];
+            }
+
+            buffer.AsSpan(n, history).CopyTo(buffer);
+            return n;
+        }
+
+        public override void Reset()
+        {
+            primed = false;
+        }
+
+        // Batcher's odd-even merge sort for the next power of two, dropping
+        // comparators that only involve the (notionally +inf) padding.
+        private static (int, int)[] SortingNetwork(int n)
+        {
+            var size = 1;
+            while (size < n)
+                size <<= 1;
+
+            var comparators = new List<(int, int)>();
+            for (int p = 1; p < size; p <<= 1)
+            {
+                for (int k = p; k >= 1; k >>= 1)
+                {
+                    for (int j = k % p; j <= size - 1 - k; j += 2 * k)
+                    {
+                        for (int i = 0; i <= Math.Min(k - 1, size - j - k - 1); i++)
+                        {
+                            var a = i + j;
+                            var b = i + j + k;
+                            if (a / (2 * p) == b / (2 * p) && b < n)
+                                comparators.Add((a, b));
+                        }
+                    }
+                }
+            }
+
+            return comparators.ToArray();
+        }
+    }
+}
@@ -0,0 +1,114 @@
+using System;
+using MathNet.Numerics.IntegralTransforms;
+
+namespace PicovaUI.Filters
+{
+    // Running amplitude spectrum of a uniformly sampled stream: Hann-windowed
+    // FFTs of `length` samples, overlapping by half, with an exponential
+    // average over segments. A segment is transformed each time half a
+    // window of new samples has arrived, so the cost of an update depends on
+    // how much data came in and not on the window length.
+    public sealed class SpectrumEstimator
+    {
+        private readonly int length;
+        private readonly int hop;
+        private readonly double smoothing;
+        private readonly float[] window;
+        private readonly float[] history;
+        private readonly float[] fft;
+        private readonly double[] power;
+        private readonly double[] amplitude;
+        private int head;
+        private int filled;
+        private int pending;
+
+        public int Length => length;
+        public int Bins => length / 2 + 1;
+        public long Segments { get; private set; }
+
+        // Peak amplitude of a sinusoid in each bin, in the units of the
+        // input, from DC to half the sample rate.
+        public ReadOnlySpan<double> Amplitude => amplitude;
+
+        public SpectrumEstimator(int length = 4096, double smoothing = 0.3)
+        {
+            this.length = length;
+            this.smoothing = smoothing;
+            hop = length / 2;
+            window = new float[length];
+            history = new float[length];
+            fft = new float[length + 2];
+            power = new double[Bins];
+            amplitude = new double[Bins];
+
+            for (int i = 0; i < length; i++)
+                window[i] = (float)(0.5 - 0.5 * Math.Cos(2 * Math.PI * i / length));
+        }
+
+        public void Reset()
+        {
+            head = 0;
+            filled = 0;
+            pending = 0;
+            Segments = 0;
+            Array.Clear(power);
+            Array.Clear(amplitude);
+        }
+
+        // Append uniformly spaced samples. Returns true if the spectrum was
+        // updated.
+        public bool Add(ReadOnlySpan<float> samples)
+        {
+            var updated = false;
+
+            foreach (var x in samples)
+            {
+                history[head] = x;
+                head = (head + 1) % length;
+                filled = Math.Min(filled + 1, length);
+
+                if (filled == length && ++pending >= hop)
+                {
+                    Transform();
+                    pending = 0;
+                    updated = true;
+                }
+            }
+
+            if (updated)
+                UpdateAmplitude();
+
+            return updated;
+        }
+
+        private void Transform()
+        {
+            // Oldest sample first.
+            for (int i = 0; i < length; i++)
+                fft[i] = history[(head + i) % length] * window[i];
+
+            Fourier.ForwardReal(fft, length, FourierOptions.Matlab);
+
+            var alpha = Segments == 0 ? 1.0 : smoothing;
+            for (int k = 0; k < Bins; k++)
+            {
+                double re = fft[2 * k], im = fft[2 * k + 1];
+                power[k] += alpha * (re * re + im * im - power[k]);
+            }
+
+            Segments++;
+        }
+
+        private void UpdateAmplitude()
+        {
+            // The Hann window's coherent gain is 1/2, and all but DC and
+            // Nyquist are folded in from the negative frequencies.
+            var scale = 2.0 / length;
+            for (int k = 0; k < Bins; k++)
+            {
+                var folded = k == 0 || k == Bins - 1 ? 1 : 2;
+                amplitude[k] = folded * scale * Math.Sqrt(power[k]);
+            }
+        }
+    }
+}
@@ -0,0 +1,182 @@
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using PicovaUI.Models;
+
+namespace PicovaUI.Filters
+{
+    // A scope-style trigger on one channel of a stream. Each sample is tested
+    // once as its batch arrives, against a Schmitt trigger between `Level`
+    // and `Level` ∓ `Hysteresis`, so noise on a slow edge fires it only once.
+    // When it fires, the samples from `Pre` before to `Post` after are
+    // copied out as a Capture, and it can't fire again until the capture is
+    // done. Pulse triggers fire at the falling edge that ends the pulse, as
+    // on a scope, so `Pre` has to cover the pulse to see all of it.
+    //
+    // The samples are kept in a history that is only ever searched by time,
+    // and trimmed from the front once more than half of it is older than
+    // `Pre`, so the cost per sample stays constant.
+    public sealed class Trigger
+    {
+        // A gap this long in the data resets the Schmitt trigger, so that an
+        // edge isn't made out of samples either side of it.
+        private const ulong maxGapUs = 100_000;
+
+        private readonly SampleBuffer history = new();
+        private bool haveLast;
+        private ulong lastTime;
+        private bool above;
+        private bool pulseKnown;
+        private ulong pulseStart;
+        private bool capturing;
+        private ulong triggerTime;
+        private int captureStart;
+        private int count;
+
+        // Channel in the order voltage, current, power, as in SampleBuffer.
+        public int Channel { get; set; } = 1;
+        public TriggerMode Mode { get; set; }
+        public float Level { get; set; } = 10f;
+        public float Hysteresis { get; set; } = 1f;
+
+        // Pulse width for the pulse modes, and the spans kept either side of
+        // the trigger, in µs.
+        public ulong Width { get; set; } = 1000;
+        public ulong Pre { get; set; } = 10_000;
+        public ulong Post { get; set; } = 40_000;
+
+        // Disarm after each capture rather than waiting for the next one.
+        public bool Single { get; set; }
+        public bool Armed { get; set; } = true;
+
+        public void Reset()
+        {
+            history.Clear();
+            haveLast = false;
+            capturing = false;
+            count = 0;
+        }
+
+        // Start the Schmitt trigger afresh from the next sample, after the
+        // condition has been changed, so that the change isn't taken for an
+        // edge.
+        public void Restart()
+        {
+            haveLast = false;
+        }
+
+        // Feed a batch of measurements and append any captures that finished
+        // in it to `captures`.
+        public void Process(MeasurementBatch batch, List<Capture> captures)
+        {
+            var start = history.Count;
+            history.Append(batch);
+
+            var timestamps = history.Timestamps;
+            var values = history.Channel(Channel);
+            for (int i = start; i < timestamps.Length; i++)
+            {
+                var t = timestamps[i];
+                if (haveLast && t <= lastTime)
+                    continue;
+                if (haveLast && t - lastTime > maxGapUs)
+                    haveLast = false;
+
+                var fired = Step(t, values[i]);
+                haveLast = true;
+                lastTime = t;
+
+                if (capturing && t > triggerTime + Post)
+                    Finish(i, captures);
+
+                if (fired && Armed && !capturing)
+                {
+                    capturing = true;
+                    triggerTime = t;
+                    captureStart = history.IndexOf((double)t - Pre);
+                }
+            }
+
+            var keep = history.IndexOf((double)lastTime - Pre);
+            if (capturing)
+                keep = Math.Min(keep, captureStart);
+            if (keep > history.Count / 2)
+            {
+                history.RemoveFirst(keep);
+                captureStart -= keep;
+            }
+        }
+
+        // Move the Schmitt trigger on by one sample and say whether the
+        // trigger condition is met at it.
+        private bool Step(ulong t, float v)
+        {
+            var falling = Mode is TriggerMode.Falling or TriggerMode.Below;
+            var high = falling ? Level + Hysteresis : Level;
+            var low = falling ? Level : Level - Hysteresis;
+
+            var rose = false;
+            var fell = false;
+            if (!haveLast)
+            {
+                above = v >= high;
+                pulseKnown = false;
+            }
+            else if (!above && v >= high)
+            {
+                above = rose = true;
+                pulseKnown = true;
+                pulseStart = t;
+            }
+            else if (above && v < low)
+            {
+                above = false;
+                fell = true;
+            }
+
+            return Mode switch
+            {
+                TriggerMode.Rising => rose,
+                TriggerMode.Falling => fell,
+                TriggerMode.Above => v >= Level,
+                TriggerMode.Below => v < Level,
+                TriggerMode.WiderThan => fell && pulseKnown && t - pulseStart > Width,
+                TriggerMode.NarrowerThan => fell && pulseKnown && t - pulseStart < Width,
+                _ => false,
+            };
+        }
+
+        // Close the capture with the samples before `end`.
+        private void Finish(int end, List<Capture> captures)
+        {
+            capturing = false;
+            if (Single)
+                Armed = false;
+
+            captures.Add(new Capture
+            {
+                Index = ++count,
+                Time = triggerTime,
+                Condition = Describe(),
+                Samples = history.Slice(captureStart, end - captureStart),
+            });
+        }
+
+        private string Describe()
+        {
+            var channel = Channel switch { 0 => "V", 1 => "I", _ => "P" };
+            var level = Level.ToString("G4", CultureInfo.InvariantCulture);
+            var width = (Width / 1000.0).ToString("G4", CultureInfo.InvariantCulture);
+            return Mode switch
+            {
+                TriggerMode.Rising => $"{channel} rising through {level}",
+                TriggerMode.Falling => $"{channel} falling through {level}",
+                TriggerMode.Above => $"{channel} ≥ {level}",
+                TriggerMode.Below => $"{channel} < {level}",
+                TriggerMode.WiderThan => $"{channel} > {level} for more than {width} ms",
+                TriggerMode.NarrowerThan => $"{channel} > {level} for less than {width} ms",
+                _ => string.Empty,
+            };
+        }
+    }
+}
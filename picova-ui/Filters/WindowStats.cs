@@ -0,0 +1,213 @@
+using System;
+using PicovaUI.Models;
+
+namespace PicovaUI.Filters
+{
+    // Min, max, mean and RMS of each channel, and the charge and energy, over
+    // the samples currently in a SampleBuffer, kept up to date as samples are
+    // appended and trimmed rather than by scanning the window. Min and max
+    // come from monotonic deques, so each sample is pushed and popped at most
+    // once; the rest are running sums.
+    public sealed class WindowStats
+    {
+        // The running sums are recomputed from the window after this many
+        // samples have been subtracted, before rounding can build up.
+        private const long recomputeAfter = 1 << 20;
+
+        private readonly MonotonicDeque[] mins = { new(true), new(true), new(true) };
+        private readonly MonotonicDeque[] maxes = { new(false), new(false), new(false) };
+        private readonly double[] sums = new double[3];
+        private readonly double[] squares = new double[3];
+        private double charge;
+        private double energy;
+        // Absolute index of the first sample in the window.
+        private long first;
+        private long subtracted;
+
+        public int Count { get; private set; }
+
+        // Channel c in the order voltage, current, power, as in SampleBuffer.
+        public float Min(int c) => Count > 0 ? mins[c].Front : float.NaN;
+        public float Max(int c) => Count > 0 ? maxes[c].Front : float.NaN;
+        public double Mean(int c) => sums[c] / Count;
+        public double Rms(int c) => Math.Sqrt(Math.Max(squares[c], 0) / Count);
+
+        // Integrals over the window with the trapezoidal rule, in µC and µJ.
+        public double Charge => charge;
+        public double Energy => energy;
+
+        public void Clear()
+        {
+            foreach (var q in mins)
+                q.Clear();
+            foreach (var q in maxes)
+                q.Clear();
+            Array.Clear(sums);
+            Array.Clear(squares);
+            charge = 0;
+            energy = 0;
+            first = 0;
+            subtracted = 0;
+            Count = 0;
+        }
+
+        // Take in the samples from `start` on, which have just been appended.
+        public void Add(SampleBuffer samples, int start)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                var values = samples.Channel(c);
+                for (int i = start; i < values.Length; i++)
+                {
+                    var v = values[i];
+                    mins[c].Push(first + i, v);
+                    maxes[c].Push(first + i, v);
+                    sums[c] += v;
+                    squares[c] += (double)v * v;
+                }
+            }
+
+            Integrate(samples, Math.Max(start - 1, 0), samples.Count - 1, 1);
+            Count = samples.Count;
+        }
+
+        // Drop the first `n` samples. Call before they are removed from the
+        // buffer.
+        public void Remove(SampleBuffer samples, int n)
+        {
+            if (n >= Count)
+            {
+                first += Count;
+                var next = first;
+                Clear();
+                first = next;
+                return;
+            }
+
+            for (int c = 0; c < 3; c++)
+            {
+                var values = samples.Channel(c);
+                for (int i = 0; i < n; i++)
+                {
+                    sums[c] -= values[i];
+                    squares[c] -= (double)values[i] * values[i];
+                }
+                mins[c].PopBefore(first + n);
+                maxes[c].PopBefore(first + n);
+            }
+
+            Integrate(samples, 0, n, -1);
+            first += n;
+            Count -= n;
+
+            subtracted += n;
+            if (subtracted >= recomputeAfter)
+                Recompute(samples, n);
+        }
+
+        // Add `sign` times the integrals over the intervals between samples
+        // `from` and `to`.
+        private void Integrate(SampleBuffer samples, int from, int to, int sign)
+        {
+            var t = samples.Timestamps;
+            var a = samples.Currents;
+            var w = samples.Powers;
+            for (int i = from; i < to; i++)
+            {
+                var dt = (t[i + 1] - t[i]) / 1000.0;
+                charge += sign * (a[i] + a[i + 1]) * 0.5 * dt;
+                energy += sign * (w[i] + w[i + 1]) * 0.5 * dt;
+            }
+        }
+
+        private void Recompute(SampleBuffer samples, int start)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                var values = samples.Channel(c)[start..];
+                sums[c] = 0;
+                squares[c] = 0;
+                foreach (var v in values)
+                {
+                    sums[c] += v;
+                    squares[c] += (double)v * v;
+                }
+            }
+
+            charge = 0;
+            energy = 0;
+            Integrate(samples, start, samples.Count - 1, 1);
+            subtracted = 0;
+        }
+
+        // Indices and values in the window, oldest first, kept so that each
+        // value is smaller (for a min) than every one after it. The front is
+        // the extreme of the window; anything pushed later and more extreme
+        // makes the entries it beats useless, so they are popped.
+        private sealed class MonotonicDeque
+        {
+            private readonly bool min;
+            private long[] indices = new long[1024];
+            private float[] values = new float[1024];
+            private int head;
+            private int count;
+
+            public MonotonicDeque(bool min)
+            {
+                this.min = min;
+            }
+
+            public float Front => values[head];
+
+            public void Clear()
+            {
+                head = 0;
+                count = 0;
+            }
+
+            public void Push(long index, float value)
+            {
+                var mask = values.Length - 1;
+                while (count > 0)
+                {
+                    var last = values[(head + count - 1) & mask];
+                    if (min ? last < value : last > value)
+                        break;
+                    count--;
+                }
+
+                if (count == values.Length)
+                    Grow();
+
+                mask = values.Length - 1;
+                indices[(head + count) & mask] = index;
+                values[(head + count) & mask] = value;
+                count++;
+            }
+
+            public void PopBefore(long index)
+            {
+                var mask = values.Length - 1;
+                while (count > 0 && indices[head] < index)
+                {
+                    head = (head + 1) & mask;
+                    count--;
+                }
+            }
+
+            private void Grow()
+            {
+                var newIndices = new long[indices.Length * 2];
+                var newValues = new float[values.Length * 2];
+                for (int i = 0; i < count; i++)
+                {
+                    newIndices[i] = indices[(head + i) & (indices.Length - 1)];
+                    newValues[i] = values[(head + i) & (values.Length - 1)];
+                }
+                indices = newIndices;
+                values = newValues;
+                head = 0;
+            }
+        }
+    }
+}
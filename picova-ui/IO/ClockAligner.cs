@@ -0,0 +1,59 @@
+using System;
+
+namespace PicovaUI.IO
+{
+    // Maps one device's timestamps onto HostClock. USB and scheduling only
+    // ever delay a sample, so the smallest (host - device) difference seen is
+    // the best estimate of the offset between the clocks. The estimate may
+    // creep upwards by a bounded drift rate so that a device whose crystal
+    // runs slow relative to the host is still tracked.
+    public class ClockAligner
+    {
+        // Worst-case relative drift between two crystals, with margin.
+        private const double maxDrift = 200e-6;
+
+        private double offset = double.NaN;
+        private double lastHostUs;
+        private ulong lastOut;
+
+        // Record that the sample stamped deviceUs had arrived by hostUs.
+        public void Update(ulong deviceUs, double hostUs)
+        {
+            var o = hostUs - deviceUs;
+
+            if (double.IsNaN(offset))
+                offset = o;
+            else
+                offset = Math.Min(o, offset + (hostUs - lastHostUs) * maxDrift);
+
+            lastHostUs = hostUs;
+        }
+
+        // Host time of a device timestamp. The result never goes backwards,
+        // even when the offset estimate is corrected.
+        public ulong ToHost(ulong deviceUs)
+        {
+            var t = double.IsNaN(offset) ? 0 : deviceUs + offset;
+            var host = t > 0 ? (ulong)t : 0;
+
+            lastOut = Math.Max(lastOut, host);
+            return lastOut;
+        }
+
+        // As ToHost(), but without the ordering guarantee, for timestamps
+        // such as marker changes that interleave with the samples rather than
+        // follow them.
+        public ulong ToHostUnordered(ulong deviceUs)
+        {
+            var t = double.IsNaN(offset) ? 0 : deviceUs + offset;
+            return t > 0 ? (ulong)t : 0;
+        }
+
+        public void Reset()
+        {
+            offset = double.NaN;
+            lastHostUs = 0;
+            lastOut = 0;
+        }
+    }
+}
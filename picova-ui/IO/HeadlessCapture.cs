@@ -0,0 +1,132 @@
+using System;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Threading;
+using PicovaUI.Models;
+
+namespace PicovaUI.IO
+{
+    // Capture from one or more devices straight to a CSV file without the
+    // GUI:
+    //
+    //   PicovaUI --capture PORT[,PORT...] [--out FILE] [--seconds S]
+    //
+    // Samples from all devices are merged in time order on the host time
+    // base, with the device's index in the port list in the second column
+    // and the state of its marker inputs in the last.
+    public static class HeadlessCapture
+    {
+        public static int Run(string[] args)
+        {
+            string[] ports = Array.Empty<string>();
+            string? output = null;
+            double seconds = 0;
+
+            for (int i = 0; i + 1 < args.Length; i += 2)
+            {
+                switch (args[i])
+                {
+                    case "--capture":
+                        ports = args[i + 1].Split(',', StringSplitOptions.RemoveEmptyEntries);
+                        break;
+                    case "--out":
+                        output = args[i + 1];
+                        break;
+                    case "--seconds":
+                        seconds = double.Parse(args[i + 1], CultureInfo.InvariantCulture);
+                        break;
+                    default:
+                        return Usage();
+                }
+            }
+
+            if (ports.Length == 0 || args.Length % 2 != 0)
+                return Usage();
+
+            output ??= Path.Combine(Environment.CurrentDirectory, $"PicoVA-{DateTime.Now:yyyyMMdd-HHmmss}.csv");
+
+            var merger = new MeasurementMerger(ports.Length);
+            var stats = new PipelineStats();
+            var readers = ports.Select((_, i) => new MeasurementReader(i)).ToList();
+            var subscriptions = readers.Select(r => r.Measurements.Subscribe(batch =>
+            {
+                stats.Record(batch);
+                merger.Add(batch);
+            })).ToList();
+            var counts = new long[ports.Length];
+
+            using var stop = new ManualResetEventSlim();
+            Console.CancelKeyPress += (_, e) =>
+            {
+                e.Cancel = true;
+                stop.Set();
+            };
+
+            // A device that goes away ends the capture, keeping what was read.
+            var failed = false;
+            subscriptions.AddRange(readers.Select(r => r.Errors.Subscribe(e =>
+            {
+                Console.Error.WriteLine($"{ports[r.Device]}: {e.Message}");
+                failed = true;
+                stop.Set();
+            })));
+
+            using var file = new StreamWriter(output);
+            file.WriteLine("us,device,V,mA,mW,markers");
+
+            Action<MeasurementBatch, int> write = (batch, i) =>
+            {
+                file.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                    $"{batch.Timestamps[i]},{batch.Device},{batch.Voltages[i]},{batch.Currents[i]},{batch.Powers[i]},{batch.Markers[i]}"));
+                counts[batch.Device]++;
+            };
+
+            try
+            {
+                for (int i = 0; i < ports.Length; i++)
+                    readers[i].Connect(ports[i]);
+
+                var elapsed = Stopwatch.StartNew();
+                var nextReport = TimeSpan.FromSeconds(1);
+
+                while (!stop.Wait(100) && (seconds <= 0 || elapsed.Elapsed.TotalSeconds < seconds))
+                {
+                    merger.Drain(write);
+
+                    if (elapsed.Elapsed >= nextReport)
+                    {
+                        Console.Error.WriteLine(string.Join(", ",
+                            ports.Select((port, i) => $"{port}: {counts[i]} samples/s")) + $"; {stats.Take()}");
+                        Array.Clear(counts);
+                        nextReport += TimeSpan.FromSeconds(1);
+                    }
+                }
+            }
+            catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+            {
+                Console.Error.WriteLine(e.Message);
+                return 1;
+            }
+            finally
+            {
+                foreach (var reader in readers)
+                    reader.Dispose();
+                foreach (var subscription in subscriptions)
+                    subscription.Dispose();
+
+                merger.Drain(write, all: true);
+            }
+
+            Console.Error.WriteLine($"Wrote {output}");
+            return failed ? 1 : 0;
+        }
+
+        private static int Usage()
+        {
+            Console.Error.WriteLine("Usage: PicovaUI --capture PORT[,PORT...] [--out FILE] [--seconds S]");
+            return 2;
+        }
+    }
+}
@@ -0,0 +1,14 @@
+using System.Diagnostics;
+
+namespace PicovaUI.IO
+{
+    // Monotonic host time in microseconds since the application started,
+    // used to put samples from several devices on one time base.
+    public static class HostClock
+    {
+        private static readonly long start = Stopwatch.GetTimestamp();
+        private static readonly double usPerTick = 1e6 / Stopwatch.Frequency;
+
+        public static double NowUs => (Stopwatch.GetTimestamp() - start) * usPerTick;
+    }
+}
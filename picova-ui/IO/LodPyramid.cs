@@ -0,0 +1,266 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Threading;
+using PicovaUI.Models;
+
+namespace PicovaUI.IO
+{
+    // A min/max level-of-detail pyramid over a Recording. Level 0 summarises
+    // every `fanout` samples, level 1 every `fanout` level 0 buckets, and so
+    // on. The pyramid is cached next to the recording and memory-mapped, so a
+    // query only touches the handful of pages covering the visible range at
+    // the resolution being drawn.
+    public class LodPyramid : IDisposable
+    {
+        public const string Extension = ".pvl";
+
+        private const uint magic = 0x324C5650; // "PVL2"
+        private const int fanout = 16;
+        private const int chunkSize = 256 * fanout;
+        private static readonly int bucketSize = Unsafe.SizeOf<MinMaxBucket>();
+
+        private readonly Recording recording;
+        private readonly MemoryMappedFile file;
+        private readonly MemoryMappedViewAccessor view;
+        private readonly long[] levelOffsets;
+        private readonly long[] levelCounts;
+        private readonly RecordedSample[] sampleChunk = new RecordedSample[chunkSize];
+        private readonly MinMaxBucket[] bucketChunk = new MinMaxBucket[chunkSize];
+
+        private LodPyramid(Recording recording, string path)
+        {
+            this.recording = recording;
+
+            using (var reader = new BinaryReader(File.OpenRead(path)))
+            {
+                reader.ReadUInt32();
+                reader.ReadUInt32();
+                var levels = reader.ReadInt32();
+                reader.ReadInt32();
+                reader.ReadInt64();
+
+                levelOffsets = new long[levels];
+                levelCounts = new long[levels];
+                for (int i = 0; i < levels; i++)
+                {
+                    levelOffsets[i] = reader.ReadInt64();
+                    levelCounts[i] = reader.ReadInt64();
+                }
+            }
+
+            file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+            view = file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+        }
+
+        // Building a missing or stale cache reports the fraction of it
+        // written so far and can be cancelled.
+        public static LodPyramid Open(Recording recording, IProgress<double>? progress = null, CancellationToken cancel = default)
+        {
+            var path = Path.ChangeExtension(recording.Path, Extension);
+            if (!IsValidCache(path, recording))
+                Build(recording, path, progress, cancel);
+
+            return new LodPyramid(recording, path);
+        }
+
+        // Summarise the samples between start and end into at most
+        // output.Length buckets of equal duration. Reads from the coarsest
+        // level that still has at least `fanout` items per output bucket, so
+        // the cost depends on the number of pixels rather than samples.
+        public int Query(long start, long end, Span<MinMaxBucket> output)
+        {
+            var pixels = output.Length;
+            if (end <= start || pixels == 0 || recording.Count == 0)
+                return 0;
+
+            // Include one sample either side so lines run off the plot edges.
+            var first = Math.Max(recording.IndexOf(start) - 1, 0);
+            var last = Math.Min(recording.IndexOf(end) + 1, recording.Count);
+
+            var level = -1;
+            var span = 1L;
+            while (level + 1 < levelCounts.Length && (last - first) / span > (long)fanout * pixels)
+            {
+                level++;
+                span *= fanout;
+            }
+
+            var lo = first / span;
+            var hi = (last + span - 1) / span;
+            var count = 0;
+            var pixel = -1;
+            var duration = (double)(end - start);
+
+            for (var i = lo; i < hi; i += chunkSize)
+            {
+                var n = (int)Math.Min(chunkSize, hi - i);
+                if (level < 0)
+                    recording.Read(i, sampleChunk, n);
+                else
+                    view.ReadArray(levelOffsets[level] + i * bucketSize, bucketChunk, 0, n);
+
+                for (int j = 0; j < n; j++)
+                {
+                    var b = level < 0 ? MinMaxBucket.From(sampleChunk[j]) : bucketChunk[j];
+                    var p = (int)Math.Clamp((b.Start - start) * pixels / duration, 0, pixels - 1);
+                    if (p != pixel)
+                    {
+                        pixel = p;
+                        output[count++] = b;
+                    }
+                    else
+                    {
+                        output[count - 1].Add(b);
+                    }
+                }
+            }
+
+            return count;
+        }
+
+        public void Dispose()
+        {
+            view.Dispose();
+            file.Dispose();
+        }
+
+        private static bool IsValidCache(string path, Recording recording)
+        {
+            if (!File.Exists(path) || File.GetLastWriteTimeUtc(path) < File.GetLastWriteTimeUtc(recording.Path))
+                return false;
+
+            using var reader = new BinaryReader(File.OpenRead(path));
+            return reader.BaseStream.Length >= 24
+                && reader.ReadUInt32() == magic
+                && reader.ReadUInt32() == fanout
+                && reader.ReadInt32() >= 0
+                && reader.ReadInt32() == 0
+                && reader.ReadInt64() == recording.Count;
+        }
+
+        private static void Build(Recording recording, string path, IProgress<double>? progress, CancellationToken cancel)
+        {
+            var counts = new List<long>();
+            for (var n = (recording.Count + fanout - 1) / fanout; n > 0; n = (n + fanout - 1) / fanout)
+            {
+                counts.Add(n);
+                if (n == 1)
+                    break;
+            }
+
+            var tmp = path + ".tmp";
+            var offsets = new long[counts.Count];
+
+            // The samples and every level but the last are read once each.
+            var total = recording.Count;
+            for (int i = 0; i + 1 < counts.Count; i++)
+                total += counts[i];
+            long done = 0;
+            var reported = -1;
+            void Advance(long n)
+            {
+                cancel.ThrowIfCancellationRequested();
+                done += n;
+                var percent = (int)(done * 100 / Math.Max(total, 1));
+                if (percent != reported)
+                {
+                    reported = percent;
+                    progress?.Report(percent / 100.0);
+                }
+            }
+
+            try
+            {
+                using var stream = new FileStream(tmp, FileMode.Create, FileAccess.ReadWrite);
+                var writer = new BinaryWriter(stream);
+                writer.Write(magic);
+                writer.Write((uint)fanout);
+                writer.Write(counts.Count);
+                writer.Write(0);
+                writer.Write(recording.Count);
+
+                var offset = 24L + 16L * counts.Count;
+                for (int i = 0; i < counts.Count; i++)
+                {
+                    offsets[i] = offset;
+                    writer.Write(offset);
+                    writer.Write(counts[i]);
+                    offset += counts[i] * bucketSize;
+                }
+                writer.Flush();
+
+                var samples = new RecordedSample[chunkSize];
+                var input = new MinMaxBucket[chunkSize];
+                var output = new MinMaxBucket[chunkSize / fanout];
+
+                // Level 0 from the raw samples.
+                for (long i = 0; i < recording.Count; i += chunkSize)
+                {
+                    var n = (int)Math.Min(chunkSize, recording.Count - i);
+                    recording.Read(i, samples, n);
+
+                    var m = 0;
+                    for (int j = 0; j < n; j += fanout)
+                    {
+                        var b = MinMaxBucket.From(samples[j]);
+                        for (int k = j + 1; k < Math.Min(j + fanout, n); k++)
+                            b.Add(samples[k]);
+                        output[m++] = b;
+                    }
+                    stream.Write(MemoryMarshal.AsBytes(output.AsSpan(0, m)));
+                    Advance(n);
+                }
+
+                // Each further level from the one before it, already on disk.
+                for (int level = 1; level < counts.Count; level++)
+                {
+                    var readPos = offsets[level - 1];
+                    var writePos = offsets[level];
+                    for (long i = 0; i < counts[level - 1]; i += chunkSize)
+                    {
+                        var n = (int)Math.Min(chunkSize, counts[level - 1] - i);
+                        stream.Seek(readPos, SeekOrigin.Begin);
+                        ReadFully(stream, MemoryMarshal.AsBytes(input.AsSpan(0, n)));
+                        readPos = stream.Position;
+
+                        var m = 0;
+                        for (int j = 0; j < n; j += fanout)
+                        {
+                            var b = input[j];
+                            for (int k = j + 1; k < Math.Min(j + fanout, n); k++)
+                                b.Add(input[k]);
+                            output[m++] = b;
+                        }
+
+                        stream.Seek(writePos, SeekOrigin.Begin);
+                        stream.Write(MemoryMarshal.AsBytes(output.AsSpan(0, m)));
+                        writePos = stream.Position;
+                        Advance(n);
+                    }
+                }
+            }
+            catch
+            {
+                File.Delete(tmp);
+                throw;
+            }
+
+            File.Move(tmp, path, true);
+        }
+
+        private static void ReadFully(Stream stream, Span<byte> buffer)
+        {
+            while (buffer.Length > 0)
+            {
+                var n = stream.Read(buffer);
+                if (n == 0)
+                    throw new EndOfStreamException();
+                buffer = buffer[n..];
+            }
+        }
+    }
+}
@@ -0,0 +1,102 @@
+using System;
+using System.Collections.Generic;
+using PicovaUI.Models;
+
+namespace PicovaUI.IO
+{
+    // Merges the aligned streams of several readers into one in timestamp
+    // order. Samples are only released once every active device has reported
+    // past them, so a device whose data arrives a little later still slots
+    // into place; a device that has gone quiet for a second stops holding
+    // the others back.
+    public class MeasurementMerger
+    {
+        private const double staleUs = 1e6;
+
+        private readonly Queue<MeasurementBatch>[] queues;
+        private readonly int[] heads;
+        private readonly ulong[] latest;
+        private readonly double[] seenAt;
+
+        public MeasurementMerger(int devices)
+        {
+            queues = new Queue<MeasurementBatch>[devices];
+            heads = new int[devices];
+            latest = new ulong[devices];
+            seenAt = new double[devices];
+
+            for (int d = 0; d < devices; d++)
+            {
+                queues[d] = new();
+                seenAt[d] = double.NegativeInfinity;
+            }
+        }
+
+        // Queue a batch. The merger takes ownership and disposes it once
+        // every sample has been drained.
+        public void Add(MeasurementBatch batch)
+        {
+            if (batch.Count == 0)
+            {
+                batch.Dispose();
+                return;
+            }
+
+            lock (queues)
+            {
+                queues[batch.Device].Enqueue(batch);
+                latest[batch.Device] = batch.Timestamps[^1];
+                seenAt[batch.Device] = HostClock.NowUs;
+            }
+        }
+
+        // Pass the samples that are safe to write to `write`, in order, as a
+        // batch and an index into it. With all set, everything queued goes.
+        public void Drain(Action<MeasurementBatch, int> write, bool all = false)
+        {
+            lock (queues)
+            {
+                var watermark = ulong.MaxValue;
+                if (!all)
+                {
+                    var now = HostClock.NowUs;
+                    for (int d = 0; d < queues.Length; d++)
+                    {
+                        if (now - seenAt[d] < staleUs)
+                            watermark = Math.Min(watermark, latest[d]);
+                    }
+                }
+
+                while (true)
+                {
+                    var next = -1;
+                    var nextTime = ulong.MaxValue;
+                    for (int d = 0; d < queues.Length; d++)
+                    {
+                        if (queues[d].Count == 0)
+                            continue;
+
+                        var t = queues[d].Peek().Timestamps[heads[d]];
+                        if (t <= watermark && (next < 0 || t < nextTime))
+                        {
+                            next = d;
+                            nextTime = t;
+                        }
+                    }
+
+                    if (next < 0)
+                        break;
+
+                    var batch = queues[next].Peek();
+                    write(batch, heads[next]);
+
+                    if (++heads[next] == batch.Count)
+                    {
+                        queues[next].Dequeue().Dispose();
+                        heads[next] = 0;
+                    }
+                }
+            }
+        }
+    }
+}
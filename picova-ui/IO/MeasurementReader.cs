@@ -1,88 +1,175 @@
 using System;
+using System.IO;
 using System.IO.Ports;
+using System.Net.Sockets;
 using System.Reactive.Subjects;
-using System.Text;
+using System.Threading;
 using PicovaUI.Models;
 using ReactiveUI;
 
 namespace PicovaUI.IO
 {
+    // Reads one PicoVA on its own thread, from a serial port or from a
+    // picova-server given as "socket://HOST:PORT". Each chunk is stamped with the host
+    // time it arrived, and sample timestamps are mapped onto HostClock so that
+    // several readers share a time base. Samples are published as pooled
+    // batches, one per decoded chunk; the subscriber owns each batch and must
+    // dispose it when done. If the connection fails or is closed by the other
+    // end, the reader closes it and publishes why on Errors.
     public class MeasurementReader : ReactiveObject, IDisposable
     {
-        private static readonly string newline = "\r\n";
-
         private readonly SerialPort serial = new();
-        private readonly StringBuilder buff = new();
-        private readonly Subject<Measurement> measurements = new();
+        private TcpClient? tcp;
+        private Stream? stream;
+        private readonly PicovaDecoder decoder = new();
+        private readonly ClockAligner clock = new();
+        private readonly Subject<MeasurementBatch> measurements = new();
+        private readonly Subject<Exception> errors = new();
+        private readonly byte[] rxBuff = new byte[16384];
+        private Thread? thread;
+        private volatile bool running;
+
+        public int Device { get; }
+        public bool Connected => stream != null;
+        public IObservable<MeasurementBatch> Measurements => measurements;
+        public IObservable<Exception> Errors => errors;
+        public PicovaDecoder.Counters Counters => decoder.GetCounters();
 
-        public bool Connected => serial.IsOpen;
-        public IObservable<Measurement> Measurements => measurements;
+        public MeasurementReader(int device = 0)
+        {
+            Device = device;
+        }
 
         public void Connect(string port)
         {
-            serial.PortName = port;
-            serial.DtrEnable = true;
-            serial.RtsEnable = true;
-            serial.Open();
-            serial.DataReceived += OnDataReceived;
+            // The read timeout bounds how long Disconnect() waits for the
+            // reader thread.
+            if (port.StartsWith("socket://", StringComparison.OrdinalIgnoreCase))
+            {
+                var uri = new Uri(port);
+                tcp = new TcpClient(uri.Host, uri.Port) { ReceiveTimeout = 100 };
+                stream = tcp.GetStream();
+            }
+            else
+            {
+                serial.PortName = port;
+                serial.DtrEnable = true;
+                serial.RtsEnable = true;
+                serial.ReadTimeout = 100;
+                serial.Open();
+                stream = serial.BaseStream;
+            }
+            decoder.Reset();
+            clock.Reset();
+
+            running = true;
+            thread = new Thread(ReadLoop)
+            {
+                IsBackground = true,
+                Name = $"PicoVA reader {port}",
+            };
+            thread.Start();
             this.RaisePropertyChanged(nameof(Connected));
         }
 
         public void Disconnect()
         {
-            serial.DataReceived -= OnDataReceived;
+            running = false;
+            thread?.Join();
+            thread = null;
+            stream = null;
             serial.Close();
+            tcp?.Close();
+            tcp = null;
             this.RaisePropertyChanged(nameof(Connected));
         }
 
         public void Dispose()
         {
+            if (thread != null)
+                Disconnect();
             ((IDisposable)serial).Dispose();
+            decoder.Dispose();
         }
 
-        private void OnDataReceived(object sender, SerialDataReceivedEventArgs e)
+        // Close the connection from the reader thread once it can't be read
+        // any more. Disconnect() only has the thread to join after this.
+        private void Fail(Exception error)
         {
-            if (e.EventType != SerialData.Chars)
-                return;
+            running = false;
+            stream = null;
+            serial.Close();
+            tcp?.Close();
+            this.RaisePropertyChanged(nameof(Connected));
+            errors.OnNext(error);
+        }
 
-            try
-            {
-                buff.Append(serial.ReadExisting());
-            }
-            catch
-            {
-                return;
-            }
+        private void ReadLoop()
+        {
+            var stream = this.stream!;
 
-            var str = buff.ToString();
-            var end = str.IndexOf(newline);
-            while (end >= 0)
+            while (running)
             {
-                var line = str[..end];
+                int len;
+                try
+                {
+                    len = stream.Read(rxBuff, 0, rxBuff.Length);
+                }
+                catch (TimeoutException)
+                {
+                    continue;
+                }
+                catch (IOException e) when (e.InnerException is SocketException { SocketErrorCode: SocketError.TimedOut })
+                {
+                    continue;
+                }
+                catch (Exception e)
+                {
+                    Fail(e);
+                    return;
+                }
 
-                var meas = Parse(line);
-                if (meas != null)
-                    measurements.OnNext(meas);
+                if (len == 0)
+                {
+                    Fail(new EndOfStreamException("The connection was closed by the other end."));
+                    return;
+                }
 
-                buff.Remove(0, end + newline.Length);
-                str = buff.ToString();
-                end = str.IndexOf(newline);
-            }
-        }
+                var hostUs = HostClock.NowUs;
 
-        private Measurement? Parse(string data)
-        {
-            var fields = data.Split(',');
-            if (fields.Length != 4)
-                return null;
+                ReadOnlySpan<byte> data = rxBuff.AsSpan(0, len);
+                while (!data.IsEmpty)
+                {
+                    var batch = MeasurementBatch.Rent(Device, hostUs);
+                    batch.Count = MeasurementBatch.Capacity;
 
-            return new Measurement
-            {
-                Timestamp = uint.Parse(fields[0]),
-                Voltage = float.Parse(fields[1]),
-                Current = float.Parse(fields[2]),
-                Power = float.Parse(fields[3]),
-            };
+                    var n = decoder.Decode(data, out var consumed,
+                        batch.Timestamps, batch.Voltages, batch.Currents, batch.Powers, batch.Markers);
+                    data = data[consumed..];
+                    batch.Count = n;
+
+                    batch.MarkerCount = MeasurementBatch.MarkerCapacity;
+                    batch.MarkerCount = decoder.ReadMarkers(batch.MarkerTimestamps, batch.MarkerStates);
+
+                    if (n == 0 && batch.MarkerCount == 0)
+                    {
+                        batch.Dispose();
+                        continue;
+                    }
+
+                    var timestamps = batch.Timestamps;
+                    if (n > 0)
+                        clock.Update(timestamps[n - 1], hostUs);
+                    for (int i = 0; i < n; i++)
+                        timestamps[i] = clock.ToHost(timestamps[i]);
+
+                    var markerTimestamps = batch.MarkerTimestamps;
+                    for (int i = 0; i < markerTimestamps.Length; i++)
+                        markerTimestamps[i] = clock.ToHostUnordered(markerTimestamps[i]);
+
+                    measurements.OnNext(batch);
+                }
+            }
         }
     }
 }
@@ -0,0 +1,113 @@
+using System;
+using System.Runtime.InteropServices;
+
+namespace PicovaUI.IO
+{
+    // P/Invoke bindings for libpicova, the stream decoder shared with the
+    // Python tools. See picova-host/picova.h for the semantics.
+    public sealed class PicovaDecoder : IDisposable
+    {
+        private const string lib = "picova";
+
+        [StructLayout(LayoutKind.Sequential)]
+        public struct Counters
+        {
+            public ulong Bytes;
+            public ulong Samples;
+            public ulong Lines;
+            public ulong Frames;
+            public ulong BadLines;
+            public ulong BadFrames;
+            public ulong NoCal;
+            public ulong Wraps;
+            public ulong HeldBus;
+            public ulong StatusLines;
+            public ulong Markers;
+            public ulong LostMarkers;
+        }
+
+        [DllImport(lib)] private static extern IntPtr picova_decoder_new();
+        [DllImport(lib)] private static extern void picova_decoder_free(IntPtr dec);
+        [DllImport(lib)] private static extern void picova_decoder_reset(IntPtr dec);
+        [DllImport(lib)] private static extern void picova_get_counters(IntPtr dec, out Counters counters);
+        [DllImport(lib)]
+        private static extern nuint picova_decode(IntPtr dec,
+            ref byte data, nuint len, out nuint consumed,
+            ref ulong timestampUs, ref float busV, ref float currentMA, ref float powerMW,
+            ref byte markers, nuint capacity);
+        [DllImport(lib)]
+        private static extern nuint picova_read_markers(IntPtr dec,
+            ref ulong timestampUs, ref byte markers, nuint capacity);
+
+        private IntPtr dec;
+
+        public PicovaDecoder()
+        {
+            dec = picova_decoder_new();
+            if (dec == IntPtr.Zero)
+                throw new OutOfMemoryException();
+        }
+
+        public Counters GetCounters()
+        {
+            picova_get_counters(dec, out var counters);
+            return counters;
+        }
+
+        public void Reset() => picova_decoder_reset(dec);
+
+        // Decode as much of `data` as fits into the output spans, which must
+        // all be the same length. Returns the number of samples written and
+        // the number of bytes consumed.
+        public int Decode(ReadOnlySpan<byte> data, out int consumed,
+            Span<ulong> timestampUs, Span<float> busV, Span<float> currentMA, Span<float> powerMW,
+            Span<byte> markers)
+        {
+            var capacity = timestampUs.Length;
+            if (busV.Length < capacity || currentMA.Length < capacity || powerMW.Length < capacity
+                    || markers.Length < capacity)
+                throw new ArgumentException("Output spans must be the same length");
+
+            if (data.IsEmpty || capacity == 0)
+            {
+                consumed = 0;
+                return 0;
+            }
+
+            var n = picova_decode(dec,
+                ref MemoryMarshal.GetReference(data), (nuint)data.Length, out var used,
+                ref MemoryMarshal.GetReference(timestampUs),
+                ref MemoryMarshal.GetReference(busV),
+                ref MemoryMarshal.GetReference(currentMA),
+                ref MemoryMarshal.GetReference(powerMW),
+                ref MemoryMarshal.GetReference(markers),
+                (nuint)capacity);
+
+            consumed = (int)used;
+            return (int)n;
+        }
+
+        // Move the marker changes decoded so far into the output spans, as
+        // many as fit. Returns the number written.
+        public int ReadMarkers(Span<ulong> timestampUs, Span<byte> markers)
+        {
+            var capacity = Math.Min(timestampUs.Length, markers.Length);
+            if (capacity == 0)
+                return 0;
+
+            return (int)picova_read_markers(dec,
+                ref MemoryMarshal.GetReference(timestampUs),
+                ref MemoryMarshal.GetReference(markers),
+                (nuint)capacity);
+        }
+
+        public void Dispose()
+        {
+            if (dec != IntPtr.Zero)
+            {
+                picova_decoder_free(dec);
+                dec = IntPtr.Zero;
+            }
+        }
+    }
+}
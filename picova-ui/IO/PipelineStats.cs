@@ -0,0 +1,61 @@
+using PicovaUI.Models;
+
+namespace PicovaUI.IO
+{
+    // Throughput and latency of the live pipeline, recorded as batches leave
+    // it. Latency runs from the serial read that produced a batch to the
+    // point where every stage has seen it.
+    public class PipelineStats
+    {
+        private readonly object sync = new();
+        private long samples;
+        private long batches;
+        private double latencySum;
+        private double latencyMax;
+        private double since = HostClock.NowUs;
+
+        public void Record(MeasurementBatch batch)
+        {
+            var latency = HostClock.NowUs - batch.ReceivedUs;
+
+            lock (sync)
+            {
+                samples += batch.Count;
+                batches++;
+                latencySum += latency;
+                if (latency > latencyMax)
+                    latencyMax = latency;
+            }
+        }
+
+        // Rates and latencies since the previous call.
+        public Snapshot Take()
+        {
+            lock (sync)
+            {
+                var now = HostClock.NowUs;
+                var seconds = (now - since) / 1e6;
+                var snapshot = new Snapshot(
+                    seconds > 0 ? samples / seconds : 0,
+                    seconds > 0 ? batches / seconds : 0,
+                    batches > 0 ? latencySum / batches / 1000 : 0,
+                    latencyMax / 1000);
+
+                samples = 0;
+                batches = 0;
+                latencySum = 0;
+                latencyMax = 0;
+                since = now;
+                return snapshot;
+            }
+        }
+
+        public readonly record struct Snapshot(double SamplesPerSecond, double BatchesPerSecond,
+            double MeanLatencyMs, double MaxLatencyMs)
+        {
+            public override string ToString() =>
+                $"{SamplesPerSecond / 1000:F1} kS/s in {BatchesPerSecond:F0} batches/s, " +
+                $"latency {MeanLatencyMs:F1} ms (max {MaxLatencyMs:F1} ms)";
+        }
+    }
+}
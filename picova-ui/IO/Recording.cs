@@ -0,0 +1,182 @@
+using System;
+using System.Globalization;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+using System.Threading;
+using PicovaUI.Models;
+
+namespace PicovaUI.IO
+{
+    // A recording on disk, memory-mapped so that only the pages actually
+    // touched by a view are read. The file is a small header followed by a
+    // flat array of RecordedSample. CSV files saved by the UI are imported
+    // into a sibling .pvr file the first time they are opened, and again if
+    // that file is from before the samples carried marker state. Importing
+    // reports the fraction of the CSV read so far and can be cancelled.
+    public class Recording : IDisposable
+    {
+        public const string Extension = ".pvr";
+
+        private const uint magic = 0x32525650; // "PVR2"
+        private const long headerSize = 16;
+        private static readonly int sampleSize = Unsafe.SizeOf<RecordedSample>();
+
+        private readonly MemoryMappedFile file;
+        private readonly MemoryMappedViewAccessor view;
+
+        public string Path { get; }
+        public long Count { get; }
+        public long StartTime { get; }
+        public long EndTime { get; }
+
+        private Recording(string path)
+        {
+            Path = path;
+
+            using (var reader = new BinaryReader(File.OpenRead(path)))
+            {
+                if (reader.BaseStream.Length < headerSize || reader.ReadUInt32() != magic)
+                    throw new InvalidDataException($"{path} is not a PicoVA recording");
+                reader.ReadUInt32();
+                Count = reader.ReadInt64();
+            }
+
+            file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+            view = file.CreateViewAccessor(0, 0, MemoryMappedFileAccess.Read);
+
+            if (Count > 0)
+            {
+                StartTime = this[0].Timestamp;
+                EndTime = this[Count - 1].Timestamp;
+            }
+        }
+
+        public static Recording Open(string path, IProgress<double>? progress = null, CancellationToken cancel = default)
+        {
+            if (!string.Equals(System.IO.Path.GetExtension(path), Extension, StringComparison.OrdinalIgnoreCase))
+            {
+                var converted = System.IO.Path.ChangeExtension(path, Extension);
+                if (!File.Exists(converted)
+                    || File.GetLastWriteTimeUtc(converted) < File.GetLastWriteTimeUtc(path)
+                    || !IsCurrent(converted))
+                    ImportCsv(path, converted, progress, cancel);
+                path = converted;
+            }
+
+            return new Recording(path);
+        }
+
+        private static bool IsCurrent(string path)
+        {
+            using var reader = new BinaryReader(File.OpenRead(path));
+            return reader.BaseStream.Length >= headerSize && reader.ReadUInt32() == magic;
+        }
+
+        public RecordedSample this[long index]
+        {
+            get
+            {
+                view.Read(headerSize + index * sampleSize, out RecordedSample s);
+                return s;
+            }
+        }
+
+        public void Read(long index, RecordedSample[] buffer, int count)
+        {
+            view.ReadArray(headerSize + index * sampleSize, buffer, 0, count);
+        }
+
+        // Index of the first sample with a timestamp >= time.
+        public long IndexOf(long time)
+        {
+            long lo = 0, hi = Count;
+            while (lo < hi)
+            {
+                var mid = lo + (hi - lo) / 2;
+                if (this[mid].Timestamp < time)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        public void Dispose()
+        {
+            view.Dispose();
+            file.Dispose();
+        }
+
+        // Convert a CSV file in the format written by "Save data" into a
+        // recording. Files saved before the markers column read as all
+        // markers low.
+        private static void ImportCsv(string src, string dst, IProgress<double>? progress, CancellationToken cancel)
+        {
+            var tmp = dst + ".tmp";
+            long count = 0;
+
+            try
+            {
+                using var reader = new StreamReader(src);
+                using var writer = new BinaryWriter(File.Create(tmp));
+
+                writer.Write(magic);
+                writer.Write(0u);
+                writer.Write(0L);
+
+                var length = Math.Max(reader.BaseStream.Length, 1);
+                var reported = -1;
+                long offset = 0;
+                ulong last = 0;
+                string? line;
+                while ((line = reader.ReadLine()) != null)
+                {
+                    var fields = line.Split(',');
+                    if (fields.Length < 4 || !ulong.TryParse(fields[0], out var timestamp))
+                        continue;
+
+                    // Files saved before timestamps were unwrapped wrap every
+                    // 2^32 us.
+                    if (count > 0 && timestamp < last)
+                        offset += 1L << 32;
+                    last = timestamp;
+
+                    var sample = new RecordedSample
+                    {
+                        Timestamp = offset + (long)timestamp,
+                        Voltage = float.Parse(fields[1], CultureInfo.InvariantCulture),
+                        Current = float.Parse(fields[2], CultureInfo.InvariantCulture),
+                        Power = float.Parse(fields[3], CultureInfo.InvariantCulture),
+                        Markers = fields.Length > 4 && byte.TryParse(fields[4], out var markers) ? markers : (byte)0,
+                    };
+                    writer.Write(MemoryMarshal.AsBytes(MemoryMarshal.CreateReadOnlySpan(ref sample, 1)));
+                    count++;
+
+                    // Only in whole percent, so as not to flood the UI.
+                    if (count % 4096 == 0)
+                    {
+                        cancel.ThrowIfCancellationRequested();
+                        var percent = (int)(reader.BaseStream.Position * 100 / length);
+                        if (percent != reported)
+                        {
+                            reported = percent;
+                            progress?.Report(percent / 100.0);
+                        }
+                    }
+                }
+
+                writer.Seek(8, SeekOrigin.Begin);
+                writer.Write(count);
+            }
+            catch
+            {
+                File.Delete(tmp);
+                throw;
+            }
+
+            File.Move(tmp, dst, true);
+        }
+    }
+}
@@ -0,0 +1,15 @@
+namespace PicovaUI.Models
+{
+    // The samples around one firing of the trigger, copied out of the
+    // stream so that they stay as they were. See Trigger.
+    public record Capture
+    {
+        public int Index { get; init; }
+        public ulong Time { get; init; }
+        public string Condition { get; init; } = string.Empty;
+        public SampleBuffer Samples { get; init; } = new();
+
+        public double TimeSeconds => Time / 1e6;
+        public double Duration => Samples.Count > 1 ? (Samples.Timestamps[^1] - Samples.Timestamps[0]) / 1000.0 : 0;  // ms
+    }
+}
@@ -0,0 +1,219 @@
+using System;
+using System.Numerics;
+
+namespace PicovaUI.Models
+{
+    // Up to Capacity consecutive samples packed as in time-series databases
+    // such as Gorilla: timestamps as the change in the interval between
+    // samples, which is usually zero or small, and each float as the XOR with
+    // the previous value of its channel, which leaves only the few bits that
+    // changed. Unchanged markers take one bit. Samples are encoded as they
+    // are added, so an open block costs no more than a sealed one.
+    public sealed class CompressedBlock
+    {
+        public const int Capacity = 1024;
+
+        private ulong[] words = new ulong[64];
+        private long bits;
+
+        // Encoder state: the last timestamp and interval, and for each float
+        // channel its last value and the window of meaningful bits used last.
+        private ulong lastTime;
+        private long lastDelta;
+        private readonly uint[] lastValues = new uint[3];
+        private readonly int[] leading = new int[3];
+        private readonly int[] trailing = new int[3];
+        private byte lastMarkers;
+
+        public ulong Start { get; }
+        public ulong End { get; private set; }
+        public int Count { get; private set; }
+        public bool Full => Count == Capacity;
+
+        // Approximate memory used, for the history budget.
+        public long Bytes => words.Length * sizeof(ulong) + 96;
+
+        public CompressedBlock(ulong start)
+        {
+            Start = start;
+            End = start;
+            lastTime = start;
+            Array.Fill(leading, -1);
+        }
+
+        public void Add(ulong timestamp, float voltage, float current, float power, byte markers)
+        {
+            var delta = (long)(timestamp - lastTime);
+            var dod = delta - lastDelta;
+            if (dod == 0)
+                Write(0, 1);
+            else if (dod >= -64 && dod < 64)
+                Write(0b10UL << 7 | ((ulong)dod & 0x7F), 9);
+            else if (dod >= -256 && dod < 256)
+                Write(0b110UL << 9 | ((ulong)dod & 0x1FF), 12);
+            else if (dod >= -2048 && dod < 2048)
+                Write(0b1110UL << 12 | ((ulong)dod & 0xFFF), 16);
+            else
+            {
+                Write(0b1111, 4);
+                Write((ulong)dod, 64);
+            }
+            lastTime = timestamp;
+            lastDelta = delta;
+
+            AddValue(0, voltage);
+            AddValue(1, current);
+            AddValue(2, power);
+
+            if (markers == lastMarkers)
+                Write(0, 1);
+            else
+                Write(0x100UL | markers, 9);
+            lastMarkers = markers;
+
+            End = timestamp;
+            Count++;
+        }
+
+        // Drop the spare capacity once no more samples will be added.
+        public void Seal()
+        {
+            Array.Resize(ref words, (int)((bits + 63) / 64));
+        }
+
+        // Append the samples to `into`.
+        public void Decode(SampleBuffer into)
+        {
+            var reader = new Reader(words);
+            var time = Start;
+            long delta = 0;
+            Span<uint> values = stackalloc uint[3];
+            Span<int> lead = stackalloc int[3];
+            Span<int> length = stackalloc int[3];
+            byte markers = 0;
+
+            for (int i = 0; i < Count; i++)
+            {
+                long dod;
+                if (reader.Read(1) == 0)
+                    dod = 0;
+                else if (reader.Read(1) == 0)
+                    dod = reader.ReadSigned(7);
+                else if (reader.Read(1) == 0)
+                    dod = reader.ReadSigned(9);
+                else if (reader.Read(1) == 0)
+                    dod = reader.ReadSigned(12);
+                else
+                    dod = (long)reader.Read(64);
+                delta += dod;
+                time += (ulong)delta;
+
+                for (int c = 0; c < 3; c++)
+                {
+                    if (reader.Read(1) == 0)
+                        continue;
+                    if (reader.Read(1) != 0)
+                    {
+                        lead[c] = (int)reader.Read(5);
+                        length[c] = (int)reader.Read(5) + 1;
+                    }
+                    var trail = 32 - lead[c] - length[c];
+                    values[c] ^= (uint)reader.Read(length[c]) << trail;
+                }
+
+                if (reader.Read(1) != 0)
+                    markers = (byte)reader.Read(8);
+
+                into.Append(time, BitConverter.Int32BitsToSingle((int)values[0]),
+                            BitConverter.Int32BitsToSingle((int)values[1]),
+                            BitConverter.Int32BitsToSingle((int)values[2]), markers);
+            }
+        }
+
+        // '0' if the value is unchanged. Otherwise '10' and the XOR's bits
+        // within last time's window if they fit, or '11', a new window (5
+        // bits of leading zeros, 5 of length - 1) and the bits within it.
+        private void AddValue(int c, float value)
+        {
+            var v = (uint)BitConverter.SingleToInt32Bits(value);
+            var x = v ^ lastValues[c];
+            lastValues[c] = v;
+
+            if (x == 0)
+            {
+                Write(0, 1);
+                return;
+            }
+
+            var lead = BitOperations.LeadingZeroCount(x);
+            var trail = BitOperations.TrailingZeroCount(x);
+            if (leading[c] >= 0 && lead >= leading[c] && trail >= trailing[c])
+            {
+                Write(0b10, 2);
+                Write(x >> trailing[c], 32 - leading[c] - trailing[c]);
+                return;
+            }
+
+            var length = 32 - lead - trail;
+            Write(0b11, 2);
+            Write((ulong)lead, 5);
+            Write((ulong)(length - 1), 5);
+            Write(x >> trail, length);
+            leading[c] = lead;
+            trailing[c] = trail;
+        }
+
+        // Write the low `n` bits of `value`, most significant first.
+        private void Write(ulong value, int n)
+        {
+            if (n < 64)
+                value &= (1UL << n) - 1;
+
+            var word = (int)(bits >> 6);
+            if (word + 1 >= words.Length)
+                Array.Resize(ref words, words.Length * 2);
+
+            var free = 64 - (int)(bits & 63);
+            if (n <= free)
+                words[word] |= value << (free - n);
+            else
+            {
+                words[word] |= value >> (n - free);
+                words[word + 1] |= value << (64 - (n - free));
+            }
+            bits += n;
+        }
+
+        private ref struct Reader
+        {
+            private readonly ReadOnlySpan<ulong> words;
+            private long bits;
+
+            public Reader(ReadOnlySpan<ulong> words)
+            {
+                this.words = words;
+                bits = 0;
+            }
+
+            public ulong Read(int n)
+            {
+                var word = (int)(bits >> 6);
+                var offset = (int)(bits & 63);
+                var free = 64 - offset;
+                bits += n;
+
+                if (n <= free)
+                    return (words[word] << offset) >> (64 - n);
+
+                var high = words[word] & ((1UL << free) - 1);
+                return high << (n - free) | words[word + 1] >> (64 - (n - free));
+            }
+
+            public long ReadSigned(int n)
+            {
+                var shift = 64 - n;
+                return (long)(Read(n) << shift) >> shift;
+            }
+        }
+    }
+}
@@ -4,5 +4,8 @@ namespace PicovaUI.Models
     {
         None,
         Median,
+        Boxcar,
+        LowPass,
+        Decimate,
     }
 }
@@ -2,9 +2,11 @@ namespace PicovaUI.Models
 {
     public record Measurement
     {
-        public uint Timestamp { get; init; }
+        public int Device { get; init; }
+        public ulong Timestamp { get; init; }
         public float Voltage { get; init; }
         public float Current { get; init; }
         public float Power { get; init; }
+        public byte Markers { get; init; }
     }
 }
@@ -0,0 +1,81 @@
+using System;
+using System.Collections.Concurrent;
+
+namespace PicovaUI.Models
+{
+    // A block of consecutive samples from one device, stored column-wise so
+    // that each stage of the live pipeline can work on whole spans, along
+    // with the marker changes decoded with them. Batches are pooled: the end
+    // of the pipeline hands them back with Dispose(), so a stage that needs
+    // samples after it returns must copy them out.
+    public sealed class MeasurementBatch : IDisposable
+    {
+        public const int Capacity = 4096;
+        public const int MarkerCapacity = 256;
+
+        private static readonly ConcurrentBag<MeasurementBatch> pool = new();
+
+        private readonly ulong[] timestamps = new ulong[Capacity];
+        private readonly float[] voltages = new float[Capacity];
+        private readonly float[] currents = new float[Capacity];
+        private readonly float[] powers = new float[Capacity];
+        private readonly byte[] markers = new byte[Capacity];
+        private readonly ulong[] markerTimestamps = new ulong[MarkerCapacity];
+        private readonly byte[] markerStates = new byte[MarkerCapacity];
+        private int count;
+        private int markerCount;
+
+        public int Device { get; private set; }
+
+        // HostClock time at which the bytes for this batch were read.
+        public double ReceivedUs { get; private set; }
+
+        // Number of valid samples. Set it to Capacity to fill the columns,
+        // then trim it to what was written.
+        public int Count
+        {
+            get => count;
+            set => count = value >= 0 && value <= Capacity ? value : throw new ArgumentOutOfRangeException(nameof(value));
+        }
+
+        public Span<ulong> Timestamps => timestamps.AsSpan(0, count);
+        public Span<float> Voltages => voltages.AsSpan(0, count);
+        public Span<float> Currents => currents.AsSpan(0, count);
+        public Span<float> Powers => powers.AsSpan(0, count);
+
+        // Marker input state of each sample, one bit per input.
+        public Span<byte> Markers => markers.AsSpan(0, count);
+
+        // Number of marker changes, each the state of the inputs from its
+        // timestamp on. Set and trim like Count.
+        public int MarkerCount
+        {
+            get => markerCount;
+            set => markerCount = value >= 0 && value <= MarkerCapacity ? value : throw new ArgumentOutOfRangeException(nameof(value));
+        }
+
+        public Span<ulong> MarkerTimestamps => markerTimestamps.AsSpan(0, markerCount);
+        public Span<byte> MarkerStates => markerStates.AsSpan(0, markerCount);
+
+        private MeasurementBatch()
+        {
+        }
+
+        public static MeasurementBatch Rent(int device, double receivedUs)
+        {
+            if (!pool.TryTake(out var batch))
+                batch = new MeasurementBatch();
+
+            batch.Device = device;
+            batch.ReceivedUs = receivedUs;
+            batch.count = 0;
+            batch.markerCount = 0;
+            return batch;
+        }
+
+        public void Dispose()
+        {
+            pool.Add(this);
+        }
+    }
+}
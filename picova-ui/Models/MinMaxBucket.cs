@@ -0,0 +1,55 @@
+using System;
+using System.Runtime.InteropServices;
+
+namespace PicovaUI.Models
+{
+    // Summary of a contiguous run of samples in one level of a LodPyramid.
+    // A marker input is set in MarkersAny if it was high at any sample of the
+    // run, and in MarkersAll if it was high at every one.
+    [StructLayout(LayoutKind.Sequential, Pack = 4)]
+    public struct MinMaxBucket
+    {
+        public long Start;
+        public long End;
+        public float MinVoltage, MaxVoltage;
+        public float MinCurrent, MaxCurrent;
+        public float MinPower, MaxPower;
+        public byte MarkersAny, MarkersAll;
+
+        public static MinMaxBucket From(in RecordedSample s) => new()
+        {
+            Start = s.Timestamp,
+            End = s.Timestamp,
+            MinVoltage = s.Voltage, MaxVoltage = s.Voltage,
+            MinCurrent = s.Current, MaxCurrent = s.Current,
+            MinPower = s.Power, MaxPower = s.Power,
+            MarkersAny = s.Markers, MarkersAll = s.Markers,
+        };
+
+        public void Add(in RecordedSample s)
+        {
+            End = s.Timestamp;
+            MinVoltage = Math.Min(MinVoltage, s.Voltage);
+            MaxVoltage = Math.Max(MaxVoltage, s.Voltage);
+            MinCurrent = Math.Min(MinCurrent, s.Current);
+            MaxCurrent = Math.Max(MaxCurrent, s.Current);
+            MinPower = Math.Min(MinPower, s.Power);
+            MaxPower = Math.Max(MaxPower, s.Power);
+            MarkersAny |= s.Markers;
+            MarkersAll &= s.Markers;
+        }
+
+        public void Add(in MinMaxBucket b)
+        {
+            End = b.End;
+            MinVoltage = Math.Min(MinVoltage, b.MinVoltage);
+            MaxVoltage = Math.Max(MaxVoltage, b.MaxVoltage);
+            MinCurrent = Math.Min(MinCurrent, b.MinCurrent);
+            MaxCurrent = Math.Max(MaxCurrent, b.MaxCurrent);
+            MinPower = Math.Min(MinPower, b.MinPower);
+            MaxPower = Math.Max(MaxPower, b.MaxPower);
+            MarkersAny |= b.MarkersAny;
+            MarkersAll &= b.MarkersAll;
+        }
+    }
+}
@@ -0,0 +1,17 @@
+namespace PicovaUI.Models
+{
+    // A stretch of time during which the current was above the event
+    // threshold, e.g. a wake-up or a radio burst. See EventDetector.
+    public record PowerEvent
+    {
+        public int Index { get; init; }
+        public ulong Start { get; init; }
+        public ulong End { get; init; }
+        public float PeakCurrent { get; init; }
+        public double Charge { get; init; }     // µC, i.e. mA·ms
+        public double Energy { get; init; }     // µJ, i.e. mW·ms
+
+        public double Duration => (End - Start) / 1000.0;  // ms
+        public double StartSeconds => Start / 1e6;
+    }
+}
@@ -0,0 +1,17 @@
+using System.Runtime.InteropServices;
+
+namespace PicovaUI.Models
+{
+    // A single sample as stored in a memory-mapped recording. Unlike
+    // Measurement the timestamp is unwrapped to 64 bits so that recordings can
+    // span more than the ~71 minutes a 32-bit microsecond counter covers.
+    [StructLayout(LayoutKind.Sequential, Pack = 4)]
+    public struct RecordedSample
+    {
+        public long Timestamp;
+        public float Voltage;
+        public float Current;
+        public float Power;
+        public byte Markers;
+    }
+}
@@ -0,0 +1,170 @@
+using System;
+
+namespace PicovaUI.Models
+{
+    // A growable column store of samples, appended to at the end and trimmed
+    // from the front, for data kept beyond the lifetime of a batch. Trimming
+    // only moves the head forward; the columns are compacted once the head
+    // has passed half their capacity, so that dropping a few samples per
+    // batch doesn't copy the whole window each time. Indices are relative to
+    // the head.
+    public class SampleBuffer
+    {
+        private ulong[] timestamps = Array.Empty<ulong>();
+        private float[] voltages = Array.Empty<float>();
+        private float[] currents = Array.Empty<float>();
+        private float[] powers = Array.Empty<float>();
+        private byte[] markers = Array.Empty<byte>();
+        private int head;
+
+        public int Count { get; private set; }
+
+        public ReadOnlySpan<ulong> Timestamps => timestamps.AsSpan(head, Count);
+        public ReadOnlySpan<float> Voltages => voltages.AsSpan(head, Count);
+        public ReadOnlySpan<float> Currents => currents.AsSpan(head, Count);
+        public ReadOnlySpan<float> Powers => powers.AsSpan(head, Count);
+        public ReadOnlySpan<byte> Markers => markers.AsSpan(head, Count);
+
+        // Channel c in the order voltage, current, power.
+        public ReadOnlySpan<float> Channel(int c) => c switch
+        {
+            0 => Voltages,
+            1 => Currents,
+            _ => Powers,
+        };
+
+        public Measurement this[int index] => new()
+        {
+            Timestamp = timestamps[head + index],
+            Voltage = voltages[head + index],
+            Current = currents[head + index],
+            Power = powers[head + index],
+            Markers = markers[head + index],
+        };
+
+        public void Append(MeasurementBatch batch)
+        {
+            var n = batch.Count;
+            Reserve(n);
+
+            var end = head + Count;
+            batch.Timestamps.CopyTo(timestamps.AsSpan(end));
+            batch.Voltages.CopyTo(voltages.AsSpan(end));
+            batch.Currents.CopyTo(currents.AsSpan(end));
+            batch.Powers.CopyTo(powers.AsSpan(end));
+            batch.Markers.CopyTo(markers.AsSpan(end));
+            Count += n;
+        }
+
+        public void Append(ulong timestamp, float voltage, float current, float power, byte markers)
+        {
+            Reserve(1);
+            var end = head + Count;
+            timestamps[end] = timestamp;
+            voltages[end] = voltage;
+            currents[end] = current;
+            powers[end] = power;
+            this.markers[end] = markers;
+            Count++;
+        }
+
+        // Put the samples of `older`, which all come before these, in front.
+        public void Prepend(SampleBuffer older)
+        {
+            var n = older.Count;
+            Reserve(n);
+            Compact();
+            Array.Copy(timestamps, 0, timestamps, n, Count);
+            Array.Copy(voltages, 0, voltages, n, Count);
+            Array.Copy(currents, 0, currents, n, Count);
+            Array.Copy(powers, 0, powers, n, Count);
+            Array.Copy(markers, 0, markers, n, Count);
+
+            older.Timestamps.CopyTo(timestamps);
+            older.Voltages.CopyTo(voltages);
+            older.Currents.CopyTo(currents);
+            older.Powers.CopyTo(powers);
+            older.Markers.CopyTo(markers);
+            Count += n;
+        }
+
+        // A copy of `count` samples from `start` on.
+        public SampleBuffer Slice(int start, int count)
+        {
+            var from = head + start;
+            return new SampleBuffer
+            {
+                timestamps = timestamps[from..(from + count)],
+                voltages = voltages[from..(from + count)],
+                currents = currents[from..(from + count)],
+                powers = powers[from..(from + count)],
+                markers = markers[from..(from + count)],
+                Count = count,
+            };
+        }
+
+        public void RemoveFirst(int n)
+        {
+            head += n;
+            Count -= n;
+            if (Count == 0)
+                head = 0;
+            else if (head > timestamps.Length / 2)
+                Compact();
+        }
+
+        public void Clear()
+        {
+            head = 0;
+            Count = 0;
+        }
+
+        // Move the samples down to the start of the columns.
+        private void Compact()
+        {
+            if (head == 0)
+                return;
+
+            Array.Copy(timestamps, head, timestamps, 0, Count);
+            Array.Copy(voltages, head, voltages, 0, Count);
+            Array.Copy(currents, head, currents, 0, Count);
+            Array.Copy(powers, head, powers, 0, Count);
+            Array.Copy(markers, head, markers, 0, Count);
+            head = 0;
+        }
+
+        // Make room for `n` more samples, reusing the space before the head
+        // before growing.
+        private void Reserve(int n)
+        {
+            if (head + Count + n <= timestamps.Length)
+                return;
+
+            Compact();
+            if (Count + n <= timestamps.Length)
+                return;
+
+            var capacity = Math.Max(Count + n, timestamps.Length * 2);
+            Array.Resize(ref timestamps, capacity);
+            Array.Resize(ref voltages, capacity);
+            Array.Resize(ref currents, capacity);
+            Array.Resize(ref powers, capacity);
+            Array.Resize(ref markers, capacity);
+        }
+
+        // Index of the first sample with a timestamp >= time.
+        public int IndexOf(double time)
+        {
+            int lo = 0, hi = Count;
+            while (lo < hi)
+            {
+                var mid = lo + (hi - lo) / 2;
+                if (timestamps[head + mid] < time)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+    }
+}
@@ -0,0 +1,206 @@
+using System;
+using System.Collections.Generic;
+using System.Runtime.CompilerServices;
+
+namespace PicovaUI.Models
+{
+    // Samples that have scrolled out of the live window, kept so that the
+    // window can be widened again. Newer samples are held in compressed
+    // blocks (see CompressedBlock) and older ones only as min/max summaries,
+    // within a memory budget: when the blocks outgrow their share the oldest
+    // is summarised, and when the summaries outgrow theirs the oldest are
+    // dropped. Samples go in newest last and come back out newest first.
+    public sealed class SampleHistory
+    {
+        // Samples per summary bucket, and the part of the budget that
+        // summaries may use.
+        private const int bucketSamples = 64;
+        private const int summaryShare = 8;
+        private static readonly int bucketBytes = Unsafe.SizeOf<MinMaxBucket>();
+
+        private readonly List<CompressedBlock> blocks = new();
+        private readonly List<MinMaxBucket> summaries = new();
+        // Whether the last block is still being filled. Only full blocks
+        // are sealed and counted against the budget.
+        private bool open;
+        private long blockBytes;
+
+        // Memory to use, in bytes.
+        public long Budget { get; set; } = 64L << 20;
+
+        // Time of the oldest sample kept, in full or as a summary, or
+        // infinity if there are none.
+        public double Start => summaries.Count > 0 ? summaries[0].Start
+            : blocks.Count > 0 ? blocks[0].Start : double.PositiveInfinity;
+
+        public void Clear()
+        {
+            blocks.Clear();
+            summaries.Clear();
+            open = false;
+            blockBytes = 0;
+        }
+
+        // Add `count` samples from `start` on, which come after any already
+        // here.
+        public void Add(SampleBuffer samples, int start, int count)
+        {
+            var timestamps = samples.Timestamps;
+            var voltages = samples.Voltages;
+            var currents = samples.Currents;
+            var powers = samples.Powers;
+            var markers = samples.Markers;
+
+            for (int i = start; i < start + count; i++)
+            {
+                if (!open || blocks[^1].Full)
+                {
+                    if (open)
+                        Seal(blocks[^1]);
+                    blocks.Add(new CompressedBlock(timestamps[i]));
+                    open = true;
+                }
+                blocks[^1].Add(timestamps[i], voltages[i], currents[i], powers[i], markers[i]);
+            }
+        }
+
+        // Take back out the samples from `time` on, oldest first. Whole
+        // blocks are decoded, and the part of the oldest one before `time`
+        // is put back.
+        public SampleBuffer TakeSince(double time)
+        {
+            var first = blocks.Count;
+            while (first > 0 && blocks[first - 1].End >= time)
+                first--;
+
+            var taken = new SampleBuffer();
+            for (int b = first; b < blocks.Count; b++)
+            {
+                blocks[b].Decode(taken);
+                if (b < blocks.Count - 1 || !open)
+                    blockBytes -= blocks[b].Bytes;
+            }
+            if (first < blocks.Count)
+            {
+                blocks.RemoveRange(first, blocks.Count - first);
+                open = false;
+            }
+
+            var keep = taken.IndexOf(time);
+            if (keep == 0)
+                return taken;
+
+            Add(taken, 0, keep);
+            return taken.Slice(keep, taken.Count - keep);
+        }
+
+        // The summaries of samples from `time` on that are only kept as
+        // summaries, oldest first.
+        public IEnumerable<MinMaxBucket> SummariesSince(double time)
+        {
+            foreach (var b in summaries)
+            {
+                if (b.End >= time)
+                    yield return b;
+            }
+        }
+
+        // Min/max envelopes of what is kept from `start` to `end`, oldest
+        // first, merged so that each covers at least an equal share of the
+        // time and there are no more than output.Length of them. Blocks are
+        // decoded without being taken out, so the history is left as it
+        // was. Returns the number of envelopes written.
+        public int Envelope(double start, double end, Span<MinMaxBucket> output)
+        {
+            if (end <= start || output.Length == 0)
+                return 0;
+
+            var width = (end - start) / output.Length;
+            int n = 0, slot = -1;
+
+            foreach (var b in summaries)
+            {
+                if (b.End >= start && b.Start <= end)
+                    Merge(output, ref n, ref slot, (b.Start - start) / width, b);
+            }
+
+            var samples = new SampleBuffer();
+            foreach (var block in blocks)
+            {
+                if (block.End < start || block.Start > end)
+                    continue;
+
+                samples.Clear();
+                block.Decode(samples);
+                var timestamps = samples.Timestamps;
+                for (int i = 0; i < samples.Count; i++)
+                {
+                    if (timestamps[i] >= start && timestamps[i] <= end)
+                        Merge(output, ref n, ref slot, (timestamps[i] - start) / width, MinMaxBucket.From(Sample(samples, i)));
+                }
+            }
+
+            return n;
+        }
+
+        // Add `b` to the last envelope if it falls in the same share of the
+        // time, or start a new one.
+        private static void Merge(Span<MinMaxBucket> output, ref int n, ref int slot, double position, in MinMaxBucket b)
+        {
+            var s = Math.Clamp((int)position, 0, output.Length - 1);
+            if (s == slot)
+            {
+                output[n - 1].Add(b);
+                return;
+            }
+
+            output[n++] = b;
+            slot = s;
+        }
+
+        // Count a full block against the budget, and make room for it.
+        private void Seal(CompressedBlock block)
+        {
+            block.Seal();
+            blockBytes += block.Bytes;
+
+            var summaryBudget = Budget / summaryShare;
+            var demote = 0;
+            while (demote < blocks.Count - 1 && blockBytes > Budget - summaryBudget)
+            {
+                Summarise(blocks[demote]);
+                blockBytes -= blocks[demote].Bytes;
+                demote++;
+            }
+            blocks.RemoveRange(0, demote);
+
+            var excess = summaries.Count - (int)(summaryBudget / bucketBytes);
+            if (excess > 0)
+                summaries.RemoveRange(0, excess);
+        }
+
+        private void Summarise(CompressedBlock block)
+        {
+            var samples = new SampleBuffer();
+            block.Decode(samples);
+
+            for (int i = 0; i < samples.Count; i += bucketSamples)
+            {
+                var bucket = MinMaxBucket.From(Sample(samples, i));
+                var end = Math.Min(i + bucketSamples, samples.Count);
+                for (int j = i + 1; j < end; j++)
+                    bucket.Add(Sample(samples, j));
+                summaries.Add(bucket);
+            }
+        }
+
+        private static RecordedSample Sample(SampleBuffer samples, int i) => new()
+        {
+            Timestamp = (long)samples.Timestamps[i],
+            Voltage = samples.Voltages[i],
+            Current = samples.Currents[i],
+            Power = samples.Powers[i],
+            Markers = samples.Markers[i],
+        };
+    }
+}
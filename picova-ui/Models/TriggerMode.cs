@@ -0,0 +1,13 @@
+namespace PicovaUI.Models
+{
+    // What a trigger looks for on its channel; see Trigger.
+    public enum TriggerMode
+    {
+        Rising,         // Crossing the level upwards
+        Falling,        // Crossing the level downwards
+        Above,          // Any sample at or above the level
+        Below,          // Any sample below the level
+        WiderThan,      // A pulse above the level lasting longer than the width
+        NarrowerThan,   // A pulse above the level lasting less than the width
+    }
+}
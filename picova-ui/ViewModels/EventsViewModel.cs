@@ -0,0 +1,139 @@
+using System;
+using System.Collections.Generic;
+using System.Collections.ObjectModel;
+using System.Globalization;
+using System.IO;
+using System.Reactive;
+using PicovaUI.Filters;
+using PicovaUI.Models;
+using ReactiveUI;
+using ReactiveUI.Fody.Helpers;
+
+namespace PicovaUI.ViewModels
+{
+    // Table of power events found in the live stream, and the energy split
+    // by marker state. Detection runs on the reader's batches off the UI
+    // thread; finished events are queued and moved into the table on each
+    // redraw.
+    public class EventsViewModel : ViewModelBase
+    {
+        private readonly EventDetector detector = new();
+        private readonly MarkerEnergy markerEnergy = new();
+        private readonly List<PowerEvent> pending = new();
+        private double threshold = 10;
+        private double hysteresis = 2;
+        private double totalCharge;
+        private double totalEnergy;
+
+        public ObservableCollection<PowerEvent> Events { get; } = new();
+        [Reactive] public PowerEvent? SelectedEvent { get; set; }
+        [Reactive] public string Summary { get; private set; } = string.Empty;
+        [Reactive] public string MarkerSummary { get; private set; } = string.Empty;
+        public ReactiveCommand<Unit, Unit> Export { get; }
+
+        // Current at which an event starts, in mA.
+        public double Threshold
+        {
+            get => threshold;
+            set
+            {
+                threshold = value;
+                UpdateLevels();
+                this.RaisePropertyChanged(nameof(Threshold));
+            }
+        }
+
+        // How far the current has to drop below the threshold to end an
+        // event, in mA.
+        public double Hysteresis
+        {
+            get => hysteresis;
+            set
+            {
+                hysteresis = value;
+                UpdateLevels();
+                this.RaisePropertyChanged(nameof(Hysteresis));
+            }
+        }
+
+        public EventsViewModel()
+        {
+            Export = ReactiveCommand.Create(DoExport);
+            UpdateLevels();
+            UpdateSummary();
+        }
+
+        public void AddBatch(MeasurementBatch batch)
+        {
+            lock (pending)
+            {
+                detector.Process(batch, pending);
+                markerEnergy.Process(batch);
+            }
+        }
+
+        // Move newly finished events into the table. Call on the UI thread.
+        public void Flush()
+        {
+            lock (pending)
+            {
+                if (markerEnergy.Any)
+                    MarkerSummary = "By marker state: " + markerEnergy.Summarise();
+
+                if (pending.Count == 0)
+                    return;
+
+                foreach (var e in pending)
+                {
+                    Events.Add(e);
+                    totalCharge += e.Charge;
+                    totalEnergy += e.Energy;
+                }
+                pending.Clear();
+            }
+
+            UpdateSummary();
+        }
+
+        public void Clear()
+        {
+            lock (pending)
+            {
+                detector.Reset();
+                markerEnergy.Reset();
+                pending.Clear();
+            }
+
+            MarkerSummary = string.Empty;
+
+            Events.Clear();
+            totalCharge = 0;
+            totalEnergy = 0;
+            UpdateSummary();
+        }
+
+        private void UpdateLevels()
+        {
+            lock (pending)
+            {
+                detector.High = (float)threshold;
+                detector.Low = (float)Math.Max(threshold - hysteresis, 0);
+            }
+        }
+
+        private void UpdateSummary()
+        {
+            Summary = $"{Events.Count} events, {totalCharge / 1000:F3} mC, {totalEnergy / 1000:F3} mJ";
+        }
+
+        private void DoExport()
+        {
+            var dst = Path.Combine(Environment.CurrentDirectory, $"PicoVA-events-{DateTime.Now:yyyyMMdd-HHmmss}.csv");
+            using var file = new StreamWriter(dst);
+            file.WriteLine("event,start_us,end_us,duration_ms,peak_mA,charge_uC,energy_uJ");
+            foreach (var e in Events)
+                file.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                    $"{e.Index},{e.Start},{e.End},{e.Duration},{e.PeakCurrent},{e.Charge},{e.Energy}"));
+        }
+    }
+}
@@ -0,0 +1,94 @@
+using System;
+using System.Diagnostics;
+using Avalonia.Threading;
+using ReactiveUI;
+using ReactiveUI.Fody.Helpers;
+
+namespace PicovaUI.ViewModels
+{
+    // Drives the live panels from a frame clock instead of from the data.
+    // Each tick asks the panels to publish whatever arrived since the last
+    // frame; the frame counts as done once the UI thread next goes idle,
+    // i.e. after OxyPlot has laid out and drawn it. A tick that comes while
+    // a frame is still in flight is dropped, and the interval follows the
+    // measured frame time so that drawing takes at most about half of the
+    // UI thread.
+    public class FramePacer : ReactiveObject
+    {
+        private const double minIntervalMs = 1000.0 / 60;
+        private const double maxIntervalMs = 500;
+        private const double budget = 0.5;
+        private const double smoothing = 0.2;
+
+        private readonly Func<bool> render;
+        private readonly DispatcherTimer timer;
+        private readonly Stopwatch clock = Stopwatch.StartNew();
+        private bool inFlight;
+        private double frameMs;
+        private double statsStart;
+        private int frames;
+        private int dropped;
+        private double frameSum;
+        private double frameMax;
+
+        [Reactive] public string Status { get; private set; } = string.Empty;
+
+        // `render` is called on the UI thread and returns false if there was
+        // nothing to draw.
+        public FramePacer(Func<bool> render)
+        {
+            this.render = render;
+            timer = new DispatcherTimer(TimeSpan.FromMilliseconds(minIntervalMs), DispatcherPriority.Render, OnTick);
+        }
+
+        public void Start() => timer.Start();
+
+        public void Stop() => timer.Stop();
+
+        private void OnTick(object? sender, EventArgs e)
+        {
+            var now = clock.Elapsed.TotalMilliseconds;
+            if (now - statsStart >= 1000)
+                UpdateStatus(now);
+
+            if (inFlight)
+            {
+                dropped++;
+                return;
+            }
+
+            if (!render())
+                return;
+
+            inFlight = true;
+            Dispatcher.UIThread.Post(() => OnFrameDone(now), DispatcherPriority.Background);
+        }
+
+        private void OnFrameDone(double start)
+        {
+            var ms = clock.Elapsed.TotalMilliseconds - start;
+            inFlight = false;
+
+            frameMs = frameMs == 0 ? ms : frameMs + smoothing * (ms - frameMs);
+            timer.Interval = TimeSpan.FromMilliseconds(Math.Clamp(frameMs / budget, minIntervalMs, maxIntervalMs));
+
+            frames++;
+            frameSum += ms;
+            frameMax = Math.Max(frameMax, ms);
+        }
+
+        private void UpdateStatus(double now)
+        {
+            var seconds = (now - statsStart) / 1000;
+            Status = frames > 0
+                ? $"{frames / seconds:F0} fps, frame {frameSum / frames:F1} ms (max {frameMax:F1}), {dropped} dropped"
+                : string.Empty;
+
+            statsStart = now;
+            frames = 0;
+            dropped = 0;
+            frameSum = 0;
+            frameMax = 0;
+        }
+    }
+}
@@ -1,10 +1,14 @@
 ﻿using System;
+using System.Collections.Generic;
 using System.Collections.ObjectModel;
 using System.IO;
 using System.IO.Ports;
 using System.Linq;
 using System.Reactive;
+using System.Reactive.Disposables;
 using System.Reactive.Linq;
+using System.Threading;
+using System.Threading.Tasks;
 using Avalonia.Threading;
 using PicovaUI.Models;
 using ReactiveUI;
@@ -14,17 +18,45 @@ namespace PicovaUI.ViewModels
 {
     public class MainWindowViewModel : ViewModelBase
     {
-        private readonly IO.MeasurementReader reader = new();
+        private List<IO.MeasurementReader> readers = new();
+        private IDisposable? capture;
+        private CancellationTokenSource? loading;
+        private List<string> devices = new();
+        private readonly IO.PipelineStats stats = new();
 
-        public ReadOnlyCollection<string> SerialPorts => new(SerialPort.GetPortNames());
-        [Reactive] public string? SelectedPort { get; set; }
+        // The serial ports, and any picova-server addresses
+        // ("socket://HOST:PORT") given on the command line, ticked.
+        public ObservableCollection<PortOption> Ports { get; } = new(SerialPort.GetPortNames().Select(p => new PortOption(p))
+            .Concat(Environment.GetCommandLineArgs().Skip(1)
+                .Where(a => a.StartsWith("socket://", StringComparison.OrdinalIgnoreCase))
+                .Select(a => new PortOption(a) { Selected = true })));
         public ReadOnlyCollection<Filter> Filters => new(Enum.GetValues<Filter>());
         [ObservableAsProperty] public string RunLabel { get; } = string.Empty;
         public ReactiveCommand<Unit, Unit> Run { get; }
-        [ObservableAsProperty] public bool Running { get; }
+        [Reactive] public bool Running { get; private set; }
+        [ObservableAsProperty] public string PipelineStatus { get; } = string.Empty;
+        [Reactive] public string ReaderError { get; private set; } = string.Empty;
         public MeasurementPlotViewModel MeasurementPlot { get; } = new();
+        public SpectrumViewModel Spectrum { get; } = new();
+        [Reactive] public bool ShowSpectrum { get; set; }
+        [ObservableAsProperty] public bool SpectrumVisible { get; }
+        public EventsViewModel Events { get; } = new();
+        public FramePacer Pacer { get; }
+        [Reactive] public bool ShowEvents { get; set; }
+        [ObservableAsProperty] public bool EventsVisible { get; }
+        public TriggerViewModel Trigger { get; } = new();
+        [Reactive] public bool ShowTrigger { get; set; }
+        [ObservableAsProperty] public bool TriggerVisible { get; }
         public ReactiveCommand<Unit, Unit> Clear { get; }
         public ReactiveCommand<Unit, Unit> SaveData { get; }
+        public ReactiveCommand<Unit, Unit> OpenRecording { get; }
+        public ReactiveCommand<Unit, Unit> CloseRecording { get; }
+        public ReactiveCommand<Unit, Unit> CancelOpen { get; }
+        [Reactive] public bool Opening { get; private set; }
+        [Reactive] public double OpenProgress { get; private set; }
+        public Interaction<Unit, string?> ChooseRecording { get; } = new();
+        [Reactive] public RecordingPlotViewModel? Recording { get; private set; }
+        [ObservableAsProperty] public ViewModelBase? CurrentPlot { get; }
 
         public double WindowSeconds
         {
@@ -38,48 +70,224 @@ namespace PicovaUI.ViewModels
 
         public MainWindowViewModel()
         {
-            var portSelected = this.WhenAnyValue(vm => vm.SelectedPort).Select(p => p != null);
-            Run = ReactiveCommand.Create(() => {}, portSelected);
+            Pacer = new FramePacer(RenderFrame);
+            Pacer.Start();
 
-            Run.Subscribe(_ => 
-            {
-                if (!reader.Connected)
-                    reader.Connect(SelectedPort!);
-                else
-                    reader.Disconnect();
-            });
+            var portSelected = Ports
+                .Select(p => p.WhenAnyValue(x => x.Selected))
+                .CombineLatest()
+                .Select(selected => selected.Any(x => x))
+                .StartWith(false);
+            Run = ReactiveCommand.Create(DoRun, portSelected);
 
-            Clear = ReactiveCommand.Create(() => MeasurementPlot.Clear(), 
+            Clear = ReactiveCommand.Create(() => { MeasurementPlot.Clear(); Spectrum.Clear(); Events.Clear(); Trigger.Clear(); },
                 this.WhenAnyValue(vm => vm.Running).Select(run => !run),
                 outputScheduler: AvaloniaScheduler.Instance);
             SaveData = ReactiveCommand.Create(DoSaveData);
 
-            this.WhenAnyValue(vm => vm.reader.Connected)
-                .ToPropertyEx(this, vm => vm.Running, 
+            OpenRecording = ReactiveCommand.CreateFromTask(DoOpenRecording,
+                this.WhenAnyValue(vm => vm.Running).Select(run => !run),
+                outputScheduler: AvaloniaScheduler.Instance);
+            CloseRecording = ReactiveCommand.Create(DoCloseRecording,
+                this.WhenAnyValue(vm => vm.Recording).Select(r => r != null),
+                outputScheduler: AvaloniaScheduler.Instance);
+            CancelOpen = ReactiveCommand.Create(() => loading?.Cancel(),
+                this.WhenAnyValue(vm => vm.Opening),
+                outputScheduler: AvaloniaScheduler.Instance);
+
+            this.WhenAnyValue(vm => vm.Recording)
+                .Select(r => r ?? (ViewModelBase)MeasurementPlot)
+                .ToPropertyEx(this, vm => vm.CurrentPlot,
+                    scheduler: AvaloniaScheduler.Instance);
+
+            this.WhenAnyValue(vm => vm.ShowSpectrum, vm => vm.Recording)
+                .Select(x => x.Item1 && x.Item2 == null)
+                .ToPropertyEx(this, vm => vm.SpectrumVisible,
+                    scheduler: AvaloniaScheduler.Instance);
+
+            this.WhenAnyValue(vm => vm.ShowSpectrum)
+                .Where(show => show)
+                .Subscribe(_ => Spectrum.Clear());
+
+            this.WhenAnyValue(vm => vm.ShowEvents, vm => vm.Recording)
+                .Select(x => x.Item1 && x.Item2 == null)
+                .ToPropertyEx(this, vm => vm.EventsVisible,
+                    scheduler: AvaloniaScheduler.Instance);
+
+            this.WhenAnyValue(vm => vm.ShowTrigger, vm => vm.Recording)
+                .Select(x => x.Item1 && x.Item2 == null)
+                .ToPropertyEx(this, vm => vm.TriggerVisible,
+                    scheduler: AvaloniaScheduler.Instance);
+
+            this.WhenAnyValue(vm => vm.ShowTrigger)
+                .Where(show => show)
+                .Subscribe(_ => Trigger.Clear());
+
+            // An event older than the plot's history can't be shown, so it
+            // isn't left selected.
+            this.WhenAnyValue(vm => vm.Events.SelectedEvent)
+                .WhereNotNull()
+                .Subscribe(e =>
+                {
+                    if (!MeasurementPlot.ShowRange(e.Start, e.End))
+                        Events.SelectedEvent = null;
+                });
+
+            Observable.Interval(TimeSpan.FromSeconds(1))
+                .Select(_ => stats.Take())
+                .Select(s => Running ? s.ToString() : string.Empty)
+                .ToPropertyEx(this, vm => vm.PipelineStatus,
                     scheduler: AvaloniaScheduler.Instance);
 
             this.WhenAnyValue(vm => vm.Running)
                 .Select(running => running ? "Stop" : "Run")
                 .ToPropertyEx(this, vm => vm.RunLabel, 
                     scheduler: AvaloniaScheduler.Instance);
+        }
+
+        // Start a reader per ticked port, or stop them all. Every device gets
+        // its own trace on the plot; the spectrum, event and trigger panels
+        // follow the first one. If any device fails, all of them are stopped
+        // and the error is shown.
+        private void DoRun()
+        {
+            if (Running)
+            {
+                StopReaders();
+                return;
+            }
+
+            var ports = Ports.Where(p => p.Selected).Select(p => p.Name).ToList();
+            if (!ports.SequenceEqual(devices))
+            {
+                devices = ports;
+                MeasurementPlot.SetDevices(devices);
+                Spectrum.Clear();
+                Events.Clear();
+                Trigger.Clear();
+            }
+
+            readers = ports.Select((_, i) => new IO.MeasurementReader(i)).ToList();
+            ReaderError = string.Empty;
+
+            // Each device has its own pipeline, so one falling behind doesn't
+            // hold up the others. Each stage takes whole batches; the last
+            // one recycles them. Drawing is left to the frame pacer, so
+            // nothing here waits on it.
+            capture = new CompositeDisposable(readers
+                .Select(r => r.Measurements
+                    .ObserveOn(RxApp.TaskpoolScheduler)
+                    .Do(MeasurementPlot.AddBatch)
+                    .Do(batch =>
+                    {
+                        if (batch.Device != 0)
+                            return;
+
+                        Events.AddBatch(batch);
+                        if (ShowSpectrum)
+                            Spectrum.AddBatch(batch);
+                        if (ShowTrigger)
+                            Trigger.AddBatch(batch);
+                    })
+                    .Do(stats.Record)
+                    .Subscribe(batch => batch.Dispose()))
+                .Concat(readers.Select(r => r.Errors
+                    .ObserveOn(AvaloniaScheduler.Instance)
+                    .Subscribe(e =>
+                    {
+                        StopReaders();
+                        ReaderError = $"{ports[r.Device]}: {e.Message}";
+                    }))));
+
+            try
+            {
+                for (int i = 0; i < ports.Count; i++)
+                    readers[i].Connect(ports[i]);
+            }
+            catch
+            {
+                StopReaders();
+                throw;
+            }
+
+            Running = true;
+        }
+
+        private bool RenderFrame()
+        {
+            Events.Flush();
+            Trigger.Flush();
 
-            reader.Measurements
-                .ObserveOn(RxApp.TaskpoolScheduler)
-                .Buffer(TimeSpan.FromMilliseconds(100))
-                .Where(_ => Running)
-                .Do(MeasurementPlot.AddMeasurements)
-                .ObserveOn(AvaloniaScheduler.Instance)
-                .Do(_ => MeasurementPlot.Redraw())
-                .Subscribe();
+            var drawn = MeasurementPlot.Redraw();
+            if (SpectrumVisible)
+                drawn |= Spectrum.Redraw();
+            return drawn;
+        }
+
+        private void StopReaders()
+        {
+            foreach (var reader in readers)
+                reader.Dispose();
+            readers.Clear();
+
+            capture?.Dispose();
+            capture = null;
+            Running = false;
+        }
+
+        // Importing a CSV file and building the level-of-detail cache can
+        // take a while for long recordings, so they run on the thread pool
+        // and the current view stays up until the new one is ready.
+        private async Task DoOpenRecording()
+        {
+            var path = await ChooseRecording.Handle(Unit.Default);
+            if (path == null)
+                return;
+
+            using var cancel = new CancellationTokenSource();
+            var progress = new Progress<double>(p => OpenProgress = p * 100);
+            loading = cancel;
+            OpenProgress = 0;
+            Opening = true;
+
+            try
+            {
+                var recording = await Task.Run(() => new RecordingPlotViewModel(path, progress, cancel.Token), cancel.Token);
+                DoCloseRecording();
+                Recording = recording;
+            }
+            catch (OperationCanceledException)
+            {
+            }
+            finally
+            {
+                loading = null;
+                Opening = false;
+            }
+        }
+
+        private void DoCloseRecording()
+        {
+            Recording?.Dispose();
+            Recording = null;
         }
 
         private void DoSaveData()
         {
-            var dst = Path.Combine(Environment.CurrentDirectory, $"PicoVA-{DateTime.Now:yyyyMMdd-HHmmss}.csv");
-            using var file = new StreamWriter(dst);
-            file.WriteLine("us,V,mA,mW");
-            foreach (var m in MeasurementPlot.Measurements)
-                file.WriteLine($"{m.Timestamp},{m.Voltage},{m.Current},{m.Power}");
+            // One file per device. Timestamps are all on the host time base,
+            // so recordings of several devices line up when opened.
+            var name = $"PicoVA-{DateTime.Now:yyyyMMdd-HHmmss}";
+            var count = MeasurementPlot.DeviceCount;
+
+            for (int d = 0; d < count; d++)
+            {
+                var suffix = count > 1 ? $"-dev{d}" : string.Empty;
+                var dst = Path.Combine(Environment.CurrentDirectory, $"{name}{suffix}.csv");
+                using var file = new StreamWriter(dst);
+                file.WriteLine("us,V,mA,mW,markers");
+                foreach (var m in MeasurementPlot.MeasurementsOf(d))
+                    file.WriteLine($"{m.Timestamp},{m.Voltage},{m.Current},{m.Power},{m.Markers}");
+            }
         }
     }
 }
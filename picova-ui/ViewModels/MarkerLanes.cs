@@ -0,0 +1,62 @@
+using OxyPlot;
+using OxyPlot.Axes;
+using System.Linq;
+
+namespace PicovaUI.ViewModels
+{
+    // The marker inputs drawn like a logic analyser under the measurements:
+    // input b is a lane at b when low and b + High when high. The lanes only
+    // take up room once some input has been seen high.
+    internal static class MarkerLanes
+    {
+        public const int Count = 8;
+        public const double High = 0.8;
+        private const double height = 0.16;
+        private const double gap = 0.02;
+
+        public static double Level(int bit, byte markers) => bit + ((markers >> bit) & 1) * High;
+
+        public static LinearAxis CreateAxis() => new()
+        {
+            Title = "Markers",
+            Key = "M",
+            StartPosition = 0,
+            EndPosition = 0,
+            MajorStep = 1,
+            MinorStep = 1,
+            IsZoomEnabled = false,
+            IsPanEnabled = false,
+            IsAxisVisible = false,
+        };
+
+        // The number of lanes needed to show every input set in `seen`.
+        public static int LanesFor(byte seen)
+        {
+            var lanes = 0;
+            for (; seen != 0; seen >>= 1)
+                lanes++;
+            return lanes;
+        }
+
+        // Share the plot's height between the power, current and voltage axes,
+        // bottom to top, with `lanes` marker lanes below them if any.
+        public static void Layout(PlotModel plot, int lanes)
+        {
+            var markers = plot.Axes.Single(ax => ax.Key == "M");
+            markers.IsAxisVisible = lanes > 0;
+            markers.StartPosition = 0;
+            markers.EndPosition = lanes > 0 ? height : 0;
+            markers.Minimum = -0.1;
+            markers.Maximum = lanes;
+
+            var start = lanes > 0 ? height + gap : 0;
+            var band = (1 - start + gap) / 3;
+            foreach (var (key, i) in new[] { ("W", 0), ("A", 1), ("V", 2) })
+            {
+                var ax = plot.Axes.Single(a => a.Key == key);
+                ax.StartPosition = start + i * band;
+                ax.EndPosition = start + i * band + band - gap;
+            }
+        }
+    }
+}
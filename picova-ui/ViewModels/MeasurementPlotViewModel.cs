@@ -1,34 +1,76 @@
-﻿using MathNet.Filtering;
-using MathNet.Filtering.Median;
-using OxyPlot;
+﻿using OxyPlot;
 using OxyPlot.Annotations;
 using OxyPlot.Axes;
+using OxyPlot.Legends;
 using OxyPlot.Series;
+using PicovaUI.Filters;
 using PicovaUI.Models;
 using ReactiveUI;
+using ReactiveUI.Fody.Helpers;
 using System;
 using System.Collections.Generic;
-using System.Collections.ObjectModel;
 using System.Linq;
-using System.Linq.Expressions;
 
 namespace PicovaUI.ViewModels
 {
     public class MeasurementPlotViewModel : ViewModelBase
     {
-        private readonly List<Measurement> meas = new();
-        private readonly LineSeries vLine;
-        private readonly LineSeries aLine;
-        private readonly LineSeries wLine;
+        // Most min/max envelopes drawn for a range recalled from the history.
+        private const int maxRecalled = 2048;
+
+        private readonly List<Trace> traces = new();
+        private readonly MinMaxBucket[] recalled = new MinMaxBucket[maxRecalled];
         private readonly TextAnnotation vLabel;
         private readonly TextAnnotation aLabel;
         private readonly TextAnnotation wLabel;
-        private readonly OnlineFilter[] filters = new OnlineFilter[3];
         private Filter filterType;
+        private int filterWidth = 16;
+        private float[] filterOutput = Array.Empty<float>();
+        // Guards the traces' samples and pending points. Ingest only ever
+        // takes this one, never Plot.SyncRoot, so it doesn't wait on a render.
+        private readonly object dataLock = new();
+        private ulong lastTime;
+        private bool dirty;
+        private int markerLanes;
+        private TimeSpan timeWindow = TimeSpan.FromSeconds(5);
+        private double historyMegabytes = 64;
 
         public PlotModel Plot { get; }
-        public TimeSpan TimeWindow { get; set; } = TimeSpan.FromSeconds(5);
-        public ReadOnlyCollection<Measurement> Measurements => new(meas);
+        // Window statistics for the stats panel, one block per device.
+        [Reactive] public bool ShowStats { get; set; }
+        [Reactive] public string Stats { get; private set; } = string.Empty;
+
+        // Widening the window brings back what has scrolled out of it from
+        // each trace's history, which is kept within HistoryMegabytes.
+        public TimeSpan TimeWindow
+        {
+            get => timeWindow;
+            set
+            {
+                lock (dataLock)
+                {
+                    var wider = value > timeWindow;
+                    timeWindow = value;
+                    if (wider)
+                        Restore();
+                }
+            }
+        }
+
+        public double HistoryMegabytes
+        {
+            get => historyMegabytes;
+            set
+            {
+                lock (dataLock)
+                {
+                    historyMegabytes = value;
+                    SetBudgets();
+                }
+                this.RaisePropertyChanged(nameof(HistoryMegabytes));
+            }
+        }
+        public int DeviceCount => traces.Count;
         public Filter Filter
         {
             get => filterType;
@@ -40,6 +82,18 @@ namespace PicovaUI.ViewModels
             }
         }
 
+        // Length of the filter in samples; see BlockFilter.Create().
+        public int FilterWidth
+        {
+            get => filterWidth;
+            set
+            {
+                filterWidth = value;
+                Refilter();
+                this.RaisePropertyChanged(nameof(FilterWidth));
+            }
+        }
+
         public MeasurementPlotViewModel()
         {
             var vAxis = new LinearAxis
@@ -73,27 +127,6 @@ namespace PicovaUI.ViewModels
                 Position = AxisPosition.Bottom,
             };
 
-            vLine = new LineSeries
-            {
-                YAxisKey = "V",
-                ItemsSource = meas,
-                Mapping = ToDataPoint(x => x.Voltage, 0),
-            };
-
-            aLine = new LineSeries
-            {
-                YAxisKey = "A",
-                ItemsSource = meas,
-                Mapping = ToDataPoint(x => x.Current, 1),
-            };
-
-            wLine = new LineSeries
-            {
-                YAxisKey = "W",
-                ItemsSource = meas,
-                Mapping = ToDataPoint(x => x.Power, 2),
-            };
-
             vLabel = new TextAnnotation
             {
                 TextPosition = new DataPoint(0, 0),
@@ -127,104 +160,495 @@ namespace PicovaUI.ViewModels
             Plot.Axes.Add(aAxis);
             Plot.Axes.Add(wAxis);
             Plot.Axes.Add(tAxis);
-
-            Plot.Series.Add(vLine);
-            Plot.Series.Add(aLine);
-            Plot.Series.Add(wLine);
+            Plot.Axes.Add(MarkerLanes.CreateAxis());
 
             Plot.Annotations.Add(vLabel);
             Plot.Annotations.Add(aLabel);
             Plot.Annotations.Add(wLabel);
 
-            Refilter();
+            Plot.Legends.Add(new Legend { LegendPosition = LegendPosition.TopLeft });
+
+            SetDevices(new[] { string.Empty });
         }
 
-        private Func<object, DataPoint> ToDataPoint(Expression<Func<Measurement, float>> getter, int filterIndex)
+        // Set up one trace per device, named for the legend. A single device
+        // is left unnamed so that the legend stays hidden.
+        public void SetDevices(IReadOnlyList<string> names)
         {
-            var getValue = getter.Compile();
-            return (object o) =>
+            lock (Plot.SyncRoot)
+            lock (dataLock)
             {
-                var m = (Measurement)o;
-                var value = getValue(m);
-                var filtered = filters[filterIndex].ProcessSample(value);
-                return new DataPoint(m.Timestamp, filtered);
-            };
+                foreach (var trace in traces)
+                {
+                    foreach (var line in trace.Lines)
+                        Plot.Series.Remove(line);
+                }
+                traces.Clear();
+
+                foreach (var name in names)
+                {
+                    var trace = new Trace(names.Count > 1 ? name : null);
+                    foreach (var line in trace.Lines)
+                        Plot.Series.Add(line);
+                    traces.Add(trace);
+                }
+
+                SetBudgets();
+                Refilter();
+            }
+        }
+
+        // The measurements currently held for a device, for saving.
+        public IReadOnlyList<Measurement> MeasurementsOf(int device)
+        {
+            lock (dataLock)
+            {
+                var samples = traces[device].Samples;
+                return Enumerable.Range(0, samples.Count).Select(i => samples[i]).ToList();
+            }
         }
 
         public void Clear()
         {
-            meas.Clear();
-            Redraw();
+            lock (Plot.SyncRoot)
+            lock (dataLock)
+            {
+                foreach (var trace in traces)
+                    trace.Clear();
+                lastTime = 0;
+                dirty = true;
+            }
         }
 
-        public void Redraw()
+        // Move the points filtered since the last frame into the series and
+        // invalidate the plot. Call on the UI thread; returns false if there
+        // was nothing new to draw.
+        public bool Redraw()
         {
+            lock (Plot.SyncRoot)
+            {
+                lock (dataLock)
+                {
+                    if (!dirty)
+                        return false;
+                    dirty = false;
+
+                    foreach (var trace in traces)
+                        trace.Publish(lastTime);
+
+                    var lanes = MarkerLanes.LanesFor((byte)traces.Aggregate(0, (seen, t) => seen | t.MarkersSeen));
+                    if (lanes != markerLanes)
+                    {
+                        MarkerLanes.Layout(Plot, lanes);
+                        markerLanes = lanes;
+                    }
+
+                    UpdateRanges();
+                    UpdateLabels();
+                    TrimPoints();
+                    if (ShowStats)
+                        Stats = FormatStats();
+                }
+            }
+
             Plot.InvalidatePlot(true);
+            return true;
         }
 
-        public void AddMeasurements(IEnumerable<Measurement> measurements)
+        // Zoom the time axis to a range, with some margin either side. The
+        // zoom sticks until the axes are reset, even while running. The part
+        // of a range that has scrolled out of the time window is drawn from
+        // each trace's history as min/max envelopes, leaving the window and
+        // the samples in it alone. Returns false, leaving the plot as it is,
+        // if the history doesn't go back that far.
+        public bool ShowRange(ulong start, ulong end)
         {
-            meas.AddRange(measurements);
+            var margin = Math.Max((end - start) / 2.0, 1000);
 
-            uint lastTime = measurements.LastOrDefault()?.Timestamp ?? 0;
+            lock (Plot.SyncRoot)
+            lock (dataLock)
+            {
+                var minTime = lastTime - timeWindow.TotalMilliseconds * 1000;
+                if (start < minTime && !traces.Any(t => t.History.Start <= start))
+                    return false;
+
+                foreach (var trace in traces)
+                    Recall(trace, start - margin, Math.Min(end + margin, minTime));
+            }
 
-            if (meas.Count > 0)
+            Plot.Axes.Single(ax => ax.Key == "T").Zoom(start - margin, end + margin);
+            Plot.InvalidatePlot(true);
+            return true;
+        }
+
+        // Add a batch from one of the devices. The samples are copied, so the
+        // batch can be recycled as soon as this returns.
+        public void AddBatch(MeasurementBatch batch)
+        {
+            lock (dataLock)
             {
-                Action<TextAnnotation> updatePosition = label => 
+                if (batch.Device >= traces.Count)
+                    return;
+
+                var trace = traces[batch.Device];
+                if (batch.MarkerCount > 0)
+                {
+                    AddMarkers(trace, batch);
+                    dirty = true;
+                }
+                if (batch.Count == 0)
+                    return;
+
+                var start = trace.Samples.Count;
+                trace.Samples.Append(batch);
+                trace.Stats.Add(trace.Samples, start);
+                FilterBatch(trace, start);
+
+                lastTime = Math.Max(lastTime, batch.Timestamps[^1]);
+                var minTime = lastTime - TimeWindow.TotalMilliseconds * 1000;
+                foreach (var t in traces)
                 {
-                    var ax = Plot.GetAxis(label.YAxisKey);
-                    var midAxis = ax.ActualMinimum + (ax.ActualMaximum - ax.ActualMinimum) / 2;
-                    label.TextPosition = new DataPoint(lastTime, midAxis);
-                };
+                    var n = t.Samples.IndexOf(minTime);
+                    if (n > 0)
+                    {
+                        t.History.Add(t.Samples, 0, n);
+                        t.Stats.Remove(t.Samples, n);
+                        t.Samples.RemoveFirst(n);
+                    }
+                }
+
+                dirty = true;
+            }
+        }
+
+        private void UpdateLabels()
+        {
+            var live = traces.Where(t => t.Samples.Count > 0).ToList();
+            if (live.Count == 0)
+                return;
+
+            Action<TextAnnotation, int, string> updateLabel = (label, c, unit) =>
+            {
+                var ax = Plot.GetAxis(label.YAxisKey);
+                var midAxis = ax.ActualMinimum + (ax.ActualMaximum - ax.ActualMinimum) / 2;
+                label.TextPosition = new DataPoint(lastTime, midAxis);
+                label.Text = string.Join(" | ", live.Select(t => $"{t.Samples.Channel(c)[^1]:F3} {unit} (mean {t.Stats.Mean(c):F3})"));
+            };
 
-                var latest = meas[^1];
-                vLabel.Text = $"{latest.Voltage:F3} V";
-                aLabel.Text = $"{latest.Current:F3} mA";
-                wLabel.Text = $"{latest.Power:F3} mW";
+            updateLabel(vLabel, 0, "V");
+            updateLabel(aLabel, 1, "mA");
+            updateLabel(wLabel, 2, "mW");
+        }
 
-                updatePosition(vLabel);
-                updatePosition(aLabel);
-                updatePosition(wLabel);
+        // Scale the axes to the window's extremes, which the stats already
+        // know, rather than have OxyPlot search the points for them.
+        private void UpdateRanges()
+        {
+            foreach (var trace in traces)
+            {
+                for (int c = 0; c < 3; c++)
+                {
+                    var line = (RangedLineSeries)trace.Lines[c];
+                    var min = trace.Stats.Count > 0 ? trace.Stats.Min(c) : double.NaN;
+                    var max = trace.Stats.Count > 0 ? trace.Stats.Max(c) : double.NaN;
+
+                    // Until the summarised points have scrolled out.
+                    var points = trace.Points[c];
+                    if (points.Count > 0 && points[0].X <= trace.SummaryEnd)
+                    {
+                        min = double.IsNaN(min) ? trace.SummaryMin[c] : Math.Min(min, trace.SummaryMin[c]);
+                        max = double.IsNaN(max) ? trace.SummaryMax[c] : Math.Max(max, trace.SummaryMax[c]);
+                    }
+
+                    line.MinimumY = min;
+                    line.MaximumY = max;
+                }
             }
+        }
+
+        private string FormatStats()
+        {
+            var window = TimeWindow.TotalSeconds;
+            return string.Join(Environment.NewLine + Environment.NewLine, traces.Where(t => t.Samples.Count > 0).Select(t =>
+            {
+                var s = t.Stats;
+                var rows = new[] { ("V", "V"), ("I", "mA"), ("P", "mW") }.Select((ch, c) =>
+                    $"{ch.Item1}  min {s.Min(c),9:F3}  max {s.Max(c),9:F3}  mean {s.Mean(c),9:F3}  rms {s.Rms(c),9:F3} {ch.Item2}");
+                var header = t.Lines[0].Title is { } name ? name + Environment.NewLine : string.Empty;
+                return header + string.Join(Environment.NewLine, rows) + Environment.NewLine
+                    + $"Over {window:F0} s: {s.Charge / 1000:F3} mC, {s.Energy / 1000:F3} mJ";
+            }));
+        }
 
+        private void TrimPoints()
+        {
             var minTime = lastTime - TimeWindow.TotalMilliseconds * 1000;
-            var n = meas.FindIndex(m => m.Timestamp >= minTime);
+            var trimmed = false;
 
-            if (n > 0)
+            foreach (var trace in traces)
             {
-                meas.RemoveRange(0, n);
-                Plot.Axes.Single(ax => ax.Key == "T").Minimum = double.NaN;
+                foreach (var p in trace.Points)
+                {
+                    var k = p.FindIndex(pt => pt.X >= minTime);
+                    if (k != 0)
+                    {
+                        p.RemoveRange(0, k < 0 ? p.Count : k);
+                        trimmed = true;
+                    }
+                }
             }
-            else
+
+            // A lane keeps the level it had at the start of the window.
+            foreach (var trace in traces)
             {
-                Plot.Axes.Single(ax => ax.Key == "T").Minimum = minTime;
+                foreach (var p in trace.MarkerPoints)
+                {
+                    var k = p.FindIndex(pt => pt.X >= minTime);
+                    if (k > 0)
+                    {
+                        var level = p[k - 1].Y;
+                        p.RemoveRange(0, k);
+                        p.Insert(0, new DataPoint(minTime, level));
+                    }
+                }
+            }
+
+            Plot.Axes.Single(ax => ax.Key == "T").Minimum = trimmed ? double.NaN : minTime;
+        }
+
+        // Each marker change is a step on the lanes of the inputs that changed,
+        // so a lane starts the first time its input is seen high. The markers
+        // aren't filtered.
+        private static void AddMarkers(Trace trace, MeasurementBatch batch)
+        {
+            var times = batch.MarkerTimestamps;
+            var states = batch.MarkerStates;
+            for (int i = 0; i < times.Length; i++)
+            {
+                var changed = states[i] ^ trace.Markers;
+                for (int b = 0; b < MarkerLanes.Count; b++)
+                {
+                    if (((changed >> b) & 1) == 0)
+                        continue;
+                    trace.PendingMarkers[b].Add(new DataPoint(times[i], MarkerLanes.Level(b, trace.Markers)));
+                    trace.PendingMarkers[b].Add(new DataPoint(times[i], MarkerLanes.Level(b, states[i])));
+                }
+                trace.Markers = states[i];
+                trace.MarkersSeen |= states[i];
+            }
+        }
+
+        // Run a trace's samples from `start` on through its filters one channel
+        // at a time, straight from the column store.
+        private void FilterBatch(Trace trace, int start)
+        {
+            var n = trace.Samples.Count - start;
+            if (filterOutput.Length < n)
+                filterOutput = new float[n];
+
+            var timestamps = trace.Samples.Timestamps[start..];
+            for (int c = 0; c < trace.Filters.Length; c++)
+            {
+                var filter = trace.Filters[c];
+                var count = filter.Process(trace.Samples.Channel(c)[start..], filterOutput, out var first);
+                for (int k = 0; k < count; k++)
+                    trace.Pending[c].Add(new DataPoint(timestamps[first + k * filter.Decimation], filterOutput[k]));
             }
         }
 
         private void Refilter()
         {
-            Func<OnlineFilter> makeFilter = filterType switch 
+            lock (dataLock)
             {
-                Filter.Median => () => new OnlineMedianFilter(7),
-                _ => () => new OnlineIdentityFilter(),
-            };
+                foreach (var trace in traces)
+                    Rebuild(trace);
 
-            filters[0] = makeFilter();
-            filters[1] = makeFilter();
-            filters[2] = makeFilter();
+                dirty = true;
+            }
+        }
 
-            Plot.InvalidatePlot(true);
+        // Redraw a trace from scratch: the part of the window only kept as
+        // summaries as min/max envelopes, unfiltered, then the samples.
+        private void Rebuild(Trace trace)
+        {
+            trace.Discard();
+            for (int c = 0; c < trace.Filters.Length; c++)
+                trace.Filters[c] = BlockFilter.Create(filterType, filterWidth);
+
+            var minTime = lastTime - timeWindow.TotalMilliseconds * 1000;
+            trace.SummaryEnd = double.NegativeInfinity;
+            foreach (var b in trace.History.SummariesSince(minTime))
+            {
+                var t = b.Start + (b.End - b.Start) / 2.0;
+                AddEnvelope(trace, 0, t, b.MinVoltage, b.MaxVoltage);
+                AddEnvelope(trace, 1, t, b.MinCurrent, b.MaxCurrent);
+                AddEnvelope(trace, 2, t, b.MinPower, b.MaxPower);
+                trace.SummaryEnd = t;
+            }
+
+            FilterBatch(trace, 0);
+        }
+
+        private static void AddEnvelope(Trace trace, int c, double t, float min, float max)
+        {
+            var first = double.IsNegativeInfinity(trace.SummaryEnd);
+            trace.SummaryMin[c] = first ? min : Math.Min(trace.SummaryMin[c], min);
+            trace.SummaryMax[c] = first ? max : Math.Max(trace.SummaryMax[c], max);
+
+            trace.Pending[c].Add(new DataPoint(t, min));
+            if (max != min)
+                trace.Pending[c].Add(new DataPoint(t, max));
+        }
+
+        // Replace the trace's recalled series with the history from `from` to
+        // `to`, which is empty if the range is all in the window.
+        private void Recall(Trace trace, double from, double to)
+        {
+            foreach (var p in trace.Recalled)
+                p.Clear();
+
+            var n = trace.History.Envelope(from, to, recalled);
+            for (int i = 0; i < n; i++)
+            {
+                var b = recalled[i];
+                var t = b.Start + (b.End - b.Start) / 2.0;
+                AddEnvelope(trace.Recalled[0], t, b.MinVoltage, b.MaxVoltage);
+                AddEnvelope(trace.Recalled[1], t, b.MinCurrent, b.MaxCurrent);
+                AddEnvelope(trace.Recalled[2], t, b.MinPower, b.MaxPower);
+            }
+        }
+
+        private static void AddEnvelope(List<DataPoint> points, double t, float min, float max)
+        {
+            points.Add(new DataPoint(t, min));
+            if (max != min)
+                points.Add(new DataPoint(t, max));
+        }
+
+        // Bring back the samples in the window from each trace's history.
+        private void Restore()
+        {
+            var minTime = lastTime - timeWindow.TotalMilliseconds * 1000;
+            foreach (var trace in traces)
+            {
+                var restored = trace.History.TakeSince(minTime);
+                if (restored.Count > 0)
+                {
+                    trace.Samples.Prepend(restored);
+                    trace.Stats.Clear();
+                    trace.Stats.Add(trace.Samples, 0);
+                }
+                Rebuild(trace);
+            }
+
+            dirty = true;
         }
 
-        private class OnlineIdentityFilter : OnlineFilter
+        // Share the history budget between the traces.
+        private void SetBudgets()
         {
-            public override double ProcessSample(double sample)
+            foreach (var trace in traces)
+                trace.History.Budget = (long)(historyMegabytes * (1 << 20) / Math.Max(traces.Count, 1));
+        }
+
+        // The data, filter state and series for one device. Filtered points
+        // collect in Pending and are moved into Points, which the series
+        // draw from, once per frame; marker steps do the same through
+        // PendingMarkers and MarkerPoints.
+        private class Trace
+        {
+            public readonly SampleBuffer Samples = new();
+            public readonly WindowStats Stats = new();
+            public readonly SampleHistory History = new();
+            public readonly List<DataPoint>[] Points = { new(), new(), new() };
+            public readonly List<DataPoint>[] Pending = { new(), new(), new() };
+            public readonly List<DataPoint>[] MarkerPoints = NewLanes();
+            public readonly List<DataPoint>[] PendingMarkers = NewLanes();
+            // History recalled for ShowRange, drawn on series of their own so
+            // that trimming the window doesn't remove it.
+            public readonly List<DataPoint>[] Recalled = { new(), new(), new() };
+            public readonly BlockFilter[] Filters = new BlockFilter[3];
+            public readonly LineSeries[] Lines;
+            public byte Markers;
+            public byte MarkersSeen;
+            // Time of the last point drawn from History's summaries, and
+            // each channel's extremes over them, for the axes.
+            public double SummaryEnd = double.NegativeInfinity;
+            public readonly float[] SummaryMin = new float[3];
+            public readonly float[] SummaryMax = new float[3];
+            private bool stale;
+            private bool markersStale;
+            // Whether the last point of each lane is the one Publish() adds to
+            // carry its level on to the latest sample.
+            private readonly bool[] tail = new bool[MarkerLanes.Count];
+
+            public Trace(string? name)
             {
-                return sample;
+                Lines = new LineSeries[]
+                {
+                    new RangedLineSeries { YAxisKey = "V", ItemsSource = Points[0], Title = name },
+                    new RangedLineSeries { YAxisKey = "A", ItemsSource = Points[1], Title = name },
+                    new RangedLineSeries { YAxisKey = "W", ItemsSource = Points[2], Title = name },
+                }.Concat(MarkerPoints.Select(p => new LineSeries { YAxisKey = "M", ItemsSource = p }))
+                .Concat(Recalled.Select((p, c) => new LineSeries { YAxisKey = new[] { "V", "A", "W" }[c], ItemsSource = p }))
+                .ToArray();
+            }
+
+            private static List<DataPoint>[] NewLanes() =>
+                Enumerable.Range(0, MarkerLanes.Count).Select(_ => new List<DataPoint>()).ToArray();
+
+            // Drop everything drawn so far at the next frame.
+            public void Discard()
+            {
+                stale = true;
+                foreach (var p in Pending)
+                    p.Clear();
+            }
+
+            public void Publish(ulong now)
+            {
+                for (int c = 0; c < Points.Length; c++)
+                {
+                    if (stale)
+                        Points[c].Clear();
+                    Points[c].AddRange(Pending[c]);
+                    Pending[c].Clear();
+                }
+                stale = false;
+
+                for (int b = 0; b < MarkerLanes.Count; b++)
+                {
+                    var p = MarkerPoints[b];
+                    if (markersStale)
+                        p.Clear();
+                    else if (tail[b])
+                        p.RemoveAt(p.Count - 1);
+                    p.AddRange(PendingMarkers[b]);
+                    PendingMarkers[b].Clear();
+
+                    tail[b] = p.Count > 0 && p[^1].X < now;
+                    if (tail[b])
+                        p.Add(new DataPoint(now, MarkerLanes.Level(b, Markers)));
+                }
+                markersStale = false;
             }
 
-            public override void Reset()
+            public void Clear()
             {
+                Samples.Clear();
+                Stats.Clear();
+                History.Clear();
+                SummaryEnd = double.NegativeInfinity;
+                Discard();
+                markersStale = true;
+                foreach (var p in PendingMarkers)
+                    p.Clear();
+                foreach (var p in Recalled)
+                    p.Clear();
+                Markers = 0;
+                MarkersSeen = 0;
+                foreach (var f in Filters)
+                    f.Reset();
             }
         }
     }
@@ -0,0 +1,17 @@
+using ReactiveUI;
+using ReactiveUI.Fody.Helpers;
+
+namespace PicovaUI.ViewModels
+{
+    // A serial port offered for capture, ticked to include it in the next run.
+    public class PortOption : ReactiveObject
+    {
+        public string Name { get; }
+        [Reactive] public bool Selected { get; set; }
+
+        public PortOption(string name)
+        {
+            Name = name;
+        }
+    }
+}
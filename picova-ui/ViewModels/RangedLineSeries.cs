@@ -0,0 +1,29 @@
+using System.Collections.Generic;
+using OxyPlot;
+using OxyPlot.Series;
+
+namespace PicovaUI.ViewModels
+{
+    // A LineSeries drawing a list of points in time order whose Y range is
+    // already known (see WindowStats), so that updating the axes doesn't scan
+    // every point on each frame. Without a range it falls back to the scan.
+    internal sealed class RangedLineSeries : LineSeries
+    {
+        public double MinimumY { get; set; } = double.NaN;
+        public double MaximumY { get; set; } = double.NaN;
+
+        protected override void UpdateMaxMin()
+        {
+            if (ItemsSource is not List<DataPoint> { Count: > 0 } points || double.IsNaN(MinimumY) || double.IsNaN(MaximumY))
+            {
+                base.UpdateMaxMin();
+                return;
+            }
+
+            MinX = points[0].X;
+            MaxX = points[^1].X;
+            MinY = MinimumY;
+            MaxY = MaximumY;
+        }
+    }
+}
@@ -0,0 +1,172 @@
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Threading;
+using OxyPlot;
+using OxyPlot.Axes;
+using OxyPlot.Series;
+using PicovaUI.IO;
+using PicovaUI.Models;
+
+namespace PicovaUI.ViewModels
+{
+    // Offline view of a recording of any length. Rather than handing every
+    // sample to OxyPlot, each pan or zoom asks the LodPyramid for one min/max
+    // bucket per horizontal pixel of the visible range. Opening a CSV file or
+    // a recording without a cache does the import and the build before it
+    // returns, so it is meant to be constructed off the UI thread; progress
+    // runs from 0 to 1 for each of those steps that is needed.
+    public class RecordingPlotViewModel : ViewModelBase, IDisposable
+    {
+        private const int maxPixels = 4096;
+
+        private readonly Recording recording;
+        private readonly LodPyramid pyramid;
+        private readonly MinMaxBucket[] buckets = new MinMaxBucket[maxPixels];
+        private readonly LinearAxis tAxis;
+        private readonly LineSeries vLine;
+        private readonly LineSeries aLine;
+        private readonly LineSeries wLine;
+        private readonly LineSeries[] markerLines = new LineSeries[MarkerLanes.Count];
+        private readonly byte markersSeen;
+
+        public PlotModel Plot { get; }
+        public string Name => Path.GetFileName(recording.Path);
+        public long Count => recording.Count;
+
+        public RecordingPlotViewModel(string path, IProgress<double>? progress = null, CancellationToken cancel = default)
+        {
+            recording = Recording.Open(path, progress, cancel);
+            try
+            {
+                pyramid = LodPyramid.Open(recording, progress, cancel);
+            }
+            catch
+            {
+                recording.Dispose();
+                throw;
+            }
+
+            var vAxis = new LinearAxis
+            {
+                Title = "Voltage [V]",
+                Key = "V",
+                StartPosition = 0.68,
+                EndPosition = 1.0,
+            };
+
+            var aAxis = new LinearAxis
+            {
+                Title = "Current [mA]",
+                Key = "A",
+                StartPosition = 0.34,
+                EndPosition = 0.66,
+            };
+
+            var wAxis = new LinearAxis
+            {
+                Title = "Power [mW]",
+                Key = "W",
+                StartPosition = 0,
+                EndPosition = 0.32,
+            };
+
+            tAxis = new LinearAxis
+            {
+                Title = "Time [µs]",
+                Key = "T",
+                Position = AxisPosition.Bottom,
+            };
+
+            if (recording.EndTime > recording.StartTime)
+            {
+                tAxis.AbsoluteMinimum = recording.StartTime;
+                tAxis.AbsoluteMaximum = recording.EndTime;
+            }
+
+            vLine = new LineSeries { YAxisKey = "V" };
+            aLine = new LineSeries { YAxisKey = "A" };
+            wLine = new LineSeries { YAxisKey = "W" };
+
+            Plot = new PlotModel { Title = Name };
+
+            Plot.Axes.Add(vAxis);
+            Plot.Axes.Add(aAxis);
+            Plot.Axes.Add(wAxis);
+            Plot.Axes.Add(tAxis);
+            Plot.Axes.Add(MarkerLanes.CreateAxis());
+
+            Plot.Series.Add(vLine);
+            Plot.Series.Add(aLine);
+            Plot.Series.Add(wLine);
+
+            for (int b = 0; b < markerLines.Length; b++)
+            {
+                markerLines[b] = new LineSeries { YAxisKey = "M" };
+                Plot.Series.Add(markerLines[b]);
+            }
+
+            // Only make room for the inputs that were ever high.
+            var whole = new MinMaxBucket[1];
+            if (pyramid.Query(recording.StartTime, recording.EndTime, whole) > 0)
+                markersSeen = whole[0].MarkersAny;
+            MarkerLanes.Layout(Plot, MarkerLanes.LanesFor(markersSeen));
+
+            tAxis.AxisChanged += (_, e) =>
+            {
+                if (e.ChangeType == AxisChangeTypes.Reset)
+                    Reload(recording.StartTime, recording.EndTime);
+                else
+                    Reload((long)tAxis.ActualMinimum, (long)tAxis.ActualMaximum);
+            };
+
+            Reload(recording.StartTime, recording.EndTime);
+        }
+
+        public void Dispose()
+        {
+            pyramid.Dispose();
+            recording.Dispose();
+        }
+
+        private void Reload(long start, long end)
+        {
+            var width = Plot.PlotArea.Width;
+            var pixels = width >= 1 ? (int)Math.Min(width, maxPixels) : maxPixels / 2;
+            var n = pyramid.Query(start, end, buckets.AsSpan(0, pixels));
+
+            vLine.Points.Clear();
+            aLine.Points.Clear();
+            wLine.Points.Clear();
+            foreach (var line in markerLines)
+                line.Points.Clear();
+
+            for (int i = 0; i < n; i++)
+            {
+                ref readonly var b = ref buckets[i];
+                var t = b.Start + (b.End - b.Start) / 2;
+                AddEnvelope(vLine.Points, t, b.MinVoltage, b.MaxVoltage);
+                AddEnvelope(aLine.Points, t, b.MinCurrent, b.MaxCurrent);
+                AddEnvelope(wLine.Points, t, b.MinPower, b.MaxPower);
+
+                // A lane spans both levels where its input changed within
+                // the bucket.
+                for (int k = 0; k < markerLines.Length; k++)
+                {
+                    if (((markersSeen >> k) & 1) != 0)
+                        AddEnvelope(markerLines[k].Points, t,
+                            (float)MarkerLanes.Level(k, b.MarkersAll), (float)MarkerLanes.Level(k, b.MarkersAny));
+                }
+            }
+
+            Plot.InvalidatePlot(true);
+        }
+
+        private static void AddEnvelope(List<DataPoint> points, double t, float min, float max)
+        {
+            points.Add(new DataPoint(t, min));
+            if (max != min)
+                points.Add(new DataPoint(t, max));
+        }
+    }
+}
@@ -0,0 +1,248 @@
+using System;
+using System.Collections.Generic;
+using OxyPlot;
+using OxyPlot.Axes;
+using OxyPlot.Series;
+using PicovaUI.Filters;
+using PicovaUI.Models;
+
+namespace PicovaUI.ViewModels
+{
+    // Live ripple spectrum of the voltage and current, shown next to the
+    // live plot. Measurements are resampled onto a uniform grid at the
+    // stream's measured rate, since the device's timestamps jitter, and fed
+    // to a SpectrumEstimator per channel.
+    public class SpectrumViewModel : ViewModelBase
+    {
+        // A jump in the rate or a gap in the data starts a new spectrum.
+        private const double rateTolerance = 0.2;
+        private const int maxGapSamples = 10;
+        // Batches follow USB transfers and can be only a few samples long, so
+        // the rate is measured over at least this long.
+        private const ulong rateWindowUs = 100_000;
+
+        private readonly SpectrumEstimator vSpectrum = new();
+        private readonly SpectrumEstimator aSpectrum = new();
+        private readonly LineSeries vLine;
+        private readonly LineSeries aLine;
+        private float[] vSamples = Array.Empty<float>();
+        private float[] aSamples = Array.Empty<float>();
+        private double sampleRate;
+        private double nextTime;
+        private bool haveLast;
+        private ulong lastTime;
+        private float lastVoltage;
+        private float lastCurrent;
+        private ulong rateStart;
+        private long rateCount = -1;
+        // Guards the estimators; the series are only touched in Redraw().
+        private readonly object dataLock = new();
+        private bool dirty;
+
+        public PlotModel Plot { get; }
+
+        public SpectrumViewModel()
+        {
+            var vAxis = new LogarithmicAxis
+            {
+                Title = "Voltage [V]",
+                Key = "V",
+                StartPosition = 0.52,
+                EndPosition = 1.0,
+            };
+
+            var aAxis = new LogarithmicAxis
+            {
+                Title = "Current [mA]",
+                Key = "A",
+                StartPosition = 0,
+                EndPosition = 0.48,
+            };
+
+            var fAxis = new LogarithmicAxis
+            {
+                Title = "Frequency [Hz]",
+                Key = "F",
+                Position = AxisPosition.Bottom,
+            };
+
+            vLine = new LineSeries { YAxisKey = "V" };
+            aLine = new LineSeries { YAxisKey = "A" };
+
+            Plot = new PlotModel();
+
+            Plot.Axes.Add(vAxis);
+            Plot.Axes.Add(aAxis);
+            Plot.Axes.Add(fAxis);
+
+            Plot.Series.Add(vLine);
+            Plot.Series.Add(aLine);
+        }
+
+        public void Clear()
+        {
+            lock (dataLock)
+            {
+                Restart(0);
+                haveLast = false;
+                rateCount = -1;
+            }
+        }
+
+        // Copy the latest estimates into the series. Call on the UI thread;
+        // returns false if nothing changed since the last frame.
+        public bool Redraw()
+        {
+            lock (Plot.SyncRoot)
+            {
+                lock (dataLock)
+                {
+                    if (!dirty)
+                        return false;
+                    dirty = false;
+
+                    UpdatePoints(vLine.Points, vSpectrum);
+                    UpdatePoints(aLine.Points, aSpectrum);
+                }
+            }
+
+            Plot.InvalidatePlot(true);
+            return true;
+        }
+
+        public void AddBatch(MeasurementBatch batch)
+        {
+            if (batch.Count == 0)
+                return;
+
+            lock (dataLock)
+            {
+                CheckRate(batch);
+
+                var n = Resample(batch);
+                dirty |= vSpectrum.Add(vSamples.AsSpan(0, n));
+                dirty |= aSpectrum.Add(aSamples.AsSpan(0, n));
+            }
+        }
+
+        private void Restart(double rate)
+        {
+            sampleRate = rate;
+            vSpectrum.Reset();
+            aSpectrum.Reset();
+            dirty = true;
+        }
+
+        // Estimate the sample rate over the last rate window and start over
+        // if it has moved, e.g. because the firmware changed its ADC settings.
+        private void CheckRate(MeasurementBatch batch)
+        {
+            var timestamps = batch.Timestamps;
+
+            // The first sample of the first batch opens the window.
+            if (rateCount < 0)
+                rateStart = timestamps[0];
+            rateCount += batch.Count;
+
+            var span = timestamps[^1] - rateStart;
+            if (span < rateWindowUs)
+                return;
+
+            var rate = rateCount * 1e6 / span;
+            rateStart = timestamps[^1];
+            rateCount = 0;
+
+            if (sampleRate == 0 || Math.Abs(rate / sampleRate - 1) > rateTolerance)
+            {
+                Restart(rate);
+                haveLast = false;
+            }
+        }
+
+        // Linearly interpolate the batch onto the uniform grid. Returns the
+        // number of grid samples produced.
+        private int Resample(MeasurementBatch batch)
+        {
+            if (sampleRate == 0)
+                return 0;
+
+            var period = 1e6 / sampleRate;
+            var timestamps = batch.Timestamps;
+            var voltages = batch.Voltages;
+            var currents = batch.Currents;
+
+            // Room for every grid point up to the last sample. A longer gap
+            // than maxGapSamples restarts the grid, so none of the intervals
+            // can hold more than maxGapSamples + 1 points however far apart
+            // the timestamps are.
+            var start = haveLast ? nextTime : timestamps[0];
+            var span = Math.Max(timestamps[^1] - start, 0);
+            var capacity = (int)Math.Min(span / period + 2, (maxGapSamples + 1.0) * timestamps.Length + 2);
+            if (vSamples.Length < capacity)
+            {
+                vSamples = new float[capacity];
+                aSamples = new float[capacity];
+            }
+
+            int n = 0;
+            for (int i = 0; i < timestamps.Length; i++)
+            {
+                var t = timestamps[i];
+
+                if (!haveLast)
+                {
+                    SetLast(t, voltages[i], currents[i]);
+                    nextTime = t;
+                    continue;
+                }
+
+                if (t <= lastTime)
+                    continue;
+
+                double dt = t - lastTime;
+                if (dt > maxGapSamples * period)
+                {
+                    Restart(sampleRate);
+                    SetLast(t, voltages[i], currents[i]);
+                    nextTime = t;
+                    n = 0;
+                    continue;
+                }
+
+                for (; nextTime <= t && n < vSamples.Length; nextTime += period, n++)
+                {
+                    var frac = (float)((nextTime - lastTime) / dt);
+                    vSamples[n] = lastVoltage + frac * (voltages[i] - lastVoltage);
+                    aSamples[n] = lastCurrent + frac * (currents[i] - lastCurrent);
+                }
+
+                SetLast(t, voltages[i], currents[i]);
+            }
+
+            return n;
+        }
+
+        private void SetLast(ulong time, float voltage, float current)
+        {
+            haveLast = true;
+            lastTime = time;
+            lastVoltage = voltage;
+            lastCurrent = current;
+        }
+
+        // Skip DC, which a log frequency axis can't show anyway. An estimator
+        // that has just been restarted has no spectrum to show yet.
+        private void UpdatePoints(List<DataPoint> points, SpectrumEstimator spectrum)
+        {
+            var amplitude = spectrum.Amplitude;
+            var binHz = sampleRate / spectrum.Length;
+
+            points.Clear();
+            if (spectrum.Segments == 0)
+                return;
+
+            for (int k = 1; k < amplitude.Length; k++)
+                points.Add(new DataPoint(k * binHz, Math.Max(amplitude[k], 1e-9)));
+        }
+    }
+}
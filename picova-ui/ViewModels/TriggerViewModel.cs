@@ -0,0 +1,213 @@
+using System;
+using System.Collections.Generic;
+using System.Collections.ObjectModel;
+using System.Globalization;
+using System.IO;
+using System.Reactive;
+using System.Reactive.Linq;
+using OxyPlot;
+using OxyPlot.Annotations;
+using OxyPlot.Axes;
+using OxyPlot.Series;
+using PicovaUI.Filters;
+using PicovaUI.Models;
+using ReactiveUI;
+using ReactiveUI.Fody.Helpers;
+
+namespace PicovaUI.ViewModels
+{
+    // Scope-style triggering on the live stream. The trigger runs on the
+    // reader's batches off the UI thread; finished captures are queued and
+    // moved into the history list on each redraw, and the selected one is
+    // drawn around its trigger point.
+    public class TriggerViewModel : ViewModelBase
+    {
+        // Oldest captures are dropped beyond this many.
+        private const int maxCaptures = 100;
+        // Points per channel when drawing a capture; longer ones are drawn
+        // as a min/max envelope.
+        private const int maxPoints = 4000;
+
+        private readonly Trigger trigger = new();
+        private readonly List<Capture> pending = new();
+        private readonly LineSeries[] lines = new LineSeries[3];
+
+        public IReadOnlyList<string> Channels { get; } = new[] { "Voltage", "Current", "Power" };
+        public ReadOnlyCollection<TriggerMode> Modes => new(Enum.GetValues<TriggerMode>());
+        [Reactive] public int Channel { get; set; } = 1;
+        [Reactive] public TriggerMode Mode { get; set; }
+        // In the channel's unit.
+        [Reactive] public double Level { get; set; } = 10;
+        [Reactive] public double Hysteresis { get; set; } = 1;
+        // Pulse width and the spans either side of the trigger, in ms.
+        [Reactive] public double Width { get; set; } = 1;
+        [Reactive] public double Pre { get; set; } = 10;
+        [Reactive] public double Post { get; set; } = 40;
+        [Reactive] public bool Single { get; set; }
+        [Reactive] public bool Armed { get; private set; } = true;
+        [Reactive] public string Summary { get; private set; } = string.Empty;
+
+        public ObservableCollection<Capture> Captures { get; } = new();
+        [Reactive] public Capture? SelectedCapture { get; set; }
+        public PlotModel Plot { get; }
+        public ReactiveCommand<Unit, Unit> Arm { get; }
+        public ReactiveCommand<Unit, Unit> Export { get; }
+
+        public TriggerViewModel()
+        {
+            Plot = new PlotModel();
+            var keys = new[] { "V", "A", "W" };
+            var titles = new[] { "Voltage [V]", "Current [mA]", "Power [mW]" };
+            for (int c = 0; c < 3; c++)
+            {
+                Plot.Axes.Add(new LinearAxis
+                {
+                    Title = titles[c],
+                    Key = keys[c],
+                    StartPosition = 0.68 - c * 0.34,
+                    EndPosition = 1.0 - c * 0.34,
+                });
+                lines[c] = new LineSeries { YAxisKey = keys[c] };
+                Plot.Series.Add(lines[c]);
+            }
+            Plot.Axes.Add(new LinearAxis
+            {
+                Title = "Time from trigger [ms]",
+                Position = AxisPosition.Bottom,
+            });
+            Plot.Annotations.Add(new LineAnnotation { Type = LineAnnotationType.Vertical, X = 0, Color = OxyColors.Red });
+
+            Arm = ReactiveCommand.Create(() =>
+            {
+                lock (pending)
+                    trigger.Armed = true;
+                Armed = true;
+                UpdateSummary();
+            });
+            Export = ReactiveCommand.Create(DoExport, this.WhenAnyValue(vm => vm.SelectedCapture).Select(c => c != null));
+
+            this.WhenAnyValue(vm => vm.Channel, vm => vm.Mode, vm => vm.Level, vm => vm.Hysteresis)
+                .Subscribe(_ => Configure());
+            this.WhenAnyValue(vm => vm.Width, vm => vm.Pre, vm => vm.Post, vm => vm.Single)
+                .Subscribe(_ => Configure());
+
+            this.WhenAnyValue(vm => vm.SelectedCapture)
+                .Subscribe(Show);
+
+            UpdateSummary();
+        }
+
+        public void AddBatch(MeasurementBatch batch)
+        {
+            lock (pending)
+                trigger.Process(batch, pending);
+        }
+
+        // Move newly finished captures into the history. Call on the UI
+        // thread.
+        public void Flush()
+        {
+            lock (pending)
+            {
+                if (pending.Count == 0)
+                    return;
+
+                foreach (var c in pending)
+                    Captures.Insert(0, c);
+                pending.Clear();
+                Armed = trigger.Armed;
+            }
+
+            while (Captures.Count > maxCaptures)
+                Captures.RemoveAt(Captures.Count - 1);
+
+            UpdateSummary();
+        }
+
+        public void Clear()
+        {
+            lock (pending)
+            {
+                trigger.Reset();
+                pending.Clear();
+            }
+
+            Captures.Clear();
+            UpdateSummary();
+        }
+
+        private void Configure()
+        {
+            lock (pending)
+            {
+                trigger.Channel = Channel;
+                trigger.Mode = Mode;
+                trigger.Level = (float)Level;
+                trigger.Hysteresis = (float)Math.Max(Hysteresis, 0);
+                trigger.Width = (ulong)Math.Max(Width * 1000, 0);
+                trigger.Pre = (ulong)Math.Max(Pre * 1000, 0);
+                trigger.Post = (ulong)Math.Max(Post * 1000, 0);
+                trigger.Single = Single;
+                trigger.Restart();
+            }
+        }
+
+        private void UpdateSummary()
+        {
+            Summary = $"{Captures.Count} captures, " + (Armed ? "armed" : "stopped");
+        }
+
+        // Draw a capture with its time axis relative to the trigger.
+        private void Show(Capture? capture)
+        {
+            foreach (var line in lines)
+                line.Points.Clear();
+
+            if (capture != null)
+            {
+                var samples = capture.Samples;
+                var timestamps = samples.Timestamps;
+                var step = Math.Max((samples.Count + maxPoints - 1) / maxPoints, 1);
+                for (int c = 0; c < 3; c++)
+                {
+                    var values = samples.Channel(c);
+                    for (int i = 0; i < samples.Count; i += step)
+                    {
+                        var end = Math.Min(i + step, samples.Count);
+                        var t = ((double)timestamps[i] - capture.Time) / 1000;
+                        var bucket = values[i..end];
+                        var min = bucket[0];
+                        var max = bucket[0];
+                        foreach (var v in bucket)
+                        {
+                            min = Math.Min(min, v);
+                            max = Math.Max(max, v);
+                        }
+                        lines[c].Points.Add(new DataPoint(t, min));
+                        if (max != min)
+                            lines[c].Points.Add(new DataPoint(t, max));
+                    }
+                }
+            }
+
+            Plot.ResetAllAxes();
+            Plot.InvalidatePlot(true);
+        }
+
+        private void DoExport()
+        {
+            if (SelectedCapture is not { } capture)
+                return;
+
+            var dst = Path.Combine(Environment.CurrentDirectory, $"PicoVA-capture-{DateTime.Now:yyyyMMdd-HHmmss}-{capture.Index}.csv");
+            using var file = new StreamWriter(dst);
+            file.WriteLine("us,V,mA,mW,markers");
+            for (int i = 0; i < capture.Samples.Count; i++)
+            {
+                var m = capture.Samples[i];
+                file.WriteLine(string.Create(CultureInfo.InvariantCulture,
+                    $"{m.Timestamp},{m.Voltage},{m.Current},{m.Power},{m.Markers}"));
+            }
+        }
+    }
+}
@@ -1,4 +1,8 @@
+using System;
+using System.Collections.Generic;
+using System.Linq;
 using Avalonia.Controls;
+using PicovaUI.ViewModels;
 
 namespace PicovaUI.Views
 {
@@ -8,5 +12,29 @@ namespace PicovaUI.Views
         {
             InitializeComponent();
         }
+
+        protected override void OnDataContextChanged(EventArgs e)
+        {
+            base.OnDataContextChanged(e);
+
+            if (DataContext is MainWindowViewModel vm)
+            {
+                vm.ChooseRecording.RegisterHandler(async ctx =>
+                {
+                    var dialog = new OpenFileDialog
+                    {
+                        Title = "Open recording",
+                        AllowMultiple = false,
+                        Filters = new List<FileDialogFilter>
+                        {
+                            new() { Name = "PicoVA recordings", Extensions = { "csv", "pvr" } },
+                        },
+                    };
+
+                    var paths = await dialog.ShowAsync(this);
+                    ctx.SetOutput(paths?.FirstOrDefault());
+                });
+            }
+        }
     }
-}
\ No newline at end of file
+}
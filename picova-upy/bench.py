@@ -0,0 +1,72 @@
+"""Compare the CSV loop in main.py with the fast path in fast.py.
+
+Copy ina219.py and fast.py to the board, then run this from the host with
+`mpremote run picova-upy/bench.py`. Output goes to a sink that discards it,
+so the numbers leave out USB; both paths read an INA219 at 9-bit resolution
+so that the ADC isn't the limit.
+"""
+import io
+import time
+
+from machine import I2C
+
+from fast import Sampler
+from ina219 import INA219, DeviceRangeError
+
+SECONDS = 5
+
+
+class Discard(io.IOBase):
+    def __init__(self):
+        self.bytes = 0
+
+    def write(self, data):
+        self.bytes += len(data)
+        return len(data)
+
+
+def configure(freq):
+    ina = INA219(shunt_ohms=0.1, i2c=I2C(0, freq=freq))
+    ina.configure(voltage_range=INA219.RANGE_16V,
+                  bus_adc=INA219.ADC_9BIT, shunt_adc=INA219.ADC_9BIT)
+    return ina
+
+
+def report(name, samples, out):
+    print('%-20s %8.1f samples/s %6.1f B/sample' % (
+        name, samples / SECONDS, out.bytes / max(samples, 1)))
+
+
+def csv_loop(freq):
+    ina = configure(freq)
+    out = Discard()
+    samples = 0
+    start = time.ticks_ms()
+    while time.ticks_diff(time.ticks_ms(), start) < SECONDS * 1000:
+        try:
+            ina.update()
+            print(time.ticks_us(), ina.voltage(), ina.current(), ina.power(),
+                  sep=',', file=out)
+            samples += 1
+        except DeviceRangeError:
+            pass
+    report('csv %d kHz' % (freq // 1000), samples, out)
+
+
+def fast(freq, threaded):
+    sampler = Sampler(configure(freq))
+    out = Discard()
+    if threaded:
+        sampler.run_threaded(out, SECONDS)
+    else:
+        sampler.run(out, SECONDS)
+    report('fast%s %d kHz' % (' 2-core' if threaded else '', freq // 1000),
+           sampler.samples, out)
+
+
+# Conversions at 9-bit take 168 us, so the INA219 itself tops out at 5952/s.
+csv_loop(400_000)
+csv_loop(1_000_000)
+fast(400_000, False)
+fast(1_000_000, False)
+fast(1_000_000, True)
@@ -0,0 +1,197 @@
+"""Fast acquisition path for the MicroPython port.
+
+Reads the INA219 registers straight into a preallocated buffer and packs
+them into the binary frames of picova-c/picova_stream.h, so that nothing is
+formatted or allocated per sample and the host converts the raw registers
+itself. Frames are written out a batch at a time, optionally with
+acquisition running on the second core.
+"""
+import _thread
+import struct
+import time
+from array import array
+
+import micropython
+from micropython import const
+
+from ina219 import DeviceRangeError
+
+_SYNC = const(0xA5)
+_SAMPLE = const(1)
+_CAL = const(2)
+_SAMPLE_LEN = const(14)
+_CAL_LEN = const(12)
+
+_REG_BUS = const(2)
+_REG_POWER = const(3)
+_REG_CURRENT = const(4)
+
+# Low word of the RP2040's free-running microsecond timer, as used for the C
+# firmware's timestamps.
+_TIMERAWL = const(0x40054028)
+
+
+@micropython.viper
+def _seal(out: ptr8, at: int, length: int, kind: int, epoch: int):
+    out[at] = _SYNC
+    out[at + 1] = kind
+    out[at + 2] = epoch
+    out[at + 3] = 0
+    check = 0
+    i = at
+    end = at + length
+    while i < end:
+        check ^= out[i]
+        i += 1
+    out[at + 3] = check
+
+
+@micropython.viper
+def _sample(out: ptr8, at: int, epoch: int, regs: ptr8) -> int:
+    t = ptr32(_TIMERAWL)[0]
+    out[at] = _SYNC
+    out[at + 1] = _SAMPLE
+    out[at + 2] = epoch
+    out[at + 4] = t
+    out[at + 5] = t >> 8
+    out[at + 6] = t >> 16
+    out[at + 7] = t >> 24
+    # The registers arrive big-endian (bus, current, power) and the frame
+    # is little-endian.
+    out[at + 8] = regs[1]
+    out[at + 9] = regs[0]
+    out[at + 10] = regs[3]
+    out[at + 11] = regs[2]
+    out[at + 12] = regs[5]
+    out[at + 13] = regs[4]
+    check = _SYNC ^ _SAMPLE ^ epoch
+    i = at + 4
+    end = at + _SAMPLE_LEN
+    while i < end:
+        check ^= out[i]
+        i += 1
+    out[at + 3] = check
+    return end
+
+
+class Sampler:
+    """Streams an INA219 as picova binary frames.
+
+    Each batch starts with a calibration frame, so that a host can join at
+    any point, followed by up to `batch` sample frames. A sample is taken
+    each time the bus register shows a new conversion (CNVR), and reading
+    POWER last clears it again. On an overflow the shunt range is increased
+    and the batch ends, so the next one starts with the new calibration.
+    """
+
+    def __init__(self, ina, batch=64):
+        self._ina = ina
+        self._batch = batch
+        self._epoch = 0
+        self._regs = bytearray(6)
+        regs = memoryview(self._regs)
+        self._bus = regs[0:2]
+        self._current = regs[2:4]
+        self._power = regs[4:6]
+        size = _CAL_LEN + batch * _SAMPLE_LEN
+        self._bufs = (bytearray(size), bytearray(size))
+        self._lens = array('I', (0, 0))
+        self._stop = False
+        self._stopped = False
+        self.samples = 0
+        self.ranged = 0
+        self.overruns = 0
+
+    @micropython.native
+    def fill(self, buf):
+        """Fill `buf` with one batch and return its length in bytes."""
+        read = self._ina._i2c.readfrom_mem_into
+        addr = self._ina._address
+        regs = self._regs
+        bus = self._bus
+        current = self._current
+        power = self._power
+        epoch = self._epoch
+
+        struct.pack_into('<ff', buf, 4, self._ina._current_lsb, self._ina._power_lsb)
+        _seal(buf, 0, _CAL_LEN, _CAL, epoch)
+        n = _CAL_LEN
+
+        for _ in range(self._batch):
+            read(addr, _REG_BUS, bus)
+            while not regs[1] & 2:
+                read(addr, _REG_BUS, bus)
+
+            if regs[1] & 1:
+                if self._range_up():
+                    break
+                continue
+
+            read(addr, _REG_CURRENT, current)
+            read(addr, _REG_POWER, power)
+            n = _sample(buf, n, epoch, regs)
+
+        self.samples += (n - _CAL_LEN) // _SAMPLE_LEN
+        return n
+
+    def _range_up(self):
+        # At the largest range, or with a fixed gain, the sample is dropped.
+        if not self._ina._auto_gain_enabled:
+            return False
+        try:
+            self._ina._increase_gain()
+        except DeviceRangeError:
+            return False
+        self._epoch = (self._epoch + 1) & 0xFF
+        self.ranged += 1
+        return True
+
+    def run(self, out, seconds=0):
+        """Acquire and write to `out` on this core, for `seconds` or forever."""
+        buf = self._bufs[0]
+        view = memoryview(buf)
+        start = time.ticks_ms()
+        while not seconds or time.ticks_diff(time.ticks_ms(), start) < seconds * 1000:
+            out.write(view[:self.fill(buf)])
+
+    def run_threaded(self, out, seconds=0):
+        """As run(), but acquire on the second core while this one writes.
+
+        The two buffers are handed over through their lengths: the
+        acquiring core only fills a buffer whose length is 0, and this core
+        zeroes it once written. If writing falls behind, acquisition waits
+        and counts an overrun.
+        """
+        lens = self._lens
+        views = (memoryview(self._bufs[0]), memoryview(self._bufs[1]))
+        lens[0] = lens[1] = 0
+        self._stop = self._stopped = False
+        _thread.start_new_thread(self._acquire, ())
+
+        i = 0
+        start = time.ticks_ms()
+        try:
+            while not seconds or time.ticks_diff(time.ticks_ms(), start) < seconds * 1000:
+                n = lens[i]
+                if n:
+                    out.write(views[i][:n])
+                    lens[i] = 0
+                    i ^= 1
+        finally:
+            self._stop = True
+            while not self._stopped:
+                pass
+
+    def _acquire(self):
+        lens = self._lens
+        bufs = self._bufs
+        i = 0
+        while not self._stop:
+            if lens[i]:
+                self.overruns += 1
+                while lens[i] and not self._stop:
+                    pass
+                continue
+            lens[i] = self.fill(bufs[i])
+            i ^= 1
+        self._stopped = True
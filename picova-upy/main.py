@@ -1,8 +1,31 @@
 from ina219 import INA219, DeviceRangeError
 from machine import I2C, Pin
+import sys
 import time
 
+# Set FAST to stream binary frames through fast.py rather than printing a
+# CSV line per sample, optionally acquiring on the second core. The host
+# tools accept either. The fast path has not been benchmarked on hardware
+# yet (see bench.py).
+FAST = False
+THREADED = True
+
 led = Pin(25, Pin.OUT, value=1)
+
+if FAST:
+    from fast import Sampler
+
+    # The same I2C clock and ADC settings as the C firmware.
+    i2c = I2C(0, freq=1_000_000)
+    ina = INA219(shunt_ohms=0.1, i2c=i2c)
+    ina.configure(voltage_range=INA219.RANGE_16V,
+                  bus_adc=INA219.ADC_9BIT, shunt_adc=INA219.ADC_11BIT)
+    sampler = Sampler(ina)
+    if THREADED:
+        sampler.run_threaded(sys.stdout.buffer)
+    else:
+        sampler.run(sys.stdout.buffer)
+
 i2c = I2C(0, freq=400_000)
 ina = INA219(shunt_ohms=0.1, i2c=i2c)
 ina.configure()
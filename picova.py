@@ -0,0 +1,130 @@
+"""ctypes/numpy bindings for libpicova, the shared PicoVA stream decoder.
+
+Build the library with CMake from picova-host/ first. It is looked up in
+$PICOVA_LIB, then picova-host/build/, then on the system library path.
+"""
+import ctypes
+import ctypes.util
+import os
+from pathlib import Path
+
+import numpy as np
+from numpy.ctypeslib import ndpointer
+
+
+class Counters(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint64) for name in (
+        'bytes', 'samples', 'lines', 'frames',
+        'bad_lines', 'bad_frames', 'no_cal', 'wraps', 'held_bus',
+        'status_lines', 'markers', 'lost_markers',
+    )]
+
+    def as_dict(self):
+        return {name: getattr(self, name) for name, _ in self._fields_}
+
+
+def _load():
+    candidates = [os.environ.get('PICOVA_LIB')]
+    build = Path(__file__).resolve().parent / 'picova-host' / 'build'
+    candidates += [str(build / name) for name in ('libpicova.so', 'libpicova.dylib', 'picova.dll')]
+    candidates.append(ctypes.util.find_library('picova'))
+
+    for path in filter(None, candidates):
+        try:
+            lib = ctypes.CDLL(path)
+            break
+        except OSError:
+            continue
+    else:
+        raise OSError('libpicova not found; build picova-host or set PICOVA_LIB')
+
+    u64 = ndpointer(np.uint64, flags='C_CONTIGUOUS')
+    f32 = ndpointer(np.float32, flags='C_CONTIGUOUS')
+    u8 = ndpointer(np.uint8, flags='C_CONTIGUOUS')
+
+    lib.picova_decoder_new.restype = ctypes.c_void_p
+    lib.picova_decoder_new.argtypes = []
+    lib.picova_decoder_free.restype = None
+    lib.picova_decoder_free.argtypes = [ctypes.c_void_p]
+    lib.picova_decoder_reset.restype = None
+    lib.picova_decoder_reset.argtypes = [ctypes.c_void_p]
+    lib.picova_decode.restype = ctypes.c_size_t
+    lib.picova_decode.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_size_t),
+        u64, f32, f32, f32, u8, ctypes.c_size_t,
+    ]
+    lib.picova_read_markers.restype = ctypes.c_size_t
+    lib.picova_read_markers.argtypes = [ctypes.c_void_p, u64, u8, ctypes.c_size_t]
+    lib.picova_get_counters.restype = None
+    lib.picova_get_counters.argtypes = [ctypes.c_void_p, ctypes.POINTER(Counters)]
+    return lib
+
+
+_lib = None
+
+
+class Decoder:
+    """Incremental decoder for the PicoVA measurement stream.
+
+    Feed it chunks of bytes as they arrive; it returns the complete samples
+    as numpy columns and keeps any partial line or frame for the next call.
+    """
+
+    def __init__(self, capacity: int = 1 << 16):
+        global _lib
+        if _lib is None:
+            _lib = _load()
+
+        self._dec = _lib.picova_decoder_new()
+        if not self._dec:
+            raise MemoryError()
+
+        self.timestamp_us = np.empty(capacity, np.uint64)
+        self.bus_V = np.empty(capacity, np.float32)
+        self.current_mA = np.empty(capacity, np.float32)
+        self.power_mW = np.empty(capacity, np.float32)
+        self.markers = np.empty(capacity, np.uint8)
+
+    def __del__(self):
+        if getattr(self, '_dec', None):
+            _lib.picova_decoder_free(self._dec)
+            self._dec = None
+
+    def reset(self):
+        _lib.picova_decoder_reset(self._dec)
+
+    def decode(self, data: bytes):
+        """Decode `data` and return (timestamp_us, V, mA, mW, markers) arrays."""
+        capacity = len(self.timestamp_us)
+        consumed = ctypes.c_size_t()
+        parts = []
+
+        while True:
+            n = _lib.picova_decode(self._dec, data, len(data), ctypes.byref(consumed),
+                                   self.timestamp_us, self.bus_V, self.current_mA,
+                                   self.power_mW, self.markers, capacity)
+            parts.append((self.timestamp_us[:n].copy(), self.bus_V[:n].copy(),
+                          self.current_mA[:n].copy(), self.power_mW[:n].copy(),
+                          self.markers[:n].copy()))
+            data = data[consumed.value:]
+            if not data:
+                break
+
+        if len(parts) == 1:
+            return parts[0]
+        return tuple(np.concatenate(cols) for cols in zip(*parts))
+
+    def read_markers(self):
+        """Return (timestamp_us, markers) arrays of the marker changes
+        decoded since the last call."""
+        capacity = len(self.timestamp_us)
+        timestamp_us = np.empty(capacity, np.uint64)
+        markers = np.empty(capacity, np.uint8)
+        n = _lib.picova_read_markers(self._dec, timestamp_us, markers, capacity)
+        return timestamp_us[:n], markers[:n]
+
+    @property
+    def counters(self) -> dict:
+        counters = Counters()
+        _lib.picova_get_counters(self._dec, ctypes.byref(counters))
+        return counters.as_dict()
@@ -1,78 +1,150 @@
+import select
+import socket
 import sys
 from queue import Empty, Queue
 
 import matplotlib.pyplot as plt
 import numpy as np
-from matplotlib.animation import FuncAnimation
 from matplotlib.figure import Figure
 from serial import Serial
-from serial.threaded import LineReader, ReaderThread
+from serial.threaded import Protocol, ReaderThread
+from serial.urlhandler import protocol_socket
 
+from picova import Decoder
 
-class SerialReader(LineReader):
+
+class ServerSocket(protocol_socket.Serial):
+    """A picova-server at "socket://HOST:PORT", opened like a serial port.
+
+    pyserial's socket:// reports at most one byte waiting, which would have
+    ReaderThread read a byte at a time, so peek at what has actually arrived.
+    """
+
+    @property
+    def in_waiting(self):
+        readable, _, _ = select.select([self._socket], [], [], 0)
+        return len(self._socket.recv(1 << 16, socket.MSG_PEEK)) if readable else 0
+
+
+class SerialReader(Protocol):
     def __init__(self, queue: Queue):
         super().__init__()
         self.queue = queue
 
-    def handle_line(self, line):
-        self.queue.put(line)
+    def data_received(self, data):
+        self.queue.put(data)
+
+
+class RingBuffer:
+    """Fixed-capacity FIFO of samples with one row per channel.
+
+    Every sample is stored twice, `capacity` columns apart, so the most recent
+    samples are always available as a single contiguous view without copying.
+    """
+
+    def __init__(self, channels: int, capacity: int):
+        self.capacity = capacity
+        self.data = np.zeros((channels, 2 * capacity))
+        self.head = 0
+        self.size = 0
+
+    def extend(self, rows: np.ndarray):
+        n = rows.shape[1]
+        if n > self.capacity:
+            rows = rows[:, -self.capacity:]
+            n = self.capacity
+
+        idx = (self.head + self.size + np.arange(n)) % self.capacity
+        self.data[:, idx] = rows
+        self.data[:, idx + self.capacity] = rows
+
+        total = self.size + n
+        if total > self.capacity:
+            self.head = (self.head + total - self.capacity) % self.capacity
+            self.size = self.capacity
+        else:
+            self.size = total
+
+    def view(self) -> np.ndarray:
+        return self.data[:, self.head:self.head + self.size]
 
 
 class Plotter:
-    def __init__(self, fig: Figure, queue: Queue, window_sec = 10):
+    def __init__(self, fig: Figure, queue: Queue, window_sec = 10, capacity = 1 << 17):
+        self.fig = fig
         self.queue = queue
         self.window_sec = window_sec
+        self.buffer = RingBuffer(4, capacity)
+        self.decoder = Decoder()
+        self.background = None
+
         self.axes = fig.subplots(3, 1, sharex=True)
-        self.lines = [ax.plot([], [])[0] for ax in self.axes]
+        self.lines = [ax.plot([], [], animated=True)[0] for ax in self.axes]
 
         fig.set_tight_layout(True)
         self.axes[0].set_ylabel('Voltage (V)')
         self.axes[1].set_ylabel('Current (mA)')
         self.axes[2].set_ylabel('Power (mW)')
+        self.axes[2].set_xlabel('Time (s)')
+        self.axes[2].set_xlim(-window_sec, 0)
+
+        fig.canvas.mpl_connect('draw_event', self.on_draw)
 
-    def update(self, _):
-        new_t = []
-        new_data = ([], [], [])
+    def on_draw(self, _):
+        # Everything except the animated lines has just been drawn, so this
+        # is the background to restore before blitting each frame.
+        self.background = self.fig.canvas.copy_from_bbox(self.fig.bbox)
 
-        # Retrieve all new data from the queue
-        while not self.queue.empty():
+    def ingest(self) -> bool:
+        chunks = []
+        while True:
             try:
-                line: str = self.queue.get_nowait()
+                chunks.append(self.queue.get_nowait())
             except Empty:
                 break
 
-            try:
-                t, v, a, w = tuple(map(float, line.split(',')))
-            except ValueError:
-                continue
-
-            new_t.append(t / 1e6)
-            new_data[0].append(v)
-            new_data[1].append(a)
-            new_data[2].append(w)
-
-        # Update the time axis
-        t = np.append(self.lines[0].get_xdata(), new_t)
-        max_t = t[-1]
-        min_t = max_t - self.window_sec
-        n = t.searchsorted(min_t)
-        t = t[n:]
-
-        # Update the lines and autoscale Y axes
-        for ax, line, data in zip(self.axes, self.lines, new_data):
-            y = np.append(line.get_ydata(), data)[n:]
-
-            min_y = y.min()
-            max_y = y.max()
-            pad_y = 0.1 * (max_y - min_y)
+        t, v, a, w, _markers = self.decoder.decode(b''.join(chunks))
+        if len(t) == 0:
+            return False
+
+        self.buffer.extend(np.vstack((t / 1e6, v, a, w)))
+        return True
+
+    def update(self):
+        if not self.ingest():
+            return
+
+        data = self.buffer.view()
+        t = data[0]
+        n = t.searchsorted(t[-1] - self.window_sec)
+        t = t[n:] - t[-1]
+
+        # Only rescale (and pay for a full redraw) when the data leaves the
+        # current Y limits or shrinks to well within them.
+        redraw = self.background is None
+        for ax, line, y in zip(self.axes, self.lines, data[1:]):
+            y = y[n:]
+            line.set_data(t, y)
+
+            min_y = np.nanmin(y)
+            max_y = np.nanmax(y)
+            pad_y = 0.1 * (max_y - min_y) or 0.1
             min_y -= pad_y
             max_y += pad_y
 
-            ax.set_xlim(min_t, max_t)
-            ax.set_ylim(min_y, max_y)
-            line.set_data(t, y)
+            lo, hi = ax.get_ylim()
+            if min_y + pad_y < lo or max_y - pad_y > hi or (max_y - min_y) < 0.5 * (hi - lo):
+                ax.set_ylim(min_y, max_y)
+                redraw = True
 
-        return self.lines
+        canvas = self.fig.canvas
+        if redraw:
+            canvas.draw()
+        canvas.restore_region(self.background)
+        for ax, line in zip(self.axes, self.lines):
+            ax.draw_artist(line)
+        canvas.blit(self.fig.bbox)
+        canvas.flush_events()
 
 
 class PowerScope:
@@ -81,14 +153,16 @@ class PowerScope:
         fig = plt.figure()
         fig.canvas.manager.set_window_title('Power Scope')
 
-        self.serial = Serial(port)
+        self.serial = ServerSocket(port) if port.startswith('socket://') else Serial(port)
         self.reader = ReaderThread(self.serial, lambda: SerialReader(queue))
 
         self.scope = Plotter(fig, queue)
-        self.anim = FuncAnimation(fig, self.scope.update, interval=1000/25, save_count=0)
+        self.timer = fig.canvas.new_timer(interval=1000/25)
+        self.timer.add_callback(self.scope.update)
 
     def run(self):
         with self.reader:
+            self.timer.start()
             plt.show()
 
 